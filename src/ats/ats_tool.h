@@ -1,13 +1,49 @@
 #ifndef __ATS_TOOL_H__
 #define __ATS_TOOL_H__
 
-#include <GL/glu.h>
+// @NOTE: define ATS_HEADLESS to build without GL and GLFW, there is no window, no render_* and no
+// vertex_array_render then, the rest (containers, math, tilemap, random, ...) works the same!
+// Define ATS_SOFTWARE_RENDER as well to get them back, drawn by the cpu into memory (soft_render.h).
+// ATS_RENDER is defined whenever there is a render_* api, GL or software.
+#if !defined(ATS_HEADLESS) || defined(ATS_SOFTWARE_RENDER)
+#define ATS_RENDER
+#endif
+#ifndef ATS_HEADLESS
+#include <GL/gl.h>
+#include <GL/glext.h>
 #include <GLFW/glfw3.h>
+#endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>   // before the math macros below, stb_image includes it too
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 typedef     int32_t     b32;
 
@@ -92,6 +128,55 @@ constexpr r32 rsqrt(r32 n) { return n == 0? n : 1.0f / sqrtf(n); }
 
 // ======================================= DYNAMIC HEAP ARRAY ======================================== //
 
+// @NOTE: trivially copyable types keep the old realloc/memmove path, everything else is move
+// constructed into the new storage and destroyed in the old one!
+template <typename T>
+inline static void array__relocate(T* dst, T* src, i64 n) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+        memcpy(dst, src, sizeof (T) * n);
+    } else {
+        for (i64 i = 0; i < n; ++i) {
+            new (&dst[i]) T(std::move(src[i]));
+            src[i].~T();
+        }
+    }
+}
+
+template <typename T>
+inline static void array__destroy(T* buf, i64 n) {
+    if constexpr (!std::is_trivially_destructible<T>::value) {
+        for (i64 i = 0; i < n; ++i) { buf[i].~T(); }
+    }
+}
+
+// buf goes from len to size elements (there is room for them): removed ones are destroyed, new ones value
+// constructed. New elements of a trivial T are left uninitialized, like malloc'd memory!
+template <typename T>
+inline static void array__resize(T* buf, i64 len, i64 size) {
+    if (size < len) { array__destroy(&buf[size], len - size); }
+    if constexpr (!std::is_trivial<T>::value) {
+        for (i64 i = len; i < size; ++i) { new (&buf[i]) T{}; }
+    }
+}
+
+// removes buf[i] and shifts the rest down by one, keeps the order!
+template <typename T>
+inline static void array__erase_ordered(T* buf, i64 len, i64 i) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+        memmove(&buf[i], &buf[i + 1], sizeof (T) * (len - i - 1));
+    } else {
+        for (i64 j = i; j < len - 1; ++j) { buf[j] = std::move(buf[j + 1]); }
+        buf[len - 1].~T();
+    }
+}
+
+// removes buf[i] by moving the last element into its place, does not keep the order!
+template <typename T>
+inline static void array__erase_unordered(T* buf, i64 len, i64 i) {
+    if (i != len - 1) { buf[i] = std::move(buf[len - 1]); }
+    array__destroy(&buf[len - 1], 1);
+}
+
 template <typename T>
 struct Array {
     i64         _cap;
@@ -110,36 +195,244 @@ struct Array {
     inline T*       get   (i64 i)       { return &_buf[i]; }
     inline const T* get   (i64 i) const { return &_buf[i]; }
 
-    inline void     clear   ()            { _len = 0; }
-    inline void     destroy ()            { free(_buf); *this = {}; }
-    inline void     rem     (i64 i)       { _buf[i] = _buf[--_len]; }
+    inline void     clear       ()        { array__destroy(_buf, _len); _len = 0; }
+    inline void     destroy     ()        { clear(); free(_buf); *this = {}; }
+    inline void     rem         (i64 i)   { array__erase_unordered(_buf, _len--, i); }
+    inline void     rem_ordered (i64 i)   { array__erase_ordered(_buf, _len--, i); }
 
+    // @NOTE: may move the elements, pointers into the array are dead after this!
     inline void grow(i64 n) {
         if (_len + n >= _cap) {
-            _cap =  round_up_to_multiple_of_8(MAX(_cap << 1, _len + n));
-            _buf =  (T*)realloc(_buf, sizeof (T) * _cap);
+            i64 cap = round_up_to_multiple_of_8(MAX(_cap << 1, _len + n));
+
+            if constexpr (std::is_trivially_copyable<T>::value) {
+                _buf = (T*)realloc(_buf, sizeof (T) * cap);
+            } else {
+                T* buf = (T*)malloc(sizeof (T) * cap);
+                array__relocate(buf, _buf, _len);
+                free(_buf);
+                _buf = buf;
+            }
+
+            _cap = cap;
         }
     }
 
-    inline void reserve(i64 size) { if (size > _cap) { grow(size - _cap); } }
+    inline void reserve(i64 size) { if (size > _cap) { grow(size - _len); } }
 
-    inline void resize(i64 size) { reserve(size); _len = size; }
+    inline void resize(i64 size) { reserve(size); array__resize(ptr(), _len, size); _len = size; }
 
     inline void add(const T& e) {
         grow(1);
-        _buf[_len++] = e;
+        new (&_buf[_len++]) T(e);
+    }
+
+    inline void add(T&& e) {
+        grow(1);
+        new (&_buf[_len++]) T(std::move(e));
+    }
+
+    // constructs the element in place, no temporary and no copy!
+    template <typename... Args>
+    inline T* emplace(Args&&... args) {
+        grow(1);
+        return new (&_buf[_len++]) T{ std::forward<Args>(args)... };
     }
 
     inline T* create() {
         grow(1);
-        T* e    = &_buf[_len++];
-        *e      = {};
-        return e;
+        return new (&_buf[_len++]) T{};
     }
 };
 
 template <typename T> inline static Array<T> array_make() { return { 0, 0, nullptr }; }
 
+// ===================================== SMALL BUFFER ARRAY ========================================== //
+
+// same interface as Array, but the first N elements live inline, so short lived arrays never
+// touch the heap. Spills into a heap buffer when it grows past N!
+// @NOTE: _buf is null while the inline storage is used, so copying a small array stays valid.
+template <typename T, i64 N>
+struct Small_Array {
+    i64         _cap;
+    i64         _len;
+    T*          _buf;
+    alignas(T) u8 _small[sizeof (T) * N];
+
+    inline T*       ptr   ()            { return _buf? _buf : (T*)_small; }
+    inline const T* ptr   () const      { return _buf? _buf : (const T*)_small; }
+
+    T&       operator[](i64 i)          { return ptr()[i]; }
+    const T& operator[](i64 i) const    { return ptr()[i]; }
+
+    inline i64      cap   () const      { return _buf? _cap : N; }
+    inline i64      len   () const      { return _len; }
+
+    inline T*       get   (i64 i)       { return &ptr()[i]; }
+    inline const T* get   (i64 i) const { return &ptr()[i]; }
+
+    inline b32      is_small    () const  { return _buf == nullptr; }
+
+    inline void     clear       ()        { array__destroy(ptr(), _len); _len = 0; }
+    inline void     destroy     ()        { clear(); free(_buf); _buf = nullptr; _cap = 0; }
+    inline void     rem         (i64 i)   { array__erase_unordered(ptr(), _len--, i); }
+    inline void     rem_ordered (i64 i)   { array__erase_ordered(ptr(), _len--, i); }
+
+    // @NOTE: may move the elements, pointers into the array are dead after this!
+    inline void grow(i64 n) {
+        if (_len + n > cap()) {
+            i64 new_cap = round_up_to_multiple_of_8(MAX(cap() << 1, _len + n));
+            T*  buf     = (T*)malloc(sizeof (T) * new_cap);
+
+            array__relocate(buf, ptr(), _len);
+            free(_buf);
+
+            _buf = buf;
+            _cap = new_cap;
+        }
+    }
+
+    inline void reserve(i64 size) { if (size > cap()) { grow(size - _len); } }
+
+    inline void resize(i64 size) { reserve(size); array__resize(ptr(), _len, size); _len = size; }
+
+    inline void add(const T& e) {
+        grow(1);
+        new (&ptr()[_len++]) T(e);
+    }
+
+    inline void add(T&& e) {
+        grow(1);
+        new (&ptr()[_len++]) T(std::move(e));
+    }
+
+    template <typename... Args>
+    inline T* emplace(Args&&... args) {
+        grow(1);
+        return new (&ptr()[_len++]) T{ std::forward<Args>(args)... };
+    }
+
+    inline T* create() {
+        grow(1);
+        return new (&ptr()[_len++]) T{};
+    }
+};
+
+// ================================================ HANDLES ============================================== //
+
+// 32-bit generational handle: low 20 bits are the slot, high 12 bits the generation of that slot.
+// A slot bumps its generation when it is released, so old handles to it stop resolving.
+// @NOTE: the generation never is 0, that way HANDLE_NULL (0) is never a valid handle!
+typedef u32 Handle;
+
+#define HANDLE_NULL             (0u)
+#define HANDLE_INDEX_BITS       (20)
+#define HANDLE_INDEX_MASK       ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GEN_MASK         ((1u << (32 - HANDLE_INDEX_BITS)) - 1)
+
+inline static u32    handle_index (Handle h)         { return h & HANDLE_INDEX_MASK; }
+inline static u32    handle_gen   (Handle h)         { return h >> HANDLE_INDEX_BITS; }
+inline static Handle handle_make  (u32 i, u32 gen)   { return (gen << HANDLE_INDEX_BITS) | i; }
+
+// maps handles to a u32 the owner picks (usually a dense index), free slots are kept in a list!
+struct Handle_Table {
+    Array<u32>  _value;     // live slot: the value, free slot: next free slot + 1
+    Array<u16>  _gen;
+    u32         _free;      // first free slot + 1, 0 when there is none
+    u32         _count;
+
+    inline u32  count () const { return _count; }
+
+    inline b32 valid(Handle h) const {
+        u32 i = handle_index(h);
+        return h != HANDLE_NULL && i < (u32)_gen.len() && _gen[i] == handle_gen(h);
+    }
+
+    inline Handle acquire(u32 value) {
+        u32 i;
+
+        if (_free) {
+            i       = _free - 1;
+            _free   = _value[i];
+        } else {
+            i = (u32)_value.len();
+            assert(i <= HANDLE_INDEX_MASK);
+            _value.add(0);
+            _gen.add(1);
+        }
+
+        _value[i] = value;
+        _count++;
+
+        return handle_make(i, _gen[i]);
+    }
+
+    inline void release(Handle h) {
+        if (!valid(h)) { return; }
+
+        u32 i   = handle_index(h);
+        u16 gen = (_gen[i] + 1) & HANDLE_GEN_MASK;
+
+        _gen[i]     = gen? gen : 1;
+        _value[i]   = _free;
+        _free       = i + 1;
+        _count--;
+    }
+
+    // @NOTE: only for valid handles!
+    inline u32  get (Handle h) const        { return _value[handle_index(h)]; }
+    inline void set (Handle h, u32 value)   { _value[handle_index(h)] = value; }
+
+    inline void destroy() { _value.destroy(); _gen.destroy(); _free = 0; _count = 0; }
+};
+
+// dense array of T with handles into it: iteration is a plain loop over the dense array,
+// lookup and rem are O(1). rem swaps the last element into the hole!
+template <typename T>
+struct Slot_Map {
+    Handle_Table    _table;
+    Array<T>        _dense;
+    Array<Handle>   _ids;       // handle of every dense element
+
+    T&       operator[](i64 i)          { return _dense[i]; }
+    const T& operator[](i64 i) const    { return _dense[i]; }
+
+    inline i64      len   () const      { return _dense.len(); }
+    inline T*       ptr   ()            { return _dense.ptr(); }
+    inline Handle   id    (i64 i) const { return _ids[i]; }
+
+    inline b32      valid (Handle h) const { return _table.valid(h); }
+
+    inline T* get(Handle h) { return _table.valid(h)? &_dense[_table.get(h)] : nullptr; }
+
+    inline Handle create() {
+        Handle h = _table.acquire((u32)_dense.len());
+        _dense.create();
+        _ids.add(h);
+        return h;
+    }
+
+    inline void rem(Handle h) {
+        if (!_table.valid(h)) { return; }
+
+        u32 i = _table.get(h);
+
+        _dense.rem(i);
+        _ids.rem(i);
+        if (i < (u32)_ids.len()) { _table.set(_ids[i], i); }
+
+        _table.release(h);
+    }
+
+    inline void clear() {
+        for (i64 i = 0; i < _ids.len(); ++i) { _table.release(_ids[i]); }
+        _dense.clear();
+        _ids.clear();
+    }
+
+    inline void destroy() { _table.destroy(); _dense.destroy(); _ids.destroy(); }
+};
+
 // ============================================= STACK ARRAY ========================================= //
 
 template <typename T, i64 N>
@@ -168,6 +461,312 @@ struct Stack {
     inline u32      cap    ()              { return N; }
 };
 
+// ============================================= SPSC QUEUE ========================================== //
+
+// lock-free ring for one producer thread and one consumer thread!
+// @NOTE: N has to be a power of two, head/tail are free running and wrap around.
+template <typename T, u32 N>
+struct Spsc_Queue {
+    static_assert((N & (N - 1)) == 0, "Spsc_Queue: N has to be a power of two!");
+
+    alignas(64) std::atomic<u32>    _head;      // only written by the consumer
+    alignas(64) std::atomic<u32>    _tail;      // only written by the producer
+    alignas(64) T                   _buf[N];
+
+    inline u32 cap() const { return N; }
+    inline u32 len() const { return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire); }
+
+    // producer side: returns false when full, the element is dropped!
+    inline b32 push(const T& e) {
+        u32 tail = _tail.load(std::memory_order_relaxed);
+
+        if (tail - _head.load(std::memory_order_acquire) == N) { return false; }
+
+        _buf[tail & (N - 1)] = e;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side: returns false when empty!
+    inline b32 pop(T* e) {
+        u32 head = _head.load(std::memory_order_relaxed);
+
+        if (head == _tail.load(std::memory_order_acquire)) { return false; }
+
+        *e = _buf[head & (N - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side: drops everything pushed so far!
+    inline void clear() { _head.store(_tail.load(std::memory_order_acquire), std::memory_order_release); }
+};
+
+// ================================================= PROFILER ============================================= //
+
+// @NOTE: opt in with ATS_PROFILE, without it the PROFILE_* macros compile to nothing! PROFILE_SCOPE("name") times
+// the rest of its block and records it when the block ends (name, start, end) into the buffer of the thread it ran
+// on. Only that thread writes the buffer and publishes its count with a release store, recording never locks,
+// a thread locks once to get its buffer. A buffer keeps the last PROFILE_EVENTS_PER_THREAD scopes, a thread that
+// ends hands it to the next new one. profile_write exports every buffer as chrome trace event json (open it in
+// chrome://tracing or ui.perfetto.dev), a row per thread with the scopes nested in each other.
+// Names have to outlive the profile, string literals.
+
+#ifdef ATS_PROFILE
+
+#ifndef PROFILE_EVENTS_PER_THREAD
+#define PROFILE_EVENTS_PER_THREAD   (1 << 16)
+#endif
+#define PROFILE_MAX_THREADS         64
+
+struct Profile_Event {
+    const char*     name;
+    i64             start;      // ns
+    i64             end;
+};
+
+struct Profile_Thread {
+    std::atomic<u64>    count;      // of scopes ever recorded, only the last PROFILE_EVENTS_PER_THREAD are still there
+    std::atomic<b32>    in_use;
+    const char*         name;
+    Profile_Event       events[PROFILE_EVENTS_PER_THREAD];
+};
+
+struct Profiler {
+    std::mutex          mutex;      // guards handing out buffers
+    Profile_Thread*     threads[PROFILE_MAX_THREADS];
+    std::atomic<i32>    thread_count;
+};
+
+static Profiler profiler;
+
+static inline i64 profile_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// gives the buffer back when its thread ends
+struct Profile_Thread_Slot {
+    Profile_Thread* thread;
+    ~Profile_Thread_Slot() { if (thread) { thread->in_use.store(false, std::memory_order_release); } }
+};
+
+static thread_local Profile_Thread_Slot profile__slot;
+
+// NULL when all PROFILE_MAX_THREADS buffers are taken, the thread is not recorded then
+static Profile_Thread* profile__thread() {
+    if (profile__slot.thread) { return profile__slot.thread; }
+
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+    i32 count = profiler.thread_count.load(std::memory_order_relaxed);
+    for_i (0, count) {
+        if (!profiler.threads[i]->in_use.load(std::memory_order_acquire)) {
+            profile__slot.thread = profiler.threads[i];
+            break;
+        }
+    }
+    if (!profile__slot.thread && count < PROFILE_MAX_THREADS) {
+        profile__slot.thread = new Profile_Thread();
+        profile__slot.thread->count.store(0, std::memory_order_relaxed);
+        profiler.threads[count] = profile__slot.thread;
+        profiler.thread_count.store(count + 1, std::memory_order_release);
+    }
+    if (profile__slot.thread) {
+        profile__slot.thread->name = "thread";
+        profile__slot.thread->in_use.store(true, std::memory_order_release);
+    }
+    return profile__slot.thread;
+}
+
+static void profile_thread_name(const char* name) {
+    Profile_Thread* thread = profile__thread();
+    if (thread) { thread->name = name; }
+}
+
+static void profile_record(const char* name, i64 start, i64 end) {
+    Profile_Thread* thread = profile__thread();
+    if (!thread) { return; }
+
+    u64 count = thread->count.load(std::memory_order_relaxed);
+    thread->events[count % PROFILE_EVENTS_PER_THREAD] = { name, start, end };
+    thread->count.store(count + 1, std::memory_order_release);
+}
+
+struct Profile_Scope {
+    const char*     name;
+    i64             start;
+
+    Profile_Scope(const char* name) : name(name), start(profile_now()) {}
+    ~Profile_Scope() { profile_record(name, start, profile_now()); }
+};
+
+// can run while the other threads keep recording, so only the newer half of every buffer is written: the older
+// half could be overwritten while it is read. Times are relative to the oldest scope written.
+static b32 profile_write(const char* file_name) {
+    FILE* fp = fopen(file_name, "w");
+    if (!fp) { return false; }
+
+    i32 thread_count = profiler.thread_count.load(std::memory_order_acquire);
+    u64 ends[PROFILE_MAX_THREADS];
+    i64 origin = INT64_MAX;
+    for_i (0, thread_count) {
+        Profile_Thread* thread = profiler.threads[i];
+        ends[i] = thread->count.load(std::memory_order_acquire);
+        u64 first = ends[i] > PROFILE_EVENTS_PER_THREAD / 2 ? ends[i] - PROFILE_EVENTS_PER_THREAD / 2 : 0;
+        for (u64 e = first; e < ends[i]; ++e) { origin = MIN(origin, thread->events[e % PROFILE_EVENTS_PER_THREAD].start); }
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    b32 first_event = true;
+    for_i (0, thread_count) {
+        Profile_Thread* thread = profiler.threads[i];
+        fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first_event? "" : ",", i, thread->name);
+        first_event = false;
+
+        u64 first = ends[i] > PROFILE_EVENTS_PER_THREAD / 2 ? ends[i] - PROFILE_EVENTS_PER_THREAD / 2 : 0;
+        for (u64 e = first; e < ends[i]; ++e) {
+            const Profile_Event* event = &thread->events[e % PROFILE_EVENTS_PER_THREAD];
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    event->name, i, (event->start - origin) / 1e3, (event->end - event->start) / 1e3);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    return true;
+}
+
+#define PROFILE_SCOPE(name)         Profile_Scope __ADD_LINE_NUM1(profile_scope_, __LINE__)(name)
+#define PROFILE_FUNCTION()          PROFILE_SCOPE(__func__)
+#define PROFILE_THREAD_NAME(name)   profile_thread_name(name)
+
+#else
+
+#define PROFILE_SCOPE(name)         ((void)0)
+#define PROFILE_FUNCTION()          ((void)0)
+#define PROFILE_THREAD_NAME(name)   ((void)0)
+
+#endif // ATS_PROFILE
+
+// ================================================= JOB POOL ============================================= //
+
+// worker threads that split loops between them. job_pool_for runs fn(i) for every i in [0, count) on
+// the workers and on the calling thread and returns when all of them are done. Indices are handed
+// out grain at a time through an atomic counter, so uneven work evens out by itself.
+// @NOTE: one loop at a time per pool, fn must not start another job_pool_for on the same pool!
+
+struct Job_Pool {
+    Array<std::thread>          threads;
+    std::mutex                  mutex;
+    std::condition_variable     wake;       // a loop started or the pool shuts down
+    std::condition_variable     done;       // the last worker left the loop
+    u32                         loop;       // bumped for every loop, workers wait for it to change
+    i32                         busy;       // workers still in the current loop
+    b32                         quit;
+
+    void                      (*fn)(void* user, i64 i);
+    void*                       user;
+    i64                         count;
+    i64                         grain;
+    std::atomic<i64>            next;
+};
+
+static void job_pool__run(Job_Pool* pool) {
+    PROFILE_SCOPE("jobs");
+
+    for (;;) {
+        i64 start = pool->next.fetch_add(pool->grain, std::memory_order_relaxed);
+        if (start >= pool->count) { return; }
+
+        i64 end = MIN(start + pool->grain, pool->count);
+        for (i64 i = start; i < end; ++i) { pool->fn(pool->user, i); }
+    }
+}
+
+static void job_pool__worker(Job_Pool* pool) {
+    PROFILE_THREAD_NAME("job worker");
+    u32 seen = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->wake.wait(lock, [&] { return pool->quit || pool->loop != seen; });
+            if (pool->quit) { return; }
+            seen = pool->loop;
+        }
+
+        job_pool__run(pool);
+
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (--pool->busy == 0) { pool->done.notify_one(); }
+    }
+}
+
+// workers < 0 is one less than there are cores (the calling thread helps), 0 runs every loop inline.
+// Sets every field, pool can be anything before (a stack object, or one that was destroyed).
+static void job_pool_create(Job_Pool* pool, i32 workers) {
+    if (workers < 0) { workers = MAX((i32)std::thread::hardware_concurrency() - 1, 0); }
+
+    pool->threads   = {};
+    pool->loop      = 0;
+    pool->busy      = 0;
+    pool->quit      = false;
+    pool->fn        = NULL;
+    pool->user      = NULL;
+    pool->count     = 0;
+    pool->grain     = 1;
+    pool->next.store(0, std::memory_order_relaxed);
+    for_i (0, workers) { pool->threads.add(std::thread(job_pool__worker, pool)); }
+}
+
+static void job_pool_destroy(Job_Pool* pool) {
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->quit = true;
+    }
+    pool->wake.notify_all();
+
+    for_i (0, pool->threads.len()) { pool->threads[i].join(); }
+    pool->threads.destroy();
+}
+
+// threads working on a loop, the calling thread included
+static i32 job_pool_threads(const Job_Pool* pool) { return (i32)pool->threads.len() + 1; }
+
+static void job_pool_for(Job_Pool* pool, i64 count, i64 grain, void (*fn)(void* user, i64 i), void* user) {
+    if (count <= 0) { return; }
+
+    pool->fn    = fn;
+    pool->user  = user;
+    pool->count = count;
+    pool->grain = MAX(grain, (i64)1);
+    pool->next.store(0, std::memory_order_relaxed);
+
+    // a loop that fits into one grain is not worth waking anyone up for
+    if (!pool->threads.len() || count <= pool->grain) {
+        job_pool__run(pool);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->busy = (i32)pool->threads.len();
+        pool->loop++;
+    }
+    pool->wake.notify_all();
+
+    job_pool__run(pool);
+
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->done.wait(lock, [&] { return pool->busy == 0; });
+}
+
+// same with a lambda, job_pool_for(&pool, n, 1, [&](i64 i) { ... });
+template <typename F>
+static void job_pool_for(Job_Pool* pool, i64 count, i64 grain, F&& fn) {
+    typedef typename std::remove_reference<F>::type Fn;
+    job_pool_for(pool, count, grain, [](void* user, i64 i) { (*(Fn*)user)(i); }, (void*)&fn);
+}
+
 // ================================================== FILE IO ============================================= //
 
 static size_t file_get_size(FILE* fp) {
@@ -243,59 +842,300 @@ static b32 file_write_bin(const char* file_name, const void* data, size_t size)
     return false;
 }
 
-// ================================================ MATH 2D =========================================== //
+// ============================================== MAPPED FILE IO ================================================== //
+
+// the whole file as memory, no read/write calls and no copy into a buffer of our own.
+// file_map_write creates (or truncates) the file at exactly size bytes, the data is
+// written back when it is unmapped. An empty file is nothing to map: data is NULL and
+// size 0, the file stays open until file_unmap all the same.
+struct File_Map {
+    u8*     data;
+    size_t  size;
+#ifdef _WIN32
+    HANDLE  _file;
+    HANDLE  _mapping;
+#else
+    int     _fd;
+#endif
+};
 
-struct v2 { r32 x, y; };
+static void file_unmap(File_Map* map) {
+#ifdef _WIN32
+    if (map->data)      { UnmapViewOfFile(map->data); }
+    if (map->_mapping)  { CloseHandle(map->_mapping); }
+    if (map->_file && map->_file != INVALID_HANDLE_VALUE) { CloseHandle(map->_file); }
+#else
+    if (map->data)      { munmap(map->data, map->size); }
+    if (map->_fd > 0)   { close(map->_fd); }
+#endif
+    *map = {};
+}
 
-inline constexpr void  operator+=(v2& a, v2 b)   { a.x += b.x;  a.y += b.y; }
-inline constexpr void  operator-=(v2& a, v2 b)   { a.x -= b.x;  a.y -= b.y; }
-inline constexpr void  operator*=(v2& a, r32 s)  { a.x *= s;    a.y *= s; }
-inline constexpr void  operator/=(v2& a, r32 s)  { a.x /= s;    a.y /= s; }
+static b32 file_map__open(File_Map* map, const char* file_name, size_t size, b32 write) {
+    *map = {};
+#ifdef _WIN32
+    map->_file = CreateFileA(file_name, write? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                             write? 0 : FILE_SHARE_READ, NULL, write? CREATE_ALWAYS : OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+    if (map->_file == INVALID_HANDLE_VALUE) { return false; }
+
+    if (!write) {
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(map->_file, &file_size)) { file_unmap(map); return false; }
+        size = (size_t)file_size.QuadPart;
+    }
+    if (size == 0) { return true; }
+
+    map->_mapping = CreateFileMappingA(map->_file, NULL, write? PAGE_READWRITE : PAGE_READONLY,
+                                       (DWORD)((u64)size >> 32), (DWORD)size, NULL);
+    if (!map->_mapping) { file_unmap(map); return false; }
+
+    map->data = (u8*)MapViewOfFile(map->_mapping, write? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+#else
+    map->_fd = open(file_name, write? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+    if (map->_fd < 0) { map->_fd = 0; return false; }
+
+    if (write) {
+        if (ftruncate(map->_fd, (off_t)size) != 0) { file_unmap(map); return false; }
+    } else {
+        struct stat st;
+        if (fstat(map->_fd, &st) != 0) { file_unmap(map); return false; }
+        size = (size_t)st.st_size;
+    }
+    if (size == 0) { return true; }
 
-inline constexpr v2    operator+ (v2 a, v2 b)    { return { a.x + b.x, a.y + b.y }; }
-inline constexpr v2    operator- (v2 a, v2 b)    { return { a.x - b.x, a.y - b.y }; }
+    void* data = mmap(NULL, size, write? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, map->_fd, 0);
+    map->data = data == MAP_FAILED? NULL : (u8*)data;
+#endif
+    if (!map->data) { file_unmap(map); return false; }
 
-inline constexpr v2    operator* (v2 a, r32 s)   { return { a.x * s, a.y * s }; }
-inline constexpr v2    operator* (r32 s, v2 a)   { return { a.x * s, a.y * s }; }
+    map->size = size;
+    return true;
+}
 
-inline constexpr v2    operator/ (v2  a, r32 s)  { return { a.x / s, a.y / s }; }
-inline constexpr v2    operator/ (r32 s, v2  a)  { return { a.x / s, a.y / s }; }
+// @NOTE: the data of a read mapping is read only!
+static b32 file_map_read(File_Map* map, const char* file_name) {
+    return file_map__open(map, file_name, 0, false);
+}
 
-inline constexpr r32   dot          (v2 a, v2 b)    { return a.x * b.x + a.y * b.y; }
-inline constexpr r32   len_sq       (v2 a)          { return dot(a, a); }
-inline constexpr r32   len          (v2 a)          { return sqrtf(dot(a, a)); }
-inline constexpr r32   rlen         (v2 a)          { return rsqrt(dot(a, a)); }
-inline constexpr v2    norm         (v2 a)          { return a * rlen(a); }
-inline constexpr r32   dist         (v2 a, v2 b)    { return len(a - b);  }
-inline constexpr r32   dist_sq      (v2 a, v2 b)    { return len_sq(a - b); }
+static b32 file_map_write(File_Map* map, const char* file_name, size_t size) {
+    return file_map__open(map, file_name, size, true);
+}
 
-inline constexpr r32   det          (v2 a, v2 b)    { return a.x * b.y - b.x * a.y; }
-inline constexpr r32   cross        (v2 a, v2 b)    { return a.x * b.y - a.y * b.x; }
+// ================================================= ASSET PACK =============================================== //
 
-//inline constexpr v2 lerp(v2 a, v2 b, r32 t) { return { lerp(a.x, b.x, t), lerp(a.y, b.y, t) }; }
+// every asset of the game in one file that is used straight from its mapping: Asset_Pack_Header,
+// the toc (Asset_Entry[count], sorted by name), then the data of every entry, 16 byte aligned.
+// Textures are stored decoded, in the layout glTexImage2D takes, so loading one is a lookup
+// and an upload from the mapped memory. No decoding, no copy. Build packs with pack.exe.
 
-// HERE
-inline constexpr r32 get_angle(v2 a, v2 b) { return atan2f(det(a, b), dot(a, b)); }
+#define ASSET_PACK_MAGIC    0x4b415053  // "SPAK"
+#define ASSET_PACK_VERSION  1
 
-inline constexpr v2 get_dir(v2 from, v2 to) {
-    return norm(to - from);
-}
+enum Asset_Type {
+    ASSET_BLOB,     // bytes as they were in the source file
+    ASSET_TEXTURE,  // pixels, see Asset_Format
+};
 
-inline constexpr v2 round(v2 a) { return { roundf(a.x), roundf(a.y) }; }
+enum Asset_Format {
+    ASSET_FORMAT_NONE,
+    ASSET_FORMAT_RGBA8,     // width * height * 4 bytes, rows in the order stb_image returns them
+};
 
-inline constexpr v2 rotate_args(v2 a, r32 c, r32 s) {
-    return { a.x * c - a.y * s, a.x * s + a.y * c };
-}
+struct Asset_Pack_Header {
+    u32     magic;
+    u32     version;
+    u32     count;
+    u32     _pad;
+    u64     size;       // of the whole file
+};
 
-inline constexpr v2 rotate(v2 a, r32 rad) {
-    r32 c = cosf(rad);
-    r32 s = sinf(rad);
+struct Asset_Entry {
+    char    name[64];   // 0 terminated
+    u32     type;       // Asset_Type
+    u32     format;     // Asset_Format
+    u32     width;
+    u32     height;
+    u64     offset;     // from the start of the file
+    u64     size;
+};
 
-    return { a.x * c - a.y * s, a.x * s + a.y * c };
+struct Asset_Pack {
+    File_Map            file;
+    const Asset_Entry*  toc;
+    u32                 count;
+};
+
+static void asset_pack_close(Asset_Pack* pack) {
+    file_unmap(&pack->file);
+    *pack = {};
 }
 
-inline constexpr void rotate_us(v2* us, i32 size, r32 rad) {
-    r32 c = cosf(rad);
+// false for files that are not a pack of this version or are cut off
+static b32 asset_pack_open(Asset_Pack* pack, const char* file_name) {
+    *pack = {};
+    if (!file_map_read(&pack->file, file_name)) { return false; }
+
+    const u8*           data = pack->file.data;
+    u64                 size = pack->file.size;
+    Asset_Pack_Header   header;
+
+    b32 ok = size >= sizeof (header);
+    if (ok) {
+        memcpy(&header, data, sizeof (header));
+        ok = header.magic == ASSET_PACK_MAGIC && header.version == ASSET_PACK_VERSION && header.size == size &&
+             header.count <= (size - sizeof (header)) / sizeof (Asset_Entry);
+    }
+
+    pack->toc   = ok? (const Asset_Entry*)(data + sizeof (Asset_Pack_Header)) : NULL;   // data is NULL for an empty file
+    pack->count = ok? header.count : 0;
+
+    for (u32 i = 0; ok && i < pack->count; ++i) {
+        const Asset_Entry* e = &pack->toc[i];
+        ok = memchr(e->name, 0, sizeof (e->name)) && e->offset <= size && e->size <= size - e->offset &&
+             (i == 0 || strcmp(pack->toc[i - 1].name, e->name) < 0);
+    }
+
+    if (!ok) { asset_pack_close(pack); }
+    return ok;
+}
+
+// binary search in the toc, NULL when there is no such asset
+static const Asset_Entry* asset_pack_find(const Asset_Pack* pack, const char* name) {
+    u32 lo = 0;
+    u32 hi = pack->count;
+
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        i32 cmp = strcmp(pack->toc[mid].name, name);
+
+        if (cmp == 0)   { return &pack->toc[mid]; }
+        if (cmp < 0)    { lo = mid + 1; }
+        else            { hi = mid; }
+    }
+    return NULL;
+}
+
+// @NOTE: points into the mapping, dead after asset_pack_close!
+static const u8* asset_pack_data(const Asset_Pack* pack, const Asset_Entry* entry) {
+    return pack->file.data + entry->offset;
+}
+
+// ----------------------------------------------- pack building ------------------------------------------------ //
+
+struct Asset_Pack_Builder {
+    Array<Asset_Entry>  toc;    // offsets are into data until asset_pack_write
+    Array<u8>           data;
+};
+
+static void asset_pack_add(Asset_Pack_Builder* builder, const char* name, Asset_Type type, Asset_Format format,
+                           u32 width, u32 height, const void* data, u64 size) {
+    Asset_Entry* e = builder->toc.create();
+    *e = {};
+    snprintf(e->name, sizeof (e->name), "%s", name);
+    e->type     = type;
+    e->format   = format;
+    e->width    = width;
+    e->height   = height;
+    e->offset   = builder->data.len();
+    e->size     = size;
+
+    if (!size) { return; }  // data can be NULL, an empty file maps to nothing
+
+    builder->data.resize(builder->data.len() + ((size + 15) & ~15ull));
+    memcpy(builder->data.ptr() + e->offset, data, size);
+    memset(builder->data.ptr() + e->offset + size, 0, builder->data.len() - e->offset - size);
+}
+
+static int asset__compare_entries(const void* a, const void* b) {
+    return strcmp(((const Asset_Entry*)a)->name, ((const Asset_Entry*)b)->name);
+}
+
+// false when the file can't be written or two assets have the same name
+static b32 asset_pack_write(Asset_Pack_Builder* builder, const char* file_name) {
+    qsort(builder->toc.ptr(), builder->toc.len(), sizeof (Asset_Entry), asset__compare_entries);
+    for_i (1, builder->toc.len()) {
+        if (!strcmp(builder->toc[i - 1].name, builder->toc[i].name)) { return false; }
+    }
+
+    u64 start   = (sizeof (Asset_Pack_Header) + builder->toc.len() * sizeof (Asset_Entry) + 15) & ~15ull;
+    u64 size    = start + builder->data.len();
+
+    File_Map file;
+    if (!file_map_write(&file, file_name, size)) { return false; }
+
+    Asset_Pack_Header header = { ASSET_PACK_MAGIC, ASSET_PACK_VERSION, (u32)builder->toc.len(), 0, size };
+    memcpy(file.data, &header, sizeof (header));
+
+    Asset_Entry* toc = (Asset_Entry*)(file.data + sizeof (header));
+    for_i (0, builder->toc.len()) {
+        toc[i]          = builder->toc[i];
+        toc[i].offset  += start;
+    }
+    if (builder->data.len()) { memcpy(file.data + start, builder->data.ptr(), builder->data.len()); }
+
+    file_unmap(&file);
+    return true;
+}
+
+static void asset_pack_builder_destroy(Asset_Pack_Builder* builder) {
+    builder->toc.destroy();
+    builder->data.destroy();
+}
+
+// ================================================ MATH 2D =========================================== //
+
+struct v2 { r32 x, y; };
+
+inline constexpr void  operator+=(v2& a, v2 b)   { a.x += b.x;  a.y += b.y; }
+inline constexpr void  operator-=(v2& a, v2 b)   { a.x -= b.x;  a.y -= b.y; }
+inline constexpr void  operator*=(v2& a, r32 s)  { a.x *= s;    a.y *= s; }
+inline constexpr void  operator/=(v2& a, r32 s)  { a.x /= s;    a.y /= s; }
+
+inline constexpr v2    operator+ (v2 a, v2 b)    { return { a.x + b.x, a.y + b.y }; }
+inline constexpr v2    operator- (v2 a, v2 b)    { return { a.x - b.x, a.y - b.y }; }
+
+inline constexpr v2    operator* (v2 a, r32 s)   { return { a.x * s, a.y * s }; }
+inline constexpr v2    operator* (r32 s, v2 a)   { return { a.x * s, a.y * s }; }
+
+inline constexpr v2    operator/ (v2  a, r32 s)  { return { a.x / s, a.y / s }; }
+inline constexpr v2    operator/ (r32 s, v2  a)  { return { a.x / s, a.y / s }; }
+
+inline constexpr r32   dot          (v2 a, v2 b)    { return a.x * b.x + a.y * b.y; }
+inline constexpr r32   len_sq       (v2 a)          { return dot(a, a); }
+inline constexpr r32   len          (v2 a)          { return sqrtf(dot(a, a)); }
+inline constexpr r32   rlen         (v2 a)          { return rsqrt(dot(a, a)); }
+inline constexpr v2    norm         (v2 a)          { return a * rlen(a); }
+inline constexpr r32   dist         (v2 a, v2 b)    { return len(a - b);  }
+inline constexpr r32   dist_sq      (v2 a, v2 b)    { return len_sq(a - b); }
+
+inline constexpr r32   det          (v2 a, v2 b)    { return a.x * b.y - b.x * a.y; }
+inline constexpr r32   cross        (v2 a, v2 b)    { return a.x * b.y - a.y * b.x; }
+
+//inline constexpr v2 lerp(v2 a, v2 b, r32 t) { return { lerp(a.x, b.x, t), lerp(a.y, b.y, t) }; }
+
+// HERE
+inline constexpr r32 get_angle(v2 a, v2 b) { return atan2f(det(a, b), dot(a, b)); }
+
+inline constexpr v2 get_dir(v2 from, v2 to) {
+    return norm(to - from);
+}
+
+inline constexpr v2 round(v2 a) { return { roundf(a.x), roundf(a.y) }; }
+
+inline constexpr v2 rotate_args(v2 a, r32 c, r32 s) {
+    return { a.x * c - a.y * s, a.x * s + a.y * c };
+}
+
+inline constexpr v2 rotate(v2 a, r32 rad) {
+    r32 c = cosf(rad);
+    r32 s = sinf(rad);
+
+    return { a.x * c - a.y * s, a.x * s + a.y * c };
+}
+
+inline constexpr void rotate_us(v2* us, i32 size, r32 rad) {
+    r32 c = cosf(rad);
     r32 s = sinf(rad);
 
     for (i32 i = 0; i < size; i++) {
@@ -422,6 +1262,95 @@ inline constexpr v4  norm     (v4 a)       { return a * rlen(a); }
 inline constexpr r32 dist     (v4 a, v4 b) { return len(a - b);  }
 inline constexpr r32 dist_sq  (v4 a, v4 b) { return len_sq(a - b); }
 
+// ================================================ MATRIX 4x4 ======================================== //
+
+// column major like GL wants it, e[col * 4 + row]
+struct m4 { r32 e[16]; };
+
+inline constexpr m4 m4_identity() { return { { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } }; }
+
+inline constexpr m4 operator*(m4 a, m4 b) {
+    m4 r = {};
+    for (int c = 0; c < 4; ++c) {
+        for (int k = 0; k < 4; ++k) {
+            for (int row = 0; row < 4; ++row) {
+                r.e[c * 4 + row] += a.e[k * 4 + row] * b.e[c * 4 + k];
+            }
+        }
+    }
+    return r;
+}
+
+inline constexpr v4 operator*(m4 a, v4 u) {
+    return {
+        a.e[0] * u.x + a.e[4] * u.y + a.e[8]  * u.z + a.e[12] * u.w,
+        a.e[1] * u.x + a.e[5] * u.y + a.e[9]  * u.z + a.e[13] * u.w,
+        a.e[2] * u.x + a.e[6] * u.y + a.e[10] * u.z + a.e[14] * u.w,
+        a.e[3] * u.x + a.e[7] * u.y + a.e[11] * u.z + a.e[15] * u.w,
+    };
+}
+
+// 1 / tan of half the fov (in degrees), in double and rounded once: a tanf the compiler folds and one from libm
+// can be an ulp apart, and which of them a build gets depends on what was inlined, so the frames would too.
+static r32 fov_scale(r32 fov) { return (r32)(1.0 / tan(fov * (PI / 360.0))); }
+
+// same matrix as gluPerspective, fov in degrees!
+static m4 m4_perspective(r32 fov, r32 aspect, r32 near_plane, r32 far_plane) {
+    r32 f = fov_scale(fov);
+    r32 d = near_plane - far_plane;
+
+    return { {
+        f / aspect, 0,  0,                                      0,
+        0,          f,  0,                                      0,
+        0,          0,  (far_plane + near_plane) / d,           -1,
+        0,          0,  2.0f * far_plane * near_plane / d,      0,
+    } };
+}
+
+// same matrix as gluLookAt
+static m4 m4_look_at(v3 eye, v3 target, v3 up) {
+    v3 f = norm(target - eye);
+    v3 s = norm(cross(f, up));
+    v3 u = cross(s, f);
+
+    return { {
+        s.x,            u.x,            -f.x,           0,
+        s.y,            u.y,            -f.y,           0,
+        s.z,            u.z,            -f.z,           0,
+        -dot(s, eye),   -dot(u, eye),   dot(f, eye),    1,
+    } };
+}
+
+// cofactor expansion, returns the identity for a singular matrix!
+static m4 m4_inverse(m4 m) {
+    const r32* a = m.e;
+    m4 r;
+    r32* o = r.e;
+
+    o[0]  =  a[5]*a[10]*a[15] - a[5]*a[11]*a[14] - a[9]*a[6]*a[15] + a[9]*a[7]*a[14] + a[13]*a[6]*a[11] - a[13]*a[7]*a[10];
+    o[4]  = -a[4]*a[10]*a[15] + a[4]*a[11]*a[14] + a[8]*a[6]*a[15] - a[8]*a[7]*a[14] - a[12]*a[6]*a[11] + a[12]*a[7]*a[10];
+    o[8]  =  a[4]*a[9]*a[15]  - a[4]*a[11]*a[13] - a[8]*a[5]*a[15] + a[8]*a[7]*a[13] + a[12]*a[5]*a[11] - a[12]*a[7]*a[9];
+    o[12] = -a[4]*a[9]*a[14]  + a[4]*a[10]*a[13] + a[8]*a[5]*a[14] - a[8]*a[6]*a[13] - a[12]*a[5]*a[10] + a[12]*a[6]*a[9];
+    o[1]  = -a[1]*a[10]*a[15] + a[1]*a[11]*a[14] + a[9]*a[2]*a[15] - a[9]*a[3]*a[14] - a[13]*a[2]*a[11] + a[13]*a[3]*a[10];
+    o[5]  =  a[0]*a[10]*a[15] - a[0]*a[11]*a[14] - a[8]*a[2]*a[15] + a[8]*a[3]*a[14] + a[12]*a[2]*a[11] - a[12]*a[3]*a[10];
+    o[9]  = -a[0]*a[9]*a[15]  + a[0]*a[11]*a[13] + a[8]*a[1]*a[15] - a[8]*a[3]*a[13] - a[12]*a[1]*a[11] + a[12]*a[3]*a[9];
+    o[13] =  a[0]*a[9]*a[14]  - a[0]*a[10]*a[13] - a[8]*a[1]*a[14] + a[8]*a[2]*a[13] + a[12]*a[1]*a[10] - a[12]*a[2]*a[9];
+    o[2]  =  a[1]*a[6]*a[15]  - a[1]*a[7]*a[14]  - a[5]*a[2]*a[15] + a[5]*a[3]*a[14] + a[13]*a[2]*a[7]  - a[13]*a[3]*a[6];
+    o[6]  = -a[0]*a[6]*a[15]  + a[0]*a[7]*a[14]  + a[4]*a[2]*a[15] - a[4]*a[3]*a[14] - a[12]*a[2]*a[7]  + a[12]*a[3]*a[6];
+    o[10] =  a[0]*a[5]*a[15]  - a[0]*a[7]*a[13]  - a[4]*a[1]*a[15] + a[4]*a[3]*a[13] + a[12]*a[1]*a[7]  - a[12]*a[3]*a[5];
+    o[14] = -a[0]*a[5]*a[14]  + a[0]*a[6]*a[13]  + a[4]*a[1]*a[14] - a[4]*a[2]*a[13] - a[12]*a[1]*a[6]  + a[12]*a[2]*a[5];
+    o[3]  = -a[1]*a[6]*a[11]  + a[1]*a[7]*a[10]  + a[5]*a[2]*a[11] - a[5]*a[3]*a[10] - a[9]*a[2]*a[7]   + a[9]*a[3]*a[6];
+    o[7]  =  a[0]*a[6]*a[11]  - a[0]*a[7]*a[10]  - a[4]*a[2]*a[11] + a[4]*a[3]*a[10] + a[8]*a[2]*a[7]   - a[8]*a[3]*a[6];
+    o[11] = -a[0]*a[5]*a[11]  + a[0]*a[7]*a[9]   + a[4]*a[1]*a[11] - a[4]*a[3]*a[9]  - a[8]*a[1]*a[7]   + a[8]*a[3]*a[5];
+    o[15] =  a[0]*a[5]*a[10]  - a[0]*a[6]*a[9]   - a[4]*a[1]*a[10] + a[4]*a[2]*a[9]  + a[8]*a[1]*a[6]   - a[8]*a[2]*a[5];
+
+    r32 det = a[0] * o[0] + a[1] * o[4] + a[2] * o[8] + a[3] * o[12];
+    if (det == 0) { return m4_identity(); }
+
+    for_i (0, 16) { o[i] /= det; }
+    return r;
+}
+
 // =================================================== RECT 2D ====================================================== //
 
 struct Rect2 {
@@ -509,6 +1438,20 @@ static Rnd_Gen default_rnd = { 123456789u, 362436069u, 521288629u };
 inline static int randi  (int min, int max) { return min + default_rnd.gen() % (max - min); }
 inline static r32 randf  (r32 min, r32 max) { return min + ((r32)default_rnd.gen() / (r32)0xFFFFFFFF) * (max - min);  }
 
+// independent generator for a stream id, the same id gives the same numbers on every thread!
+inline static Rnd_Gen rnd_stream(u32 id) {
+    u64 h = id * 0x9E3779B97F4A7C15ull + 0x632BE59BD9B4E019ull;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    h =  h ^ (h >> 31);
+
+    // xorshift must never be all zero!
+    return { (u32)h | 1u, (u32)(h >> 32), 521288629u ^ id };
+}
+
+inline static int randi  (Rnd_Gen* rnd, int min, int max) { return min + rnd->gen() % (max - min); }
+inline static r32 randf  (Rnd_Gen* rnd, r32 min, r32 max) { return min + ((r32)rnd->gen() / (r32)0xFFFFFFFF) * (max - min);  }
+
 inline static v2 randv2(r32 min, r32 max) {
     return randf(min, max) * norm(v2 { r32(default_rnd.gen()), r32(default_rnd.gen()) });
 }
@@ -521,146 +1464,1107 @@ inline static v3 randv3(r32 min, r32 max) {
 
 typedef r32 Timer;
 
-static Timer    timer_create()                   { return (r32)glfwGetTime(); }
-static r32      timer_elapsed(const Timer* t)    { return (r32)glfwGetTime() - *t; }
-static r32      timer_restart(Timer* t)          { r32 e = timer_elapsed(t); *t = (r32)glfwGetTime(); return e; }
+#ifndef ATS_HEADLESS
+static r64      timer_now()                      { return glfwGetTime(); }
+#else
+static r64      timer_now()                      { return std::chrono::duration<r64>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+#endif
+
+static Timer    timer_create()                   { return (r32)timer_now(); }
+static r32      timer_elapsed(const Timer* t)    { return (r32)timer_now() - *t; }
+static r32      timer_restart(Timer* t)          { r32 e = timer_elapsed(t); *t = (r32)timer_now(); return e; }
+
+// ======================================= RENDER TRACE ==================================== //
+
+// @NOTE: opt in with ATS_RENDER_TRACE, without it the RENDER_TRACE_* macros compile to nothing! Counts what the
+// render api is asked for (render_cube, ...) and what the backend makes of it (draw calls, vertices, uploads,
+// state changes), per phase of a frame. A frame runs from window_clear to window_update, a phase from
+// RENDER_TRACE_PHASE("name") to the next one or the end of the frame, everything outside a named phase is "other".
+// RENDER_TRACE_PHASE flushes the batches first so every draw call is counted in the phase that filled it, a traced
+// frame can have a draw call more per phase than an untraced one.
+//
+// render_trace_open writes every frame as chrome trace events (chrome://tracing or ui.perfetto.dev) and/or prints
+// the average frame of the last summary_every frames to stderr.
+
+#ifdef ATS_RENDER_TRACE
+
+enum Render_Trace_Counter {
+    RENDER_TRACE_CUBES,             // render_cube
+    RENDER_TRACE_RECTANGLES,        // render_rectangle
+    RENDER_TRACE_TRIANGLES,         // render_triangle
+    RENDER_TRACE_VERTEX_ARRAYS,     // vertex_array_render
+    RENDER_TRACE_DRAW_CALLS,        // tile passes of the software renderer
+    RENDER_TRACE_VERTICES,          // of every instance
+    RENDER_TRACE_INSTANCES,
+    RENDER_TRACE_UPLOAD_BYTES,
+    RENDER_TRACE_PROGRAM_BINDS,
+    RENDER_TRACE_STATE_CHANGES,     // binds, uniforms, enable/disable
+    RENDER_TRACE_COUNTERS
+};
+
+static const char* render_trace_counter_names[RENDER_TRACE_COUNTERS] = {
+    "cubes", "rectangles", "triangles", "vertex_arrays", "draw_calls",
+    "vertices", "instances", "upload_bytes", "program_binds", "state_changes",
+};
+
+#define RENDER_TRACE_MAX_PHASES 16
+
+struct Render_Trace_Phase {
+    const char* name;
+    r64         seconds;                            // since the last summary
+    u64         counts[RENDER_TRACE_COUNTERS];      // since the last summary
+};
+
+struct Render_Trace {
+    FILE*               json;
+    i64                 events;
+    i32                 summary_every;              // frames, 0 for no summary
+    i32                 summary_frames;
+    i64                 frame;
+
+    r64                 origin;                     // trace time 0
+    r64                 frame_start;
+    r64                 phase_start;
+    i32                 phase;
+    i32                 phase_count;
+    u64                 open[RENDER_TRACE_COUNTERS];    // of the phase running now
+    u64                 frame_counts[RENDER_TRACE_COUNTERS];
+    Render_Trace_Phase  phases[RENDER_TRACE_MAX_PHASES];
+};
+
+static Render_Trace render_trace = { NULL, 0, 0, 0, 0, 0, 0, 0, 0, 1, {}, {}, { { "other" } } };
+
+static void render_trace__event(const char* name, const char* ph, r64 start, r64 seconds, const u64* counts) {
+    Render_Trace* rt = &render_trace;
+
+    fprintf(rt->json, "%s\n{\"name\":\"%s\",\"cat\":\"render\",\"ph\":\"%s\",\"pid\":1,\"tid\":1,\"ts\":%.3f",
+            rt->events++? "," : "", name, ph, (start - rt->origin) * 1e6);
+    if (seconds >= 0) { fprintf(rt->json, ",\"dur\":%.3f", seconds * 1e6); }
+    fprintf(rt->json, ",\"args\":{");
+    b32 first = true;
+    for_i (0, RENDER_TRACE_COUNTERS) {
+        if (!counts[i]) { continue; }
+        fprintf(rt->json, "%s\"%s\":%llu", first? "" : ",", render_trace_counter_names[i], (unsigned long long)counts[i]);
+        first = false;
+    }
+    fprintf(rt->json, "}}");
+}
+
+static void render_trace__close_phase(r64 now) {
+    Render_Trace*       rt      = &render_trace;
+    Render_Trace_Phase* phase   = &rt->phases[rt->phase];
+
+    b32 empty = true;
+    for_i (0, RENDER_TRACE_COUNTERS) {
+        phase->counts[i]        += rt->open[i];
+        rt->frame_counts[i]     += rt->open[i];
+        empty                   &= !rt->open[i];
+    }
+    phase->seconds += now - rt->phase_start;
+
+    if (rt->json && !empty) { render_trace__event(phase->name, "X", rt->phase_start, now - rt->phase_start, rt->open); }
+
+    memset(rt->open, 0, sizeof rt->open);
+    rt->phase_start = now;
+}
+
+static void render_trace__summary() {
+    Render_Trace* rt = &render_trace;
+
+    fprintf(stderr, "render trace: frames %lld .. %lld, per frame\n",
+            (long long)(rt->frame - rt->summary_frames), (long long)rt->frame - 1);
+    for_i (0, rt->phase_count) {
+        Render_Trace_Phase* phase = &rt->phases[i];
+        fprintf(stderr, "  %-12s %8.3f ms", phase->name, phase->seconds * 1e3 / rt->summary_frames);
+        for_j (0, RENDER_TRACE_COUNTERS) {
+            if (phase->counts[j]) {
+                fprintf(stderr, "  %s %.1f", render_trace_counter_names[j], (r64)phase->counts[j] / rt->summary_frames);
+            }
+        }
+        fprintf(stderr, "\n");
+
+        phase->seconds = 0;
+        memset(phase->counts, 0, sizeof phase->counts);
+    }
+    rt->summary_frames = 0;
+}
+
+// json_path can be NULL, so can summary_every be 0
+static b32 render_trace_open(const char* json_path, i32 summary_every) {
+    Render_Trace* rt = &render_trace;
+
+    if (json_path) {
+        rt->json = fopen(json_path, "w");
+        if (!rt->json) { return false; }
+        fprintf(rt->json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    }
+    rt->summary_every   = summary_every;
+    rt->origin          = timer_now();
+    rt->frame_start     = rt->origin;
+    rt->phase_start     = rt->origin;
+    return true;
+}
+
+static void render_trace_close() {
+    Render_Trace* rt = &render_trace;
+
+    if (rt->json) {
+        fprintf(rt->json, "\n]}\n");
+        fclose(rt->json);
+        rt->json = NULL;
+    }
+    rt->summary_every = 0;
+}
+
+// the phase everything is counted in until the next one, name has to outlive the trace (a string literal)
+static void render_trace_phase(const char* name) {
+    Render_Trace* rt = &render_trace;
+
+    render_trace__close_phase(timer_now());
+
+    i32 i = 0;
+    while (i < rt->phase_count && strcmp(rt->phases[i].name, name)) { ++i; }
+    if (i == rt->phase_count) {
+        if (i == RENDER_TRACE_MAX_PHASES) { i = 0; }
+        else { rt->phases[rt->phase_count++] = { name }; }
+    }
+    rt->phase = i;
+}
+
+static void render_trace_frame_begin() {
+    Render_Trace* rt = &render_trace;
+
+    rt->frame_start = timer_now();
+    rt->phase_start = rt->frame_start;
+    rt->phase       = 0;
+}
+
+static void render_trace_frame_end() {
+    Render_Trace* rt = &render_trace;
+
+    r64 now = timer_now();
+    render_trace__close_phase(now);
+
+    if (rt->json) {
+        char name[32];
+        snprintf(name, sizeof name, "frame %lld", (long long)rt->frame);
+        render_trace__event(name, "X", rt->frame_start, now - rt->frame_start, rt->frame_counts);
+        render_trace__event("frame", "C", rt->frame_start, -1, rt->frame_counts);
+    }
+    memset(rt->frame_counts, 0, sizeof rt->frame_counts);
+
+    rt->frame++;
+    rt->summary_frames++;
+    if (rt->summary_every > 0 && rt->summary_frames >= rt->summary_every) { render_trace__summary(); }
+
+    rt->phase = 0;
+}
+
+#define RENDER_TRACE_COUNT(counter, n)  (render_trace.open[RENDER_TRACE_##counter] += (u64)(n))
+#define RENDER_TRACE_PHASE(name)        (render_flush(), render_trace_phase(name))
+#define RENDER_TRACE_FRAME_BEGIN()      render_trace_frame_begin()
+#define RENDER_TRACE_FRAME_END()        render_trace_frame_end()
+
+#else
+
+#define RENDER_TRACE_COUNT(counter, n)  ((void)0)
+#define RENDER_TRACE_PHASE(name)        ((void)0)
+#define RENDER_TRACE_FRAME_BEGIN()      ((void)0)
+#define RENDER_TRACE_FRAME_END()        ((void)0)
+
+#endif // ATS_RENDER_TRACE
 
 // ======================================= TEXTURES ======================================== //
 
-#ifdef ATS_TEXTURES
+#if defined(ATS_TEXTURES) && !defined(ATS_HEADLESS)
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include "stb_image.h" 
+
+struct Texture {
+    u32         id;
+    i32         width;
+    i32         height;
+    b32         loaded;     // false while it still shows the placeholder (texture_load_async)
+};
+
+static void texture__upload(Texture* texture, const u8* pixels, i32 w, i32 h, i32 is_smooth) {
+    if (!texture->loaded) { glGenTextures(1, &texture->id); }
+
+    texture->width  = w;
+    texture->height = h;
+    texture->loaded = true;
+
+    glBindTexture(GL_TEXTURE_2D, texture->id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    RENDER_TRACE_COUNT(UPLOAD_BYTES, (i64)w * h * 4);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, is_smooth ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, is_smooth ? GL_LINEAR : GL_NEAREST);
+}
+
+static Texture texture_load(const char* path, i32 is_smooth) {
+    Texture texture = {0};
+    i32 channels    = 0;
+    u8* pixels      = NULL;
+
+    // always 4 channels, the upload is GL_RGBA no matter what the png has
+    pixels = stbi_load(path, &texture.width, &texture.height, &channels, 4);
+
+    assert(pixels);
+
+    texture__upload(&texture, pixels, texture.width, texture.height, is_smooth);
+
+    stbi_image_free(pixels);
+
+    return texture;
+}
+
+static void texture_bind(const Texture* texture) {
+    glBindTexture(GL_TEXTURE_2D, texture->id);
+}
+
+// uploads straight from the mapped pack, a texture that is not in it is not loaded (texture.loaded false)
+static Texture texture_from_pack(const Asset_Pack* pack, const char* name, i32 is_smooth) {
+    Texture             texture = {0};
+    const Asset_Entry*  entry   = asset_pack_find(pack, name);
+
+    if (entry && entry->type == ASSET_TEXTURE && entry->format == ASSET_FORMAT_RGBA8 &&
+        entry->size == (u64)entry->width * entry->height * 4) {
+        texture__upload(&texture, asset_pack_data(pack, entry), entry->width, entry->height, is_smooth);
+    }
+
+    return texture;
+}
+
+// ==================================== ASYNC TEXTURES ===================================== //
+
+// texture_load_async returns right away, the texture shows a placeholder until its png is
+// decoded on the loader thread and uploaded by texture_upload_pending on the main thread.
+// window_update uploads at most ATS_TEXTURE_UPLOAD_BUDGET bytes of pixels per frame, so
+// loading many textures never stalls a frame on decoding or on one big upload burst.
+//
+// @NOTE: the Texture has to stay where it is until it is loaded, the upload writes into it!
+// A png that can't be decoded keeps the placeholder and is reported on stderr.
+
+#ifndef ATS_TEXTURE_UPLOAD_BUDGET
+#define ATS_TEXTURE_UPLOAD_BUDGET (4 << 20)
+#endif
+
+struct Texture_Request {
+    Texture*    texture;
+    i32         is_smooth;
+    char        path[256];
+};
+
+struct Texture_Decoded {
+    Texture_Request request;
+    u8*             pixels;     // NULL when decoding failed
+    i32             width;
+    i32             height;
+};
+
+struct Texture_Loader {
+    Spsc_Queue<Texture_Request, 64>     requests;   // main thread -> loader thread
+    Spsc_Queue<Texture_Decoded, 64>     decoded;    // loader thread -> main thread
+    Array<Texture_Request>              backlog;    // requests that did not fit into the queue yet
+    std::thread                         thread;
+    std::atomic<int>                    running;
+    std::atomic<int>                    pending;    // requested but not uploaded yet
+    u32                                 placeholder;
+};
+
+static Texture_Loader texture_loader;
+
+static void texture__loader_thread() {
+    PROFILE_THREAD_NAME("texture loader");
+    Texture_Loader* loader = &texture_loader;
+    Texture_Request request;
+
+    while (loader->running.load(std::memory_order_relaxed)) {
+        if (!loader->requests.pop(&request)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        Texture_Decoded result  = {};
+        i32 channels            = 0;
+        result.request          = request;
+        result.pixels           = stbi_load(request.path, &result.width, &result.height, &channels, 4);
+
+        while (!loader->decoded.push(result)) {
+            if (!loader->running.load(std::memory_order_relaxed)) {
+                stbi_image_free(result.pixels);
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+// 2x2 magenta and black, the usual "not there yet"
+static u32 texture__placeholder() {
+    if (!texture_loader.placeholder) {
+        const u8 pixels[] = { 255, 0, 255, 255,   0, 0, 0, 255,
+                              0, 0, 0, 255,       255, 0, 255, 255 };
+        Texture texture = {};
+        texture__upload(&texture, pixels, 2, 2, false);
+        texture_loader.placeholder = texture.id;
+    }
+    return texture_loader.placeholder;
+}
+
+static void texture_load_async(Texture* texture, const char* path, i32 is_smooth) {
+    Texture_Loader* loader = &texture_loader;
+
+    texture->id     = texture__placeholder();
+    texture->width  = 2;
+    texture->height = 2;
+    texture->loaded = false;
+
+    if (!loader->thread.joinable()) {
+        loader->running = 1;
+        loader->thread  = std::thread(texture__loader_thread);
+    }
+
+    Texture_Request request = { texture, is_smooth };
+    snprintf(request.path, sizeof (request.path), "%s", path);
+
+    loader->pending++;
+    if (loader->backlog.len() || !loader->requests.push(request)) {
+        loader->backlog.add(request);
+    }
+}
+
+// main thread, with the context current. Uploads decoded textures until budget bytes are
+// done, at least one so a texture bigger than the budget still gets through.
+static void texture_upload_pending(size_t budget) {
+    Texture_Loader* loader = &texture_loader;
+
+    i64 sent = 0;
+    while (sent < loader->backlog.len() && loader->requests.push(loader->backlog[sent])) { sent++; }
+    for_i (0, loader->backlog.len() - sent) { loader->backlog[i] = loader->backlog[i + sent]; }
+    loader->backlog.resize(loader->backlog.len() - sent);
+
+    size_t          uploaded = 0;
+    Texture_Decoded result;
+
+    while (uploaded < budget && loader->decoded.pop(&result)) {
+        Texture_Request* request = &result.request;
+
+        if (result.pixels) {
+            texture__upload(request->texture, result.pixels, result.width, result.height, request->is_smooth);
+            uploaded += (size_t)result.width * result.height * 4;
+            stbi_image_free(result.pixels);
+        } else {
+            fprintf(stderr, "texture_load_async: could not load %s\n", request->path);
+        }
+
+        loader->pending--;
+    }
+}
+
+// requested textures that are not uploaded yet
+static i32 texture_pending_count() {
+    return texture_loader.pending.load();
+}
+
+static void texture_loader_shutdown() {
+    Texture_Loader* loader = &texture_loader;
+
+    if (loader->thread.joinable()) {
+        loader->running = 0;
+        loader->thread.join();
+    }
+
+    Texture_Decoded result;
+    while (loader->decoded.pop(&result)) { stbi_image_free(result.pixels); }
+
+    Texture_Request request;
+    while (loader->requests.pop(&request)) {}
+
+    loader->backlog.destroy();
+    loader->pending = 0;
+}
+
+#endif
+
+// =============================================== VERTEX ARRAY ========================================= //
+
+union Vertex {
+    struct {
+        v3      pos;
+        Color   color;
+    };
+
+    struct {
+        r32         x;
+        r32         y;
+        r32         z;
+        //
+        u8          r;
+        u8          g;
+        u8          b;
+        u8          a;
+    };
+};
+
+typedef Array<Vertex> Vertex_Array;
+
+inline static void vertex_array_add_rectangle(Vertex_Array* verts,
+                                              r32 px,   r32 py,
+                                              r32 qx,   r32 qy,
+                                              r32 z, 
+                                              u8  r, u8 g, u8 b, u8 a) {
+    verts->add({ px, py, z, r, g, b, a });
+    verts->add({ px, qy, z, r, g, b, a });
+    verts->add({ qx, py, z, r, g, b, a });
+    verts->add({ px, qy, z, r, g, b, a });
+    verts->add({ qx, qy, z, r, g, b, a });
+    verts->add({ qx, py, z, r, g, b, a });
+}
+
+inline static void add_vertex(Vertex_Array* verts, v2 pos, r32 z, Color color) {
+    verts->add({ pos.x, pos.y, z, color.r, color.g, color.b, color.a });
+}
+
+static void vertex_array_add_triangle(Vertex_Array* verts, v3 p, v3 q, v3 r, Color color) {
+    verts->add({ p, color });
+    verts->add({ q, color });
+    verts->add({ r, color });
+}
+
+static void vertex_array_add_box(Vertex_Array* verts, v3 min, v3 max, Color color) {
+    verts->add({ v3 { min.x, min.y, min.z }, color });
+    verts->add({ v3 { max.x, min.y, min.z }, color });
+    verts->add({ v3 { min.x, max.y, min.z }, color });
+    verts->add({ v3 { max.x, max.y, min.z }, color });
+    verts->add({ v3 { min.x, max.y, min.z }, color });
+    verts->add({ v3 { max.x, min.y, min.z }, color });
+    //
+    verts->add({ v3 { min.x, min.y, max.z }, color });
+    verts->add({ v3 { max.x, min.y, max.z }, color });
+    verts->add({ v3 { min.x, max.y, max.z }, color });
+    verts->add({ v3 { max.x, max.y, max.z }, color });
+    verts->add({ v3 { min.x, max.y, max.z }, color });
+    verts->add({ v3 { max.x, min.y, max.z }, color });
+    //
+    verts->add({ v3 { min.x, min.y, min.z }, color });
+    verts->add({ v3 { min.x, max.y, min.z }, color });
+    verts->add({ v3 { min.x, min.y, max.z }, color });
+    verts->add({ v3 { min.x, max.y, max.z }, color });
+    verts->add({ v3 { min.x, min.y, max.z }, color });
+    verts->add({ v3 { min.x, max.y, min.z }, color });
+    //
+    verts->add({ v3 { max.x, min.y, min.z }, color });
+    verts->add({ v3 { max.x, max.y, min.z }, color });
+    verts->add({ v3 { max.x, min.y, max.z }, color });
+    verts->add({ v3 { max.x, max.y, max.z }, color });
+    verts->add({ v3 { max.x, min.y, max.z }, color });
+    verts->add({ v3 { max.x, max.y, min.z }, color });
+    //
+    verts->add({ v3 { min.x, min.y, min.z }, color });
+    verts->add({ v3 { max.x, min.y, min.z }, color });
+    verts->add({ v3 { min.x, min.y, max.z }, color });
+    verts->add({ v3 { max.x, min.y, max.z }, color });
+    verts->add({ v3 { min.x, min.y, max.z }, color });
+    verts->add({ v3 { max.x, min.y, min.z }, color });
+    //
+    verts->add({ v3 { min.x, max.y, min.z }, color });
+    verts->add({ v3 { max.x, max.y, min.z }, color });
+    verts->add({ v3 { min.x, max.y, max.z }, color });
+    verts->add({ v3 { max.x, max.y, max.z }, color });
+    verts->add({ v3 { min.x, max.y, max.z }, color });
+    verts->add({ v3 { max.x, max.y, min.z }, color });
+}
+
+// same faces as the cube mesh of render_cube, for building meshes of cubes that are drawn with
+// vertex_array_render (render_cube itself only needs the cube's bounds, not 24 vertices)!
+static void vertex_array_add_cube(Vertex_Array* verts, r32 px, r32 py, r32 qx, r32 qy, r32 pz, r32 qz, u8 r, u8 g, u8 b, u8 a) {
+    const v3 quads[4][4] = {
+        { { px, py, pz }, { qx, py, pz }, { qx, qy, pz }, { px, qy, pz } },     // UP
+        { { px, qy, pz }, { px, qy, qz }, { qx, qy, qz }, { qx, qy, pz } },     // Right
+        { { px, py, pz }, { px, py, qz }, { qx, py, qz }, { qx, py, pz } },     // LEFT
+        { { px, py, pz }, { px, py, qz }, { px, qy, qz }, { px, qy, pz } },     // FRONT
+    };
+
+    verts->grow(24);
+
+    Vertex* v = verts->ptr() + verts->len();
+    Color   c = { r, g, b, a };
+
+    for_i (0, 4) {
+        v[0] = { quads[i][0], c };
+        v[1] = { quads[i][1], c };
+        v[2] = { quads[i][2], c };
+        v[3] = { quads[i][0], c };
+        v[4] = { quads[i][2], c };
+        v[5] = { quads[i][3], c };
+        v += 6;
+    }
+
+    verts->_len += 24;
+}
+
+// ============================================== CUBE PREFAB ================================================ //
+
+// A cube that is drawn with the same shape over and over, only somewhere else and in another color: made
+// once with cube_prefab into a constexpr variable, so its center, half size and corners (relative to where it
+// is drawn) are worked out by the compiler. render_cube_prefab then only adds the position, on the GL path
+// that is one instance of the batch, on the software path the 8 corners before they are transformed. It
+// draws exactly like a render_cube with the same bounds, in the same batch and order.
+//
+// @NOTE: the position is only x and y, the prefab's z is where it is drawn.
+
+struct Cube_Prefab {
+    v3  center;
+    v3  half_size;
+    v3  corners[8];     // corner k has bit 0 set for qx, bit 1 for qy and bit 2 for qz
+};
+
+static constexpr Cube_Prefab cube_prefab(r32 px, r32 py, r32 qx, r32 qy, r32 pz, r32 qz) {
+    return {
+        { px + (qx - px) / 2, py + (qy - py) / 2, pz + (qz - pz) / 2 },
+        { (qx - px) / 2, (qy - py) / 2, (qz - pz) / 2 },
+        {
+            { px, py, pz }, { qx, py, pz }, { px, qy, pz }, { qx, qy, pz },
+            { px, py, qz }, { qx, py, qz }, { px, qy, qz }, { qx, qy, qz },
+        },
+    };
+}
+
+#ifndef ATS_HEADLESS
+
+// ================================================= OPENGL ================================================== //
+
+// @NOTE: the window has a 3.3 core profile context, there is no fixed function pipeline left: no glBegin/glEnd,
+// display lists, matrix stack or lights! Everything newer than GL 1.1 is loaded from the driver by window_create
+// (opengl32 on windows exports nothing newer) and called through gl, gl.BindVertexArray(vao) and so on.
+
+#define ATS_GL_FUNCTIONS(X)                                             \
+    X(PFNGLGENVERTEXARRAYSPROC,             GenVertexArrays)            \
+    X(PFNGLBINDVERTEXARRAYPROC,             BindVertexArray)            \
+    X(PFNGLGENBUFFERSPROC,                  GenBuffers)                 \
+    X(PFNGLBINDBUFFERPROC,                  BindBuffer)                 \
+    X(PFNGLBUFFERDATAPROC,                  BufferData)                 \
+    X(PFNGLVERTEXATTRIBPOINTERPROC,         VertexAttribPointer)        \
+    X(PFNGLENABLEVERTEXATTRIBARRAYPROC,     EnableVertexAttribArray)    \
+    X(PFNGLVERTEXATTRIBDIVISORPROC,         VertexAttribDivisor)        \
+    X(PFNGLDRAWARRAYSINSTANCEDPROC,         DrawArraysInstanced)        \
+    X(PFNGLCREATESHADERPROC,                CreateShader)               \
+    X(PFNGLSHADERSOURCEPROC,                ShaderSource)               \
+    X(PFNGLCOMPILESHADERPROC,               CompileShader)              \
+    X(PFNGLGETSHADERIVPROC,                 GetShaderiv)                \
+    X(PFNGLGETSHADERINFOLOGPROC,            GetShaderInfoLog)           \
+    X(PFNGLDELETESHADERPROC,                DeleteShader)               \
+    X(PFNGLCREATEPROGRAMPROC,               CreateProgram)              \
+    X(PFNGLATTACHSHADERPROC,                AttachShader)               \
+    X(PFNGLLINKPROGRAMPROC,                 LinkProgram)                \
+    X(PFNGLGETPROGRAMIVPROC,                GetProgramiv)               \
+    X(PFNGLGETPROGRAMINFOLOGPROC,           GetProgramInfoLog)          \
+    X(PFNGLUSEPROGRAMPROC,                  UseProgram)                 \
+    X(PFNGLGETUNIFORMLOCATIONPROC,          GetUniformLocation)         \
+    X(PFNGLUNIFORMMATRIX4FVPROC,            UniformMatrix4fv)
+
+struct Gl_Functions {
+#define X(type, name) type name;
+    ATS_GL_FUNCTIONS(X)
+#undef X
+};
+
+static Gl_Functions gl;
+
+static void gl__load_functions() {
+#define X(type, name) gl.name = (type)glfwGetProcAddress("gl" #name); assert(gl.name);
+    ATS_GL_FUNCTIONS(X)
+#undef X
+}
+
+static u32 gl__compile_shader(u32 type, const char* source) {
+    u32 shader = gl.CreateShader(type);
+    gl.ShaderSource(shader, 1, &source, NULL);
+    gl.CompileShader(shader);
+
+    i32 ok = 0;
+    gl.GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        gl.GetShaderInfoLog(shader, sizeof log, NULL, log);
+        fprintf(stderr, "shader: %s\n", log);
+    }
+    return shader;
+}
+
+static u32 gl_create_program(const char* vertex_source, const char* fragment_source) {
+    u32 vs      = gl__compile_shader(GL_VERTEX_SHADER, vertex_source);
+    u32 fs      = gl__compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+    u32 program = gl.CreateProgram();
+
+    gl.AttachShader(program, vs);
+    gl.AttachShader(program, fs);
+    gl.LinkProgram(program);
+    gl.DeleteShader(vs);
+    gl.DeleteShader(fs);
+
+    i32 ok = 0;
+    gl.GetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        gl.GetProgramInfoLog(program, sizeof log, NULL, log);
+        fprintf(stderr, "program: %s\n", log);
+    }
+    return program;
+}
+
+// ================================================= RENDER ================================================== //
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STBI_ONLY_PNG
-#include "stb_image.h" 
+// render_cube, render_rectangle and render_triangle don't draw right away, they append to a batch: a cube is
+// one instance (center, half size, color) of the same cube mesh, rectangles and triangles are colored vertices.
+// A batch goes out in one draw call as soon as something has to come after it: the other batch, a
+// vertex_array_render, a new view, render_set_depth_test or the end of the frame, so everything is still
+// drawn in the order it was called in!
 
-struct Texture {
-    u32         id;
-    i32         width;
-    i32         height;
+struct Cube_Instance {
+    v3      center;
+    v3      half_size;
+    Color   color;
 };
 
-static Texture texture_load(const char* path, i32 is_smooth) {
-    Texture texture = {0};
-    i32 channels    = 0;
-    u8* pixels      = NULL;
+struct Render_Batches {
+    u32                     cube_program;
+    u32                     color_program;
+    i32                     cube_view_proj;
+    i32                     color_view_proj;
 
-    pixels = stbi_load(path, &texture.width, &texture.height, &channels, 0);
+    u32                     cube_vao;
+    u32                     cube_mesh;
+    u32                     cube_instances;
+    u32                     color_vao;
+    u32                     color_verts;
 
-    assert(pixels);
+    m4                      view_proj;      // of the last window_update_view
+    r32                     pixel_scale;    // pixels of a length of 1 at a distance of 1 in front of that view
 
-    glGenTextures(1, &texture.id);
-    glBindTexture(GL_TEXTURE_2D, texture.id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture.width, texture.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    Array<Cube_Instance>    cubes;
+    Vertex_Array            verts;
+};
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, is_smooth ? GL_LINEAR : GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, is_smooth ? GL_LINEAR : GL_NEAREST);
+static Render_Batches render_batches;
+
+static const char* render__cube_vs =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 corner;\n"
+    "layout(location = 1) in vec3 center;\n"
+    "layout(location = 2) in vec3 half_size;\n"
+    "layout(location = 3) in vec4 color;\n"
+    "uniform mat4 view_proj;\n"
+    "out vec4 v_color;\n"
+    "void main() {\n"
+    "    gl_Position = view_proj * vec4(center + corner * half_size, 1.0);\n"
+    "    v_color = color;\n"
+    "}\n";
+
+static const char* render__color_vs =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 pos;\n"
+    "layout(location = 1) in vec4 color;\n"
+    "uniform mat4 view_proj;\n"
+    "out vec4 v_color;\n"
+    "void main() {\n"
+    "    gl_Position = view_proj * vec4(pos, 1.0);\n"
+    "    v_color = color;\n"
+    "}\n";
+
+// discard is the old alpha test (GL_GREATER 0), fully transparent pixels don't write depth
+static const char* render__color_fs =
+    "#version 330 core\n"
+    "in vec4 v_color;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "    if (v_color.a <= 0.0) discard;\n"
+    "    frag_color = v_color;\n"
+    "}\n";
+
+// called by window_create
+static void render_init() {
+    Render_Batches* rb = &render_batches;
+
+    rb->cube_program    = gl_create_program(render__cube_vs, render__color_fs);
+    rb->color_program   = gl_create_program(render__color_vs, render__color_fs);
+    rb->cube_view_proj  = gl.GetUniformLocation(rb->cube_program, "view_proj");
+    rb->color_view_proj = gl.GetUniformLocation(rb->color_program, "view_proj");
+    rb->view_proj       = m4_identity();
+    rb->pixel_scale     = 1;
+
+    // the four faces the game sees: UP, Right, LEFT, FRONT
+    const v3 quads[4][4] = {
+        { { -1, -1, -1 }, {  1, -1, -1 }, {  1,  1, -1 }, { -1,  1, -1 } },
+        { { -1,  1, -1 }, { -1,  1,  1 }, {  1,  1,  1 }, {  1,  1, -1 } },
+        { { -1, -1, -1 }, { -1, -1,  1 }, {  1, -1,  1 }, {  1, -1, -1 } },
+        { { -1, -1, -1 }, { -1, -1,  1 }, { -1,  1,  1 }, { -1,  1, -1 } },
+    };
+    v3 mesh[24];
+    for_i (0, 4) {
+        mesh[i * 6 + 0] = quads[i][0];
+        mesh[i * 6 + 1] = quads[i][1];
+        mesh[i * 6 + 2] = quads[i][2];
+        mesh[i * 6 + 3] = quads[i][0];
+        mesh[i * 6 + 4] = quads[i][2];
+        mesh[i * 6 + 5] = quads[i][3];
+    }
 
-    stbi_image_free(pixels);
+    gl.GenVertexArrays(1, &rb->cube_vao);
+    gl.BindVertexArray(rb->cube_vao);
+
+    gl.GenBuffers(1, &rb->cube_mesh);
+    gl.BindBuffer(GL_ARRAY_BUFFER, rb->cube_mesh);
+    gl.BufferData(GL_ARRAY_BUFFER, sizeof mesh, mesh, GL_STATIC_DRAW);
+    gl.EnableVertexAttribArray(0);
+    gl.VertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof (v3), (void*)0);
+
+    gl.GenBuffers(1, &rb->cube_instances);
+    gl.BindBuffer(GL_ARRAY_BUFFER, rb->cube_instances);
+    gl.EnableVertexAttribArray(1);
+    gl.EnableVertexAttribArray(2);
+    gl.EnableVertexAttribArray(3);
+    gl.VertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof (Cube_Instance), (void*)offsetof(Cube_Instance, center));
+    gl.VertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof (Cube_Instance), (void*)offsetof(Cube_Instance, half_size));
+    gl.VertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof (Cube_Instance), (void*)offsetof(Cube_Instance, color));
+    gl.VertexAttribDivisor(1, 1);
+    gl.VertexAttribDivisor(2, 1);
+    gl.VertexAttribDivisor(3, 1);
+
+    gl.GenVertexArrays(1, &rb->color_vao);
+    gl.BindVertexArray(rb->color_vao);
+
+    gl.GenBuffers(1, &rb->color_verts);
+    gl.BindBuffer(GL_ARRAY_BUFFER, rb->color_verts);
+    gl.EnableVertexAttribArray(0);
+    gl.EnableVertexAttribArray(1);
+    gl.VertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof (Vertex), (void*)offsetof(Vertex, x));
+    gl.VertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof (Vertex), (void*)offsetof(Vertex, r));
+
+    gl.BindVertexArray(0);
+}
 
-    return texture;
+// the buffer is respecified every draw, so the driver never has to wait for the draw before to finish reading it
+static void render__draw_verts(const Vertex* verts, i64 count) {
+    Render_Batches* rb = &render_batches;
+
+    gl.UseProgram(rb->color_program);
+    gl.UniformMatrix4fv(rb->color_view_proj, 1, GL_FALSE, rb->view_proj.e);
+    gl.BindVertexArray(rb->color_vao);
+    gl.BindBuffer(GL_ARRAY_BUFFER, rb->color_verts);
+    gl.BufferData(GL_ARRAY_BUFFER, count * sizeof (Vertex), verts, GL_STREAM_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, (i32)count);
+
+    RENDER_TRACE_COUNT(PROGRAM_BINDS, 1);
+    RENDER_TRACE_COUNT(STATE_CHANGES, 3);
+    RENDER_TRACE_COUNT(UPLOAD_BYTES, count * sizeof (Vertex));
+    RENDER_TRACE_COUNT(DRAW_CALLS, 1);
+    RENDER_TRACE_COUNT(VERTICES, count);
 }
 
-static void texture_bind(const Texture* texture) {
-    glBindTexture(GL_TEXTURE_2D, texture->id);
+static void render__flush_cubes() {
+    Render_Batches* rb = &render_batches;
+    if (!rb->cubes.len()) { return; }
+
+    gl.UseProgram(rb->cube_program);
+    gl.UniformMatrix4fv(rb->cube_view_proj, 1, GL_FALSE, rb->view_proj.e);
+    gl.BindVertexArray(rb->cube_vao);
+    gl.BindBuffer(GL_ARRAY_BUFFER, rb->cube_instances);
+    gl.BufferData(GL_ARRAY_BUFFER, rb->cubes.len() * sizeof (Cube_Instance), rb->cubes.ptr(), GL_STREAM_DRAW);
+    gl.DrawArraysInstanced(GL_TRIANGLES, 0, 24, (i32)rb->cubes.len());
+
+    RENDER_TRACE_COUNT(PROGRAM_BINDS, 1);
+    RENDER_TRACE_COUNT(STATE_CHANGES, 3);
+    RENDER_TRACE_COUNT(UPLOAD_BYTES, rb->cubes.len() * sizeof (Cube_Instance));
+    RENDER_TRACE_COUNT(DRAW_CALLS, 1);
+    RENDER_TRACE_COUNT(INSTANCES, rb->cubes.len());
+    RENDER_TRACE_COUNT(VERTICES, rb->cubes.len() * 24);
+
+    rb->cubes.clear();
 }
 
-#endif
+static void render__flush_verts() {
+    Render_Batches* rb = &render_batches;
+    if (!rb->verts.len()) { return; }
 
-// ================================================= OPENGL ================================================== //
+    render__draw_verts(rb->verts.ptr(), rb->verts.len());
+    rb->verts.clear();
+}
+
+// draws whatever is batched, only one of the two batches is ever filled
+static void render_flush() {
+    render__flush_cubes();
+    render__flush_verts();
+}
 
-static void gl_light_set (int light, int type, v4 arg) { glLightfv(GL_LIGHT0 + light, type, (r32*)&arg); }
-static void gl_light_set (int light, int type, r32 arg) { glLightf(GL_LIGHT0 + light, type, arg); }
+static void render_set_depth_test(b32 enabled) {
+    render_flush();
+    if (enabled)    { glEnable(GL_DEPTH_TEST); }
+    else            { glDisable(GL_DEPTH_TEST); }
+    RENDER_TRACE_COUNT(STATE_CHANGES, 1);
+}
 
-static void gl_light_set_ambient    (int light, v4 arg) { glLightfv(GL_LIGHT0 + light, GL_AMBIENT, (r32*)&arg); }
-static void gl_light_set_diffuse    (int light, v4 arg) { glLightfv(GL_LIGHT0 + light, GL_DIFFUSE, (r32*)&arg); }
-static void gl_light_set_specular   (int light, v4 arg) { glLightfv(GL_LIGHT0 + light, GL_SPECULAR, (r32*)&arg); }
-static void gl_light_set_position   (int light, v4 arg) { glLightfv(GL_LIGHT0 + light, GL_POSITION, (r32*)&arg); }
+static void render_rectangle(r32 px, r32 py, r32 qx, r32 qy, r32 z, u8 r, u8 g, u8 b, u8 a) {
+    RENDER_TRACE_COUNT(RECTANGLES, 1);
+    render__flush_cubes();
+    vertex_array_add_rectangle(&render_batches.verts, px, py, qx, qy, z, r, g, b, a);
+}
 
-static void gl_light_set_material(int face, int type, v4 color) { glMaterialfv(face, type, (r32*)&color); }
-static void gl_light_set_material(int face, int type, r32 val)  { glMaterialf(face, type, val); }
+static void render_cube(r32 px, r32 py, r32 qx, r32 qy, r32 pz, r32 qz, u8 r, u8 g, u8 b, u8 a) {
+    RENDER_TRACE_COUNT(CUBES, 1);
+    render__flush_verts();
+    render_batches.cubes.add({
+        { px + (qx - px) / 2, py + (qy - py) / 2, pz + (qz - pz) / 2 },
+        { (qx - px) / 2, (qy - py) / 2, (qz - pz) / 2 },
+        { r, g, b, a },
+    });
+}
 
-static void gl_light_global_ambient(v4 color) { glLightModelfv(GL_LIGHT_MODEL_AMBIENT, (r32*)&color); }
+static void render_cube_prefab(const Cube_Prefab* prefab, r32 x, r32 y, u8 r, u8 g, u8 b, u8 a) {
+    RENDER_TRACE_COUNT(CUBES, 1);
+    render__flush_verts();
+    render_batches.cubes.add({
+        { x + prefab->center.x, y + prefab->center.y, prefab->center.z },
+        prefab->half_size,
+        { r, g, b, a },
+    });
+}
 
-void gl_light_simple(int light, r32 bright, r32 x, r32 y, r32 z) {
-    r32 d = (r32) (1.0f / sqrtf(x*x+y*y+z*z));
+static void render_triangle(
+        r32 p0_x, r32 p0_y, r32 p0_z,
+        r32 p1_x, r32 p1_y, r32 p1_z,
+        r32 p2_x, r32 p2_y, r32 p2_z,
+        u8 r, u8 g, u8 b, u8 a) {
+    RENDER_TRACE_COUNT(TRIANGLES, 1);
+    render__flush_cubes();
+    vertex_array_add_triangle(&render_batches.verts, { p0_x, p0_y, p0_z }, { p1_x, p1_y, p1_z }, { p2_x, p2_y, p2_z }, { r, g, b, a });
+}
 
-    gl_light_set(light, GL_POSITION, { x * d, y * d, z * d, 0 });
-    gl_light_set(light, GL_DIFFUSE,  { bright, bright, bright, 0 });
-    gl_light_set(light, GL_AMBIENT,  {});
-    gl_light_set(light, GL_SPECULAR, {});
+// how many pixels a length of size at pos covers (whatever its direction, only the distance counts) with the view
+// of the last window_update_view, for picking a level of detail. Behind the camera it is huge.
+static r32 render_pixel_size(v3 pos, r32 size) {
+    v4 clip = render_batches.view_proj * v4 { pos.x, pos.y, pos.z, 1 };
+    if (clip.w <= 0) { return 1e30f; }
+    return size * render_batches.pixel_scale / clip.w;
+}
 
-    glEnable(GL_LIGHT0 + light);
-    glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
-    glEnable(GL_COLOR_MATERIAL);
+// draws right away, after the batches
+static void vertex_array_render(const Vertex_Array* verts) {
+    RENDER_TRACE_COUNT(VERTEX_ARRAYS, 1);
+    render_flush();
+    if (verts->len()) { render__draw_verts(verts->ptr(), verts->len()); }
 }
 
-// ================================================= WINDOW =================================================== //
+// =============================================== KEY EVENTS ================================================= //
 
 struct Key_Event {
     int         key;
     int         type;
+    r64         time;       // glfwGetTime() when the event was received
 };
 
 inline static b32 _is_key_event(Key_Event* e, int key, int type) { return e->key == key && e->type == type; }
 
 #define is_key_event(e, key, type)  _is_key_event(e, GLFW_KEY_##key, GLFW_##type)
 
-typedef Stack<Key_Event, 256> Key_Events;
+// @NOTE: filled by glfw on the thread calling glfwPollEvents, can be drained from any other (single) thread!
+typedef Spsc_Queue<Key_Event, 1024> Key_Event_Queue;
 
-static Key_Events key_events;
+static Key_Event_Queue  key_events;
+static u32              key_events_dropped;     // pushed while the queue was full, window_destroy reports them
 
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    Key_Event* event = key_events.create();
-
-    event->key          = key;
-    event->type         = action;
+    if (!key_events.push({ key, action, glfwGetTime() })) {
+        key_events_dropped++;
+    }
 }
 
+// pops the oldest pending key event, returns false when there are none left!
+static inline b32  window_poll_key_event (Key_Event* event) { return key_events.pop(event); }
+static inline void window_flush_key_events()                { key_events.clear(); }
+
 typedef     GLFWwindow*     Render_Window;
 
-// @NOTE: vsync - 1 = 60, 2 = 30,
+// ============================================== FRAME PACING ================================================ //
+
+// @NOTE: how a frame waits for the display, window_set_pacing switches any time:
+//  VSYNC        swap interval of window_create, a frame waits in the swap (how it always was)
+//  ADAPTIVE     the same while frames are on time, a late one is shown right away and tears instead of waiting
+//               for the next refresh. Needs *_swap_control_tear, plain VSYNC without it
+//  LOW_LATENCY  vsync, but window_begin_frame sleeps until the frame just fits in before the next refresh and
+//               reads the input after that, so a frame shows input that is a refresh younger. Every
+//               FRAME_PACING_SYNC_FRAMES frames the swap is waited for with glFinish, that is a real flip, the
+//               others flip on the first refresh after their swap returned, counted from the last real one.
+//               It only ever sleeps (learning how late the scheduler wakes it), it never spins
+//  UNCAPPED     no vsync, no waiting
+// The input is read in window_begin_frame at the start of a frame, not after the swap of the frame before!
+// LOW_LATENCY learns how long a frame takes from window_begin_frame to the swap (a slowly falling max) and keeps a
+// margin on top of it that grows with every missed refresh and shrinks back while none are missed.
+
+enum Frame_Pacing {
+    FRAME_PACING_VSYNC,
+    FRAME_PACING_ADAPTIVE,
+    FRAME_PACING_LOW_LATENCY,
+    FRAME_PACING_UNCAPPED,
+    FRAME_PACING_COUNT
+};
+
+static const char* frame_pacing_names[FRAME_PACING_COUNT] = { "vsync", "adaptive", "low latency", "uncapped" };
+
+#define FRAME_PACING_MIN_MARGIN     0.001
+#define FRAME_PACING_MAX_OVERSLEEP  0.002
+#define FRAME_PACING_SYNC_FRAMES    60
+
+struct Frame_Pacer {
+    Frame_Pacing    mode;
+    i32             interval;       // refreshes per frame, the vsync of window_create
+    b32             tear;           // adaptive vsync is supported
+    r64             refresh;        // seconds, of the primary monitor
+    r64             last_swap;      // when the last swap returned, 0 before the first one
+    r64             frame_start;    // when window_begin_frame returned
+    r64             work;           // seconds from window_begin_frame to the swap
+    r64             margin;
+    r64             slept;          // by the last window_begin_frame
+    r64             oversleep;      // how much later than asked a sleep returns, a slowly falling max
+    r64             flip;           // the last flip glFinish waited for, 0 before the first one
+    u32             frames;         // swapped, for FRAME_PACING_SYNC_FRAMES
+    u32             missed;         // refreshes, by LOW_LATENCY frames
+};
+
+static Frame_Pacer frame_pacer;
+
+// one sleep that ends oversleep early, so it wakes up about on time: returning a bit early costs a bit of
+// latency, spinning until the deadline would cost a core
+static void frame_pacer__wait_until(r64 deadline) {
+    Frame_Pacer* fp = &frame_pacer;
+
+    r64 now     = timer_now();
+    r64 sleep   = deadline - now - fp->oversleep;
+    if (sleep <= 0) { return; }
+
+    std::this_thread::sleep_for(std::chrono::duration<r64>(sleep));
+
+    r64 late = MIN(timer_now() - now - sleep, FRAME_PACING_MAX_OVERSLEEP);
+    if (late > fp->oversleep)   { fp->oversleep = late; }
+    else                        { fp->oversleep += (late - fp->oversleep) * 0.05; }
+}
+
+// flipped: the swap was waited for with glFinish, now is the flip
+static void frame_pacer__swapped(r64 swap_start, b32 flipped) {
+    Frame_Pacer* fp = &frame_pacer;
+
+    r64 now     = timer_now();
+    r64 work    = swap_start - fp->frame_start;
+    r64 period  = fp->refresh * MAX(fp->interval, 1);
+
+    if (flipped) {
+        fp->flip = now;
+    } else if (fp->mode == FRAME_PACING_LOW_LATENCY && fp->flip > 0) {
+        now = fp->flip + ceil((now - fp->flip) / fp->refresh) * fp->refresh;
+    }
+
+    if (work > fp->work)    { fp->work = work; }
+    else                    { fp->work += (work - fp->work) * 0.05; }
+
+    if (fp->mode == FRAME_PACING_LOW_LATENCY && fp->last_swap > 0) {
+        if (now - fp->last_swap > period * 1.5) {
+            fp->missed++;
+            fp->margin = MIN(fp->margin + 0.001, period * 0.5);
+        } else {
+            fp->margin = MAX(fp->margin - 0.000005, FRAME_PACING_MIN_MARGIN);
+        }
+    }
+    fp->last_swap = now;
+}
+
+static void window_set_pacing(Render_Window window, Frame_Pacing mode) {
+    Frame_Pacer* fp = &frame_pacer;
+
+    fp->mode        = mode;
+    fp->last_swap   = 0;
+    fp->flip        = 0;
+    fp->frames      = 0;
+    switch (mode) {
+        case FRAME_PACING_VSYNC:        glfwSwapInterval(fp->interval);                         break;
+        case FRAME_PACING_ADAPTIVE:     glfwSwapInterval(fp->tear? -fp->interval : fp->interval); break;
+        case FRAME_PACING_LOW_LATENCY:  glfwSwapInterval(MAX(fp->interval, 1));                 break;
+        default:                        glfwSwapInterval(0);                                    break;
+    }
+}
+
+// waits for the frame's turn (LOW_LATENCY) and reads the input, first thing every frame!
+static void window_begin_frame(Render_Window window) {
+    PROFILE_FUNCTION();
+    Frame_Pacer* fp = &frame_pacer;
+
+    fp->slept = 0;
+    if (fp->mode == FRAME_PACING_LOW_LATENCY && fp->last_swap > 0) {
+        r64 now     = timer_now();
+        r64 start   = fp->last_swap + fp->refresh * MAX(fp->interval, 1) - fp->work - fp->margin;
+        if (start > now) {
+            frame_pacer__wait_until(start);
+            fp->slept = timer_now() - now;
+        }
+    }
+
+    glfwPollEvents();
+    fp->frame_start = timer_now();
+}
+
+// ================================================= WINDOW =================================================== //
+
+// @NOTE: vsync - 1 = 60, 2 = 30, the interval of every pacing mode but UNCAPPED. Starts with FRAME_PACING_VSYNC.
 static Render_Window window_create(i32 width, i32 height, const char* title, u32 vsync) {
     glfwInit();
     glfwWindowHint(GLFW_SAMPLES, 8);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, 1);
 
     GLFWwindow* window = glfwCreateWindow(width, height, title, glfwGetPrimaryMonitor(), NULL);
     
     assert(window);
 
     glfwMakeContextCurrent(window);
+    gl__load_functions();
 
     glfwSetKeyCallback(window, key_callback);
 
-    glfwSwapInterval(vsync);
+    const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    frame_pacer.refresh     = mode && mode->refreshRate > 0 ? 1.0 / mode->refreshRate : 1.0 / 60;
+    frame_pacer.interval    = (i32)vsync;
+    frame_pacer.margin      = FRAME_PACING_MIN_MARGIN;
+    frame_pacer.tear        = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+                              glfwExtensionSupported("GLX_EXT_swap_control_tear");
+    window_set_pacing(window, FRAME_PACING_VSYNC);
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f); 
     glClearDepth(1.0f);
     glDepthFunc(GL_LESS);
-    glShadeModel(GL_SMOOTH);
     glEnable(GL_DEPTH_TEST);
-    glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
     
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_BLEND);
 
-    glAlphaFunc(GL_GREATER, 0.0);
-    glEnable(GL_ALPHA_TEST);
-
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-
-    {
-        //gl_light_global_ambient({ 0.2, 0.2, 0.2, 1.0 });
-        //gl_light_simple(0, 0.9, 0, 0, -2);
-        //glEnable(GL_LIGHTING);
-    }
-
-
-    //glEnable(GL_AUTO_NORMAL);
-    glEnable(GL_NORMALIZE);
+    render_init();
     return window;
 }
 
 static void window_destroy(Render_Window window) {
+#if defined(ATS_TEXTURES)
+    texture_loader_shutdown();
+#endif
+#if defined(ATS_RENDER_TRACE)
+    render_trace_close();
+#endif
+    if (key_events_dropped) {
+        fprintf(stderr, "key events: %u dropped, the queue (%u) was full\n", key_events_dropped, key_events.cap());
+    }
     glfwTerminate();
 }
 
@@ -670,14 +2574,25 @@ static inline void window_close   (Render_Window window)  { glfwSetWindowShouldC
 static inline void window_set_title(Render_Window window, const char* title) { glfwSetWindowTitle(window, title); }
 
 static inline void window_clear(Render_Window window) {
+    render_flush();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    RENDER_TRACE_FRAME_BEGIN();
 }
 
 static inline void window_update(Render_Window window) {
-    key_events.clear();
-
+    PROFILE_FUNCTION();
+    render_flush();
+    RENDER_TRACE_FRAME_END();
+#if defined(ATS_TEXTURES)
+    texture_upload_pending(ATS_TEXTURE_UPLOAD_BUDGET);
+#endif
+    r64 swap_start = timer_now();
     glfwSwapBuffers(window);
-    glfwPollEvents();
+
+    b32 flipped = frame_pacer.mode == FRAME_PACING_LOW_LATENCY && frame_pacer.frames % FRAME_PACING_SYNC_FRAMES == 0;
+    if (flipped) { glFinish(); }
+    frame_pacer.frames++;
+    frame_pacer__swapped(swap_start, flipped);
 }
 
 static v2 window_get_mouse_position(Render_Window window) {
@@ -698,6 +2613,7 @@ static v2 window_get_size(Render_Window window) {
     return { (r32)w, (r32)h };
 }
 
+// the camera matrix is built here on the cpu, every draw after it gets it as a uniform
 static void window_update_view(
         Render_Window window,
         r32 pos_x,  r32 pos_y,       r32 pos_z,
@@ -708,254 +2624,46 @@ static void window_update_view(
     i32 h = 0;
 
     glfwGetWindowSize(window, &w, &h);
-    
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
 
-    glViewport(0, 0, w, h);
-    gluPerspective(fov, (r32)w / (r32)h, near_plane, far_plane);
-    gluLookAt(pos_x,    pos_y,  pos_z,
-              look_x,   look_y, look_z,
-              up_x,     up_y,   up_z);
+    render_flush();
 
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    glViewport(0, 0, w, h);
+    render_batches.view_proj =
+        m4_perspective(fov, (r32)w / (r32)h, near_plane, far_plane) *
+        m4_look_at({ pos_x, pos_y, pos_z }, { look_x, look_y, look_z }, { up_x, up_y, up_z });
+    render_batches.pixel_scale = h / 2.0f * fov_scale(fov);
 }
 
+// world position of what is drawn at pos (window coordinates), with the view of the last window_update_view
 static v3 get_3d_point(v2 pos) {
     i32 viewport[4];
-    r64 model_view[16];
-    r64 projection[16];
+    r32 depth = 0;
 
-    r32 win_x, win_y, win_z;
-    r64 pos_x, pos_y, pos_z;
+    render_flush();
 
-    glGetDoublev(GL_MODELVIEW_MATRIX, model_view);
-    glGetDoublev(GL_PROJECTION_MATRIX, projection);
     glGetIntegerv(GL_VIEWPORT, viewport);
 
-    win_x = pos.x;
-    win_y = viewport[3] - pos.y;
-    glReadPixels(pos.x, win_y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &win_z);
-
-    gluUnProject(win_x, win_y, win_z, model_view, projection, viewport, &pos_x, &pos_y, &pos_z);
-
-    return { r32(pos_x), r32(pos_y), r32(pos_z) };
-}
-
-#define is_key_pressed(window, key)             (glfwGetKey(window, GLFW_KEY_##key) == GLFW_PRESS)
-
-#define render_begin(type)                      (glBegin(GL_##type))
-#define render_end()                            (glEnd())
-
-#define render_color(r, g, b, a)                (glColor4ub((r), (g), (b), (a)))
-#define render_vertex(x, y, z)                  (glVertex3f((x), (y), (z)))
-
-#define render_col_vertex(x, y, z, r, g, b, a)  (glColor4ub((r), (g), (b), (a)),    glVertex3f((x), (y), (z)))
-#define render_tex_vertex(x, y, z, tx, ty)      (glTexCoord2f((tx), (ty)),          glVertex3f((x), (y), (z)))
-
-u32 displaylist_cube;
-static void render_init(){
-    displaylist_cube = glGenLists(1);
-
-    // compile the display list, store a triangle in it
-    glNewList(displaylist_cube, GL_COMPILE);
-        render_begin(QUADS);
-        // UP
-        render_vertex(-1, -1, -1);
-        render_vertex(1, -1, -1);
-        render_vertex(1, 1, -1);
-        render_vertex(-1, 1, -1);
-        // Right
-        render_vertex(-1, 1, -1);
-        render_vertex(-1, 1, 1);
-        render_vertex(1, 1, 1);
-        render_vertex(1, 1, -1);
-        // LEFT
-        render_vertex(-1, -1, -1);
-        render_vertex(-1, -1, 1);
-        render_vertex(1, -1, 1);
-        render_vertex(1, -1, -1);
-        // FRONT
-        render_vertex(-1, -1, -1);
-        render_vertex(-1, -1, 1);
-        render_vertex(-1, 1, 1);
-        render_vertex(-1, 1, -1);
-
-        render_end();
-    glEndList();
-}
-
-static void render_rectangle(r32 px, r32 py, r32 qx, r32 qy, r32 z, u8 r, u8 g, u8 b, u8 a) {
-    render_color(r, g, b, a);
-
-    render_begin(QUADS);
-    //
-    render_vertex(px, py, z);
-    render_vertex(qx, py, z);
-    render_vertex(qx, qy, z);
-    render_vertex(px, qy, z);
-    //
-    render_end();
-}
-
-static void render_cube(r32 px, r32 py, r32 qx, r32 qy, r32 pz, r32 qz, u8 r, u8 g, u8 b, u8 a) {
-
-    render_color(r, g, b, a);
-
-    glLoadIdentity();
-    glTranslatef(px+(qx-px)/2, py+(qy-py)/2, pz+(qz-pz)/2);
-    glScalef((qx-px)/2,(qy-py)/2,(qz-pz)/2);
-
-    glCallList(displaylist_cube);
-
-    /*render_begin(QUADS);
-    // UP
-    render_vertex(-1, -1, -1);
-    render_vertex(1, -1, -1);
-    render_vertex(1, 1, -1);
-    render_vertex(-1, 1, -1);
-
-    //render_color(r, g, b, a*0.9);
-    
-    // Right
-    render_vertex(-1, 1, -1);
-    render_vertex(-1, 1, 1);
-    render_vertex(1, 1, 1);
-    render_vertex(1, 1, -1);
-    // LEFT
-    render_vertex(-1, -1, -1);
-    render_vertex(-1, -1, 1);
-    render_vertex(1, -1, 1);
-    render_vertex(1, -1, -1);
-    // FRONT
-    render_vertex(-1, -1, -1);
-    render_vertex(-1, -1, 1);
-    render_vertex(-1, 1, 1);
-    render_vertex(-1, 1, -1);
-
-    render_end();*/
-}
-
-static void render_triangle(
-        r32 p0_x, r32 p0_y, r32 p0_z,
-        r32 p1_x, r32 p1_y, r32 p1_z,
-        r32 p2_x, r32 p2_y, r32 p2_z,
-        u8 r, u8 g, u8 b, u8 a) {
-    render_color(r, g, b, a);
-
-    render_begin(TRIANGLES);
-    //
-    render_vertex(p0_x, p0_y, p0_z);
-    render_vertex(p1_x, p1_y, p1_z);
-    render_vertex(p2_x, p2_y, p2_z);
-    //
-    render_end();
-}
-
-// =============================================== VERTEX ARRAY ========================================= //
-
-union Vertex {
-    struct {
-        v3      pos;
-        Color   color;
-    };
+    r32 win_y = viewport[3] - pos.y;
+    glReadPixels((i32)pos.x, (i32)win_y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth);
 
-    struct {
-        r32         x;
-        r32         y;
-        r32         z;
-        //
-        u8          r;
-        u8          g;
-        u8          b;
-        u8          a;
+    v4 ndc = {
+        2.0f * (pos.x - viewport[0]) / viewport[2] - 1.0f,
+        2.0f * (win_y - viewport[1]) / viewport[3] - 1.0f,
+        2.0f * depth - 1.0f,
+        1.0f,
     };
-};
-
-typedef Array<Vertex> Vertex_Array;
-
-static void vertex_array_render(const Vertex_Array* verts) {
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(3, GL_FLOAT, sizeof (Vertex), &verts->get(0)->x);
-
-    glEnableClientState(GL_COLOR_ARRAY);
-    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof (Vertex), &verts->get(0)->r);
+    v4 p = m4_inverse(render_batches.view_proj) * ndc;
 
-    glDrawArrays(GL_TRIANGLES, 0, verts->len());
-
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_COLOR_ARRAY);
+    return { p.x / p.w, p.y / p.w, p.z / p.w };
 }
 
-//#define vertex_array_render(b)   (vertex_array__render_func((b)))
-
-inline static void vertex_array_add_rectangle(Vertex_Array* verts,
-                                              r32 px,   r32 py,
-                                              r32 qx,   r32 qy,
-                                              r32 z, 
-                                              u8  r, u8 g, u8 b, u8 a) {
-    verts->add({ px, py, z, r, g, b, a });
-    verts->add({ px, qy, z, r, g, b, a });
-    verts->add({ qx, py, z, r, g, b, a });
-    verts->add({ px, qy, z, r, g, b, a });
-    verts->add({ qx, qy, z, r, g, b, a });
-    verts->add({ qx, py, z, r, g, b, a });
-}
+#define is_key_pressed(window, key)             (glfwGetKey(window, GLFW_KEY_##key) == GLFW_PRESS)
 
-inline static void add_vertex(Vertex_Array* verts, v2 pos, r32 z, Color color) {
-    verts->add({ pos.x, pos.y, z, color.r, color.g, color.b, color.a });
-}
+#elif defined(ATS_SOFTWARE_RENDER)
 
-static void vertex_array_add_triangle(Vertex_Array* verts, v3 p, v3 q, v3 r, Color color) {
-    verts->add({ p, color });
-    verts->add({ q, color });
-    verts->add({ r, color });
-}
+#include "soft_render.h"
 
-static void vertex_array_add_box(Vertex_Array* verts, v3 min, v3 max, Color color) {
-    verts->add({ v3 { min.x, min.y, min.z }, color });
-    verts->add({ v3 { max.x, min.y, min.z }, color });
-    verts->add({ v3 { min.x, max.y, min.z }, color });
-    verts->add({ v3 { max.x, max.y, min.z }, color });
-    verts->add({ v3 { min.x, max.y, min.z }, color });
-    verts->add({ v3 { max.x, min.y, min.z }, color });
-    //
-    verts->add({ v3 { min.x, min.y, max.z }, color });
-    verts->add({ v3 { max.x, min.y, max.z }, color });
-    verts->add({ v3 { min.x, max.y, max.z }, color });
-    verts->add({ v3 { max.x, max.y, max.z }, color });
-    verts->add({ v3 { min.x, max.y, max.z }, color });
-    verts->add({ v3 { max.x, min.y, max.z }, color });
-    //
-    verts->add({ v3 { min.x, min.y, min.z }, color });
-    verts->add({ v3 { min.x, max.y, min.z }, color });
-    verts->add({ v3 { min.x, min.y, max.z }, color });
-    verts->add({ v3 { min.x, max.y, max.z }, color });
-    verts->add({ v3 { min.x, min.y, max.z }, color });
-    verts->add({ v3 { min.x, max.y, min.z }, color });
-    //
-    verts->add({ v3 { max.x, min.y, min.z }, color });
-    verts->add({ v3 { max.x, max.y, min.z }, color });
-    verts->add({ v3 { max.x, min.y, max.z }, color });
-    verts->add({ v3 { max.x, max.y, max.z }, color });
-    verts->add({ v3 { max.x, min.y, max.z }, color });
-    verts->add({ v3 { max.x, max.y, min.z }, color });
-    //
-    verts->add({ v3 { min.x, min.y, min.z }, color });
-    verts->add({ v3 { max.x, min.y, min.z }, color });
-    verts->add({ v3 { min.x, min.y, max.z }, color });
-    verts->add({ v3 { max.x, min.y, max.z }, color });
-    verts->add({ v3 { min.x, min.y, max.z }, color });
-    verts->add({ v3 { max.x, min.y, min.z }, color });
-    //
-    verts->add({ v3 { min.x, max.y, min.z }, color });
-    verts->add({ v3 { max.x, max.y, min.z }, color });
-    verts->add({ v3 { min.x, max.y, max.z }, color });
-    verts->add({ v3 { max.x, max.y, max.z }, color });
-    verts->add({ v3 { min.x, max.y, max.z }, color });
-    verts->add({ v3 { max.x, max.y, min.z }, color });
-}
+#endif // ATS_HEADLESS
 
 // ================================================== TILEMAP ========================================= //
 
@@ -963,6 +2671,7 @@ static void vertex_array_add_box(Vertex_Array* verts, v3 min, v3 max, Color colo
 
 #define STB_PERLIN_IMPLEMENTATION
 #include "stb_perlin.h" 
+#include "perlin.h"
 
 enum Tile_Attribute {
     Tile_None       = 0,
@@ -973,22 +2682,63 @@ enum Tile_Attribute {
     Tile_Room       = (1 << 4),
 };
 
+// @NOTE: the map keeps a summary of where its tiles are, so a query can skip what can't have what it looks for.
+// Every column has a bit per row that is set for a tile that isn't 0 (so a map is at most 64 tiles high) and a
+// count of every tile value in it (values from TILEMAP_KINDS - 1 up share the last count), every TILEMAP_BLOCK x
+// TILEMAP_BLOCK block has the number of tiles in it that aren't 0. All of it is kept up to date in O(1) by set and
+// tilemap_scroll_left, call tilemap_rebuild_summary after writing tiles yourself!
+// Every change also gives its column a new stamp, so whatever is built from a column (a mesh) knows when it is
+// out of date: the stamps only count up, a column with the stamp it had before hasn't changed.
+
+#define TILEMAP_BLOCK   8
+#define TILEMAP_KINDS   8
+
 struct Tilemap {
     // data:
     i32         width;
     i32         height;
     Array<u32>  tiles;
 
+    // summary:
+    i32         blocks_x;
+    i32         blocks_y;
+    Array<u64>  column_rows;    // [x], bit y
+    Array<u8>   column_counts;  // [x * TILEMAP_KINDS + kind]
+    Array<u32>  column_kinds;   // [x], bit kind while its count isn't 0
+    Array<u8>   block_fill;     // [y / TILEMAP_BLOCK * blocks_x + x / TILEMAP_BLOCK]
+    Array<u32>  column_stamps;  // [x]
+    u32         stamp;          // the last one handed out
+
     // methods:
     inline u32  get     (i32 x, i32 y)           const;
     inline void set     (i32 x, i32 y, u32 tile);
 };
 
+inline static u32 tilemap__kind_index(u32 tile) { return MIN(tile, (u32)TILEMAP_KINDS - 1); }
+inline static u32 tilemap_kind(u32 tile)        { return 1u << tilemap__kind_index(tile); }
+
 inline void Tilemap::set(i32 x, i32 y, u32 tile) {
     if (x < 0 || x >= width)    { return; }
     if (y < 0 || y >= height)   { return; }
 
+    u32 old = tiles[y * width + x];
+    if (old == tile) { return; }
     tiles[y * width + x] = tile;
+    column_stamps[x]     = ++stamp;
+
+    u32 old_kind = tilemap__kind_index(old);
+    u32 new_kind = tilemap__kind_index(tile);
+    if (old_kind != new_kind) {
+        u8* counts = &column_counts[x * TILEMAP_KINDS];
+        if (--counts[old_kind] == 0) { column_kinds[x] &= ~(1u << old_kind); }
+        if (counts[new_kind]++ == 0) { column_kinds[x] |=  (1u << new_kind); }
+    }
+
+    if ((old == 0) != (tile == 0)) {
+        u8* fill = &block_fill[y / TILEMAP_BLOCK * blocks_x + x / TILEMAP_BLOCK];
+        if (tile)   { column_rows[x] |=  (1ull << y); (*fill)++; }
+        else        { column_rows[x] &= ~(1ull << y); (*fill)--; }
+    }
 }
 
 inline u32  Tilemap::get(i32 x, i32 y) const {
@@ -998,22 +2748,165 @@ inline u32  Tilemap::get(i32 x, i32 y) const {
     return tiles[y * width + x];
 }
 
+static void tilemap__rebuild_blocks(Tilemap* tiles) {
+    for_ij (0, tiles->blocks_x, 0, tiles->blocks_y) {
+        i32 x1   = MIN((i + 1) * TILEMAP_BLOCK, tiles->width);
+        i32 fill = 0;
+        for (i32 x = i * TILEMAP_BLOCK; x < x1; x++) {
+            fill += __builtin_popcountll((tiles->column_rows[x] >> (j * TILEMAP_BLOCK)) & ((1ull << TILEMAP_BLOCK) - 1));
+        }
+        tiles->block_fill[j * tiles->blocks_x + i] = (u8)fill;
+    }
+}
+
+static void tilemap_rebuild_summary(Tilemap* tiles) {
+    assert(tiles->height <= 64);
+
+    tiles->blocks_x = (tiles->width  + TILEMAP_BLOCK - 1) / TILEMAP_BLOCK;
+    tiles->blocks_y = (tiles->height + TILEMAP_BLOCK - 1) / TILEMAP_BLOCK;
+    tiles->column_rows.resize(tiles->width);
+    tiles->column_counts.resize(tiles->width * TILEMAP_KINDS);
+    tiles->column_kinds.resize(tiles->width);
+    tiles->block_fill.resize(tiles->blocks_x * tiles->blocks_y);
+    tiles->column_stamps.resize(tiles->width);
+
+    memset(tiles->column_counts.ptr(), 0, tiles->width * TILEMAP_KINDS);
+    for_i (0, tiles->width) {
+        u64 rows  = 0;
+        u32 kinds = 0;
+        for_j (0, tiles->height) {
+            u32 tile = tiles->tiles[j * tiles->width + i];
+            if (tile) { rows |= 1ull << j; }
+            kinds |= tilemap_kind(tile);
+            tiles->column_counts[i * TILEMAP_KINDS + tilemap__kind_index(tile)]++;
+        }
+        tiles->column_rows[i]   = rows;
+        tiles->column_kinds[i]  = kinds;
+        tiles->column_stamps[i] = ++tiles->stamp;
+    }
+    tilemap__rebuild_blocks(tiles);
+}
+
+// all 0
 inline void tilemap_init(Tilemap* tiles, int w, int h) {
     tiles->width    = w;
     tiles->height   = h;
 
     tiles->tiles.resize(w * h);
+    memset(tiles->tiles.ptr(), 0, w * h * sizeof (u32));
+    tilemap_rebuild_summary(tiles);
 }
 
 inline void tilemap_destroy(Tilemap* tiles) {
     tiles->tiles.destroy();
+    tiles->column_rows.destroy();
+    tiles->column_counts.destroy();
+    tiles->column_kinds.destroy();
+    tiles->block_fill.destroy();
+    tiles->column_stamps.destroy();
 
     tiles->width   = 0;
     tiles->height  = 0;
 }
 
+inline static u64 tilemap_column_rows (const Tilemap* tiles, i32 x)            { return tiles->column_rows[x]; }
+inline static u32 tilemap_column_kinds(const Tilemap* tiles, i32 x)            { return tiles->column_kinds[x]; }
+inline static i32 tilemap_block_fill  (const Tilemap* tiles, i32 bx, i32 by)   { return tiles->block_fill[by * tiles->blocks_x + bx]; }
+inline static u32 tilemap_column_stamp(const Tilemap* tiles, i32 x)            { return tiles->column_stamps[x]; }
+
+// inclusive, tiles outside of the map count as 0
+static bool tilemap_area_empty(const Tilemap* tiles, i32 x0, i32 y0, i32 x1, i32 y1) {
+    x0 = MAX(x0, 0);
+    y0 = MAX(y0, 0);
+    x1 = MIN(x1, tiles->width - 1);
+    y1 = MIN(y1, tiles->height - 1);
+    if (x0 > x1 || y0 > y1) { return true; }
+
+    u64 rows = (~0ull >> (63 - (y1 - y0))) << y0;
+    for (i32 x = x0; x <= x1; x++) {
+        if (tiles->column_rows[x] & rows) { return false; }
+    }
+    return true;
+}
+
+// every column one to the left, the first one drops out, the last one is all 0 after it
+static void tilemap_scroll_left(Tilemap* tiles) {
+    i32 w = tiles->width;
+    for_j (0, tiles->height) {
+        u32* row = tiles->tiles.ptr() + j * w;
+        memmove(row, row + 1, (w - 1) * sizeof (u32));
+        row[w - 1] = 0;
+    }
+
+    memmove(tiles->column_rows.ptr(),   tiles->column_rows.ptr() + 1,               (w - 1) * sizeof (u64));
+    memmove(tiles->column_counts.ptr(), tiles->column_counts.ptr() + TILEMAP_KINDS, (w - 1) * TILEMAP_KINDS);
+    memmove(tiles->column_kinds.ptr(),  tiles->column_kinds.ptr() + 1,              (w - 1) * sizeof (u32));
+    memmove(tiles->column_stamps.ptr(), tiles->column_stamps.ptr() + 1,             (w - 1) * sizeof (u32));
+
+    memset(&tiles->column_counts[(w - 1) * TILEMAP_KINDS], 0, TILEMAP_KINDS);
+    tiles->column_counts[(w - 1) * TILEMAP_KINDS] = (u8)tiles->height;
+    tiles->column_rows[w - 1]  = 0;
+    tiles->column_kinds[w - 1]  = tilemap_kind(0);
+    tiles->column_stamps[w - 1] = ++tiles->stamp;
+
+    tilemap__rebuild_blocks(tiles);
+}
+
+struct Tile_Rect {
+    i32     x0, y0;
+    i32     x1, y1;     // inclusive
+};
+
+// @NOTE: greedy meshing of n (at most 64) columns of bits, bit y of columns[i] being the tile in row y of column
+// x + i: a rect starts at the first bit left in a column, grows down that column as far as the bits go, then to
+// the right for as long as the next column has all of them too. Every bit ends up in exactly one rect, appended
+// to out. columns is cleared on the way.
+static void greedy_rects(u64* columns, i32 n, i32 x, Array<Tile_Rect>* out) {
+    assert(n <= 64);
+
+    for_i (0, n) {
+        while (columns[i]) {
+            i32 top     = __builtin_ctzll(columns[i]);
+            u64 below   = ~(columns[i] >> top);
+            i32 len     = below ? __builtin_ctzll(below) : 64 - top;
+            u64 run     = (len == 64 ? ~0ull : (1ull << len) - 1) << top;
+
+            i32 right = i;
+            columns[i] &= ~run;
+            while (right + 1 < n && (columns[right + 1] & run) == run) {
+                columns[++right] &= ~run;
+            }
+            out->add({ x + (i32)i, top, x + right, top + len - 1 });
+        }
+    }
+}
+
+// greedy_rects of the tiles with one value in columns x0..x1 and rows y0..y1 (at most 64 columns)
+static void tilemap_greedy_rects(const Tilemap* tiles, u32 tile, i32 x0, i32 y0, i32 x1, i32 y1, Array<Tile_Rect>* out) {
+    x0 = MAX(x0, 0);
+    y0 = MAX(y0, 0);
+    x1 = MIN(x1, tiles->width - 1);
+    y1 = MIN(y1, tiles->height - 1);
+    if (x0 > x1 || y0 > y1) { return; }
+
+    i32 n = x1 - x0 + 1;
+    assert(n <= 64);
+
+    u64 columns[64];
+    for_i (0, n) {
+        columns[i] = 0;
+        if (!(tiles->column_kinds[x0 + i] & tilemap_kind(tile))) { continue; }
+
+        for (i32 y = y0; y <= y1; y++) {
+            if (tiles->tiles[y * tiles->width + x0 + i] == tile) { columns[i] |= 1ull << y; }
+        }
+    }
+
+    greedy_rects(columns, n, x0, out);
+}
+
 inline static void add_bit(Tilemap* tiles, i32 x, i32 y, u32 bit) {
-    tiles->tiles[y * tiles->width + x] |= bit;
+    tiles->set(x, y, tiles->get(x, y) | bit);
 }
 
 static void tilemap_add_tile(Tilemap* tiles, int x, int y, u32 type, i32 tile_size) {
@@ -1156,6 +3049,11 @@ static u32 tilemap_get_collision(const Tilemap* tiles, v2 pos, r32 r, float offs
     if (x >= tiles->width)  { col |= Collision_Right; }
     if (y >= tiles->height) { col |= Collision_Bot; }
 
+    // the probes below all land in [pos - r, pos + r], nothing to hit when that is all empty
+    if (tilemap_area_empty(tiles, (i32)(pos.x - r), (i32)(pos.y - r), (i32)(pos.x + r), (i32)(pos.y + r))) {
+        return col;
+    }
+
     if      (tiles->get(pos.x + r-0.2f, pos.y + r) || tiles->get(pos.x - r+0.2f, pos.y + r)) { col |= Collision_Top; }
     else if (tiles->get(pos.x + r-0.2f, pos.y - r) || tiles->get(pos.x - r+0.2f, pos.y - r)) { col |= Collision_Bot; }
     if      (tiles->get(pos.x - r, pos.y + r-0.2f) || tiles->get(pos.x - r, pos.y - r+0.2f)) { col |= Collision_Left; }
@@ -147,15 +147,17 @@ static const u64 bitascii[128] = {
 
 static Vertex_Array bitmap_verts;
 
+#ifdef ATS_RENDER
 inline static void bitmaps_render() { vertex_array_render(&bitmap_verts); bitmap_verts.clear(); }
+#endif
 
 // @TODO: make less shit!!
-inline static void render_ascii(char c, r32 px, r32 py, r32 pz, r32 x_scale, r32 y_scale, Color col) {
+inline static void render_ascii_to(Vertex_Array* verts, char c, r32 px, r32 py, r32 pz, r32 x_scale, r32 y_scale, Color col) {
     if (c >= ' ' && c <= '~') {
         u64 n = bitascii[c - ' '];
         for_ij(0, 8, 0, 8) {
             if (bitmap_getbit(n, i, j) > 0) {
-                vertex_array_add_rectangle(&bitmap_verts,
+                vertex_array_add_rectangle(verts,
                                            px + i * x_scale,
                                            py + j * y_scale,
                                            px + (i + 1) * x_scale,
@@ -167,6 +169,16 @@ inline static void render_ascii(char c, r32 px, r32 py, r32 pz, r32 x_scale, r32
     }
 }
 
+inline static void render_ascii(char c, r32 px, r32 py, r32 pz, r32 x_scale, r32 y_scale, Color col) {
+    render_ascii_to(&bitmap_verts, c, px, py, pz, x_scale, y_scale, col);
+}
+
+inline static void render_string_to(Vertex_Array* verts, const char* str, r32 x, r32 y, r32 z, r32 scale_x, r32 scale_y, Color c) {
+    for (i32 i = 0; str[i] != '\0'; i++) {
+        render_ascii_to(verts, str[i], x + i * 8 * scale_x, y, z, scale_x, scale_y, c);
+    }
+}
+
 inline static void render_string(const char* str, r32 x, r32 y, r32 z, r32 scale_x, r32 scale_y, Color c) {
     for (i32 i = 0; str[i] != '\0'; i++) {
         render_ascii(str[i], x + i * 8 * scale_x, y, z, scale_x, scale_y, c);
@@ -201,6 +213,83 @@ inline static void render_number_box(i32 n, r32 x, r32 y, r32 z, r32 w, r32 h, C
     render_string_box(buffer, x, y, z, w, h, c);
 }
 
+// ================================================= TEXT WIDGETS ================================================= //
+
+// writes n in decimal to buffer (at least 12 chars), returns the length!
+inline static i32 format_i32(char* buffer, i32 n) {
+    char    tmp[12];
+    i32     len = 0;
+    u32     u   = n < 0? 0u - (u32)n : (u32)n;
+
+    do { tmp[len++] = '0' + u % 10; u /= 10; } while (u);
+
+    i32 i = 0;
+    if (n < 0) { buffer[i++] = '-'; }
+    while (len) { buffer[i++] = tmp[--len]; }
+    buffer[i] = '\0';
+
+    return i;
+}
+
+// retained piece of text: the vertices are only rebuilt when the text, position or color changes,
+// every other frame they are just copied into bitmap_verts! Text past sizeof (text) - 1 characters
+// is cut off (and isn't compared either).
+struct Text_Widget {
+    Vertex_Array    verts;
+    char            text[64];
+    i32             len;
+    r32             x, y, z;
+    r32             scale_x, scale_y;
+    Color           color;
+    b32             valid;
+};
+
+inline static b32 text_widget_changed(const Text_Widget* w, r32 x, r32 y, r32 z, r32 scale_x, r32 scale_y, Color c) {
+    return !w->valid ||
+           w->x != x || w->y != y || w->z != z ||
+           w->scale_x != scale_x || w->scale_y != scale_y ||
+           w->color.r != c.r || w->color.g != c.g || w->color.b != c.b || w->color.a != c.a;
+}
+
+inline static void text_widget_rebuild(Text_Widget* w, r32 x, r32 y, r32 z, r32 scale_x, r32 scale_y, Color c) {
+    w->x        = x;
+    w->y        = y;
+    w->z        = z;
+    w->scale_x  = scale_x;
+    w->scale_y  = scale_y;
+    w->color    = c;
+    w->valid    = true;
+
+    w->verts.clear();
+    render_string_to(&w->verts, w->text, x, y, z, scale_x, scale_y, c);
+}
+
+inline static void text_widget_emit(const Text_Widget* w) {
+    i64 n = w->verts.len();
+    bitmap_verts.grow(n);
+    memcpy(bitmap_verts.ptr() + bitmap_verts.len(), w->verts.ptr(), n * sizeof (Vertex));
+    bitmap_verts._len += n;
+}
+
+// draws str through the cache, returns the x advance so widgets can be chained!
+static r32 render_text_widget(Text_Widget* w, const char* str, r32 x, r32 y, r32 z, r32 scale_x, r32 scale_y, Color c) {
+    // only as far as text holds, a longer str is the same as its cut off copy
+    if (text_widget_changed(w, x, y, z, scale_x, scale_y, c) || strncmp(w->text, str, sizeof (w->text) - 1)) {
+        strncpy(w->text, str, sizeof (w->text) - 1);
+        w->text[sizeof (w->text) - 1] = '\0';
+        w->len = strlen(w->text);
+        text_widget_rebuild(w, x, y, z, scale_x, scale_y, c);
+    }
+    text_widget_emit(w);
+    return w->len * 8 * scale_x;
+}
+
+static r32 render_i32_widget(Text_Widget* w, i32 n, r32 x, r32 y, r32 z, r32 scale_x, r32 scale_y, Color c) {
+    char buffer[12];
+    format_i32(buffer, n);
+    return render_text_widget(w, buffer, x, y, z, scale_x, scale_y, c);
+}
+
 #endif
 
 
@@ -0,0 +1,313 @@
+#ifndef __PERLIN_H__
+#define __PERLIN_H__
+
+// batch versions of stb_perlin_noise3 and friends!
+//
+// out[i] is bit for bit what the scalar stb function returns for (x[i], y[i], z[i]),
+// as long as the compiler doesn't contract mul+add into fma (-std=c++17 doesn't).
+// AVX2 does 8 samples at a time, SSE2 does 4, the tail (and everything on other
+// targets) goes through the scalar path.
+//
+// @NOTE: included by ats_tool.h with ATS_TILEMAP, right after the stb_perlin implementation.
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// the stb permutation widened to 32 bit, and the basis index for every hash so
+// the gradient doesn't need the second lookup through stb's indices table!
+struct Perlin_Tables {
+    i32     randtab[512];
+    i32     gradtab[512];
+};
+
+static const Perlin_Tables& perlin__tables() {
+    static const Perlin_Tables tables = [] {
+        // copy of the indices in stb__perlin_grad
+        static const u8 indices[64] = {
+            0,1,2,3,4,5,6,7,8,9,10,11,
+            0,9,1,11,
+            0,1,2,3,4,5,6,7,8,9,10,11,
+            0,1,2,3,4,5,6,7,8,9,10,11,
+            0,1,2,3,4,5,6,7,8,9,10,11,
+            0,1,2,3,4,5,6,7,8,9,10,11,
+        };
+
+        Perlin_Tables t = {};
+        for_i(0, 512) {
+            t.randtab[i] = stb__perlin_randtab[i];
+            t.gradtab[i] = indices[stb__perlin_randtab[i] & 63];
+        }
+        return t;
+    }();
+
+    return tables;
+}
+
+#define perlin__wrap_mask(wrap) ((i32)(((wrap) - 1) & 255))
+
+// basis index of the 8 cube corners for lane i, written to k[corner * stride + i].
+// the lookups stay scalar: hardware gathers are slower than this on a lot of cpus!
+inline static void perlin__hash(const Perlin_Tables& t, i32 fx, i32 fy, i32 fz,
+                                i32 x_mask, i32 y_mask, i32 z_mask, i32* k, i32 stride) {
+    const i32* tab = t.randtab;
+    const i32* grad = t.gradtab;
+
+    i32 x0 = fx & x_mask, x1 = (fx + 1) & x_mask;
+    i32 y0 = fy & y_mask, y1 = (fy + 1) & y_mask;
+    i32 z0 = fz & z_mask, z1 = (fz + 1) & z_mask;
+
+    i32 r0  = tab[x0],      r1  = tab[x1];
+    i32 r00 = tab[r0 + y0], r01 = tab[r0 + y1];
+    i32 r10 = tab[r1 + y0], r11 = tab[r1 + y1];
+
+    k[0 * stride] = grad[r00 + z0]; k[1 * stride] = grad[r00 + z1];
+    k[2 * stride] = grad[r01 + z0]; k[3 * stride] = grad[r01 + z1];
+    k[4 * stride] = grad[r10 + z0]; k[5 * stride] = grad[r10 + z1];
+    k[6 * stride] = grad[r11 + z0]; k[7 * stride] = grad[r11 + z1];
+}
+
+// stb's basis is (s1, s2, 0) for 0..3, (s1, 0, s2) for 4..7 and (0, s1, s2) for 8..11,
+// where s1 is -1 when bit 0 is set and s2 is -1 when bit 1 is set. The gradient is
+// then computed as g0*x + g1*y + g2*z, exactly like stb__perlin_grad does.
+
+#if defined(__AVX2__)
+
+#define PERLIN_WIDTH 8
+
+inline static __m256 perlin__ease8(__m256 a) {
+    __m256 t = _mm256_sub_ps(_mm256_mul_ps(a, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f));
+    t = _mm256_add_ps(_mm256_mul_ps(t, a), _mm256_set1_ps(10.0f));
+    t = _mm256_mul_ps(t, a);
+    t = _mm256_mul_ps(t, a);
+    return _mm256_mul_ps(t, a);
+}
+
+inline static __m256 perlin__lerp8(__m256 a, __m256 b, __m256 t) {
+    return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+inline static __m256i perlin__floor8(__m256 a) {
+    __m256i ai = _mm256_cvttps_epi32(a);
+    __m256i lt = _mm256_castps_si256(_mm256_cmp_ps(a, _mm256_cvtepi32_ps(ai), _CMP_LT_OQ));
+    return _mm256_add_epi32(ai, lt);      // lt is -1 where a < ai
+}
+
+inline static __m256 perlin__grad8(const i32* corner, __m256 x, __m256 y, __m256 z) {
+    __m256i k   = _mm256_load_si256((const __m256i*)corner);
+    __m256  one = _mm256_set1_ps(1.0f);
+
+    __m256  s1  = _mm256_or_ps(one, _mm256_castsi256_ps(_mm256_slli_epi32(k, 31)));
+    __m256  s2  = _mm256_or_ps(one, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(k, 1), 31)));
+    __m256  lt4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), k));
+    __m256  lt8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), k));
+
+    __m256  g0  = _mm256_and_ps(lt8, s1);
+    __m256  g1  = _mm256_blendv_ps(_mm256_andnot_ps(lt8, s1), s2, lt4);
+    __m256  g2  = _mm256_andnot_ps(lt4, s2);
+
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(g0, x), _mm256_mul_ps(g1, y)), _mm256_mul_ps(g2, z));
+}
+
+inline static void perlin__noise_wide(const r32* px_in, const r32* py_in, const r32* pz_in, r32* out, i32 x_mask, i32 y_mask, i32 z_mask) {
+    const Perlin_Tables& t = perlin__tables();
+
+    __m256 x = _mm256_loadu_ps(px_in);
+    __m256 y = _mm256_loadu_ps(py_in);
+    __m256 z = _mm256_loadu_ps(pz_in);
+
+    __m256i px = perlin__floor8(x);
+    __m256i py = perlin__floor8(y);
+    __m256i pz = perlin__floor8(z);
+
+    alignas(32) i32 fx[8], fy[8], fz[8];
+    _mm256_store_si256((__m256i*)fx, px);
+    _mm256_store_si256((__m256i*)fy, py);
+    _mm256_store_si256((__m256i*)fz, pz);
+
+    alignas(32) i32 k[8][8];
+    for_i(0, 8) { perlin__hash(t, fx[i], fy[i], fz[i], x_mask, y_mask, z_mask, &k[0][i], 8); }
+
+    x = _mm256_sub_ps(x, _mm256_cvtepi32_ps(px)); __m256 u = perlin__ease8(x);
+    y = _mm256_sub_ps(y, _mm256_cvtepi32_ps(py)); __m256 v = perlin__ease8(y);
+    z = _mm256_sub_ps(z, _mm256_cvtepi32_ps(pz)); __m256 w = perlin__ease8(z);
+
+    __m256 c1 = _mm256_set1_ps(1.0f);
+    __m256 xs = _mm256_sub_ps(x, c1);
+    __m256 ys = _mm256_sub_ps(y, c1);
+    __m256 zs = _mm256_sub_ps(z, c1);
+
+    __m256 n00 = perlin__lerp8(perlin__grad8(k[0], x,  y,  z), perlin__grad8(k[1], x,  y,  zs), w);
+    __m256 n01 = perlin__lerp8(perlin__grad8(k[2], x,  ys, z), perlin__grad8(k[3], x,  ys, zs), w);
+    __m256 n10 = perlin__lerp8(perlin__grad8(k[4], xs, y,  z), perlin__grad8(k[5], xs, y,  zs), w);
+    __m256 n11 = perlin__lerp8(perlin__grad8(k[6], xs, ys, z), perlin__grad8(k[7], xs, ys, zs), w);
+
+    __m256 n0  = perlin__lerp8(n00, n01, v);
+    __m256 n1  = perlin__lerp8(n10, n11, v);
+
+    _mm256_storeu_ps(out, perlin__lerp8(n0, n1, u));
+}
+
+#elif defined(__SSE2__)
+
+#define PERLIN_WIDTH 4
+
+inline static __m128 perlin__ease4(__m128 a) {
+    __m128 t = _mm_sub_ps(_mm_mul_ps(a, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f));
+    t = _mm_add_ps(_mm_mul_ps(t, a), _mm_set1_ps(10.0f));
+    t = _mm_mul_ps(t, a);
+    t = _mm_mul_ps(t, a);
+    return _mm_mul_ps(t, a);
+}
+
+inline static __m128 perlin__lerp4(__m128 a, __m128 b, __m128 t) {
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+inline static __m128i perlin__floor4(__m128 a) {
+    __m128i ai = _mm_cvttps_epi32(a);
+    __m128i lt = _mm_castps_si128(_mm_cmplt_ps(a, _mm_cvtepi32_ps(ai)));
+    return _mm_add_epi32(ai, lt);
+}
+
+inline static __m128 perlin__grad4(const i32* corner, __m128 x, __m128 y, __m128 z) {
+    __m128i k   = _mm_load_si128((const __m128i*)corner);
+    __m128  one = _mm_set1_ps(1.0f);
+
+    __m128  s1  = _mm_or_ps(one, _mm_castsi128_ps(_mm_slli_epi32(k, 31)));
+    __m128  s2  = _mm_or_ps(one, _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(k, 1), 31)));
+    __m128  lt4 = _mm_castsi128_ps(_mm_cmplt_epi32(k, _mm_set1_epi32(4)));
+    __m128  lt8 = _mm_castsi128_ps(_mm_cmplt_epi32(k, _mm_set1_epi32(8)));
+
+    __m128  g0  = _mm_and_ps(lt8, s1);
+    __m128  g1  = _mm_or_ps(_mm_and_ps(lt4, s2), _mm_andnot_ps(lt4, _mm_andnot_ps(lt8, s1)));
+    __m128  g2  = _mm_andnot_ps(lt4, s2);
+
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(g0, x), _mm_mul_ps(g1, y)), _mm_mul_ps(g2, z));
+}
+
+inline static void perlin__noise_wide(const r32* px_in, const r32* py_in, const r32* pz_in, r32* out, i32 x_mask, i32 y_mask, i32 z_mask) {
+    const Perlin_Tables& t = perlin__tables();
+
+    __m128 x = _mm_loadu_ps(px_in);
+    __m128 y = _mm_loadu_ps(py_in);
+    __m128 z = _mm_loadu_ps(pz_in);
+
+    __m128i px = perlin__floor4(x);
+    __m128i py = perlin__floor4(y);
+    __m128i pz = perlin__floor4(z);
+
+    alignas(16) i32 fx[4], fy[4], fz[4];
+    _mm_store_si128((__m128i*)fx, px);
+    _mm_store_si128((__m128i*)fy, py);
+    _mm_store_si128((__m128i*)fz, pz);
+
+    alignas(16) i32 k[8][4];
+    for_i(0, 4) { perlin__hash(t, fx[i], fy[i], fz[i], x_mask, y_mask, z_mask, &k[0][i], 4); }
+
+    x = _mm_sub_ps(x, _mm_cvtepi32_ps(px)); __m128 u = perlin__ease4(x);
+    y = _mm_sub_ps(y, _mm_cvtepi32_ps(py)); __m128 v = perlin__ease4(y);
+    z = _mm_sub_ps(z, _mm_cvtepi32_ps(pz)); __m128 w = perlin__ease4(z);
+
+    __m128 c1 = _mm_set1_ps(1.0f);
+    __m128 xs = _mm_sub_ps(x, c1);
+    __m128 ys = _mm_sub_ps(y, c1);
+    __m128 zs = _mm_sub_ps(z, c1);
+
+    __m128 n00 = perlin__lerp4(perlin__grad4(k[0], x,  y,  z), perlin__grad4(k[1], x,  y,  zs), w);
+    __m128 n01 = perlin__lerp4(perlin__grad4(k[2], x,  ys, z), perlin__grad4(k[3], x,  ys, zs), w);
+    __m128 n10 = perlin__lerp4(perlin__grad4(k[4], xs, y,  z), perlin__grad4(k[5], xs, y,  zs), w);
+    __m128 n11 = perlin__lerp4(perlin__grad4(k[6], xs, ys, z), perlin__grad4(k[7], xs, ys, zs), w);
+
+    __m128 n0  = perlin__lerp4(n00, n01, v);
+    __m128 n1  = perlin__lerp4(n10, n11, v);
+
+    _mm_storeu_ps(out, perlin__lerp4(n0, n1, u));
+}
+
+#else
+
+#define PERLIN_WIDTH 1
+
+inline static void perlin__noise_wide(const r32* x, const r32* y, const r32* z, r32* out, i32 x_mask, i32 y_mask, i32 z_mask) {
+    *out = stb_perlin_noise3(*x, *y, *z, x_mask + 1, y_mask + 1, z_mask + 1);
+}
+
+#endif
+
+// out[i] = stb_perlin_noise3(x[i], y[i], z[i], x_wrap, y_wrap, z_wrap)
+inline static void perlin_noise3_batch(const r32* x, const r32* y, const r32* z, r32* out, i32 n,
+                                i32 x_wrap = 0, i32 y_wrap = 0, i32 z_wrap = 0) {
+    i32 x_mask = perlin__wrap_mask(x_wrap);
+    i32 y_mask = perlin__wrap_mask(y_wrap);
+    i32 z_mask = perlin__wrap_mask(z_wrap);
+
+    i32 i = 0;
+    for (; i + PERLIN_WIDTH <= n; i += PERLIN_WIDTH) {
+        perlin__noise_wide(x + i, y + i, z + i, out + i, x_mask, y_mask, z_mask);
+    }
+    for (; i < n; i++) {
+        out[i] = stb_perlin_noise3(x[i], y[i], z[i], x_wrap, y_wrap, z_wrap);
+    }
+}
+
+// out[i] = stb_perlin_fbm_noise3(x[i], y[i], z[i], ...)
+inline static void perlin_fbm_noise3_batch(const r32* x, const r32* y, const r32* z, r32* out, i32 n,
+                                    r32 lacunarity, r32 gain, i32 octaves,
+                                    i32 x_wrap = 0, i32 y_wrap = 0, i32 z_wrap = 0) {
+    for_i(0, n) { out[i] = 0.0f; }
+
+    for (i32 start = 0; start < n; start += 256) {
+        r32 sx[256], sy[256], sz[256], r[256];
+        i32 len = MIN(256, n - start);
+
+        r32 frequency = 1.0f;
+        r32 amplitude = 1.0f;
+
+        for_k(0, octaves) {
+            for_i(0, len) {
+                sx[i] = x[start + i] * frequency;
+                sy[i] = y[start + i] * frequency;
+                sz[i] = z[start + i] * frequency;
+            }
+            perlin_noise3_batch(sx, sy, sz, r, len, x_wrap, y_wrap, z_wrap);
+            for_i(0, len) { out[start + i] += r[i] * amplitude; }
+
+            frequency *= lacunarity;
+            amplitude *= gain;
+        }
+    }
+}
+
+// out[i] = stb_perlin_turbulence_noise3(x[i], y[i], z[i], ...)
+inline static void perlin_turbulence_noise3_batch(const r32* x, const r32* y, const r32* z, r32* out, i32 n,
+                                           r32 lacunarity, r32 gain, i32 octaves,
+                                           i32 x_wrap = 0, i32 y_wrap = 0, i32 z_wrap = 0) {
+    for_i(0, n) { out[i] = 0.0f; }
+
+    for (i32 start = 0; start < n; start += 256) {
+        r32 sx[256], sy[256], sz[256], r[256];
+        i32 len = MIN(256, n - start);
+
+        r32 frequency = 1.0f;
+        r32 amplitude = 1.0f;
+
+        for_k(0, octaves) {
+            for_i(0, len) {
+                sx[i] = x[start + i] * frequency;
+                sy[i] = y[start + i] * frequency;
+                sz[i] = z[start + i] * frequency;
+            }
+            perlin_noise3_batch(sx, sy, sz, r, len, x_wrap, y_wrap, z_wrap);
+            for_i(0, len) {
+                r32 a = r[i] * amplitude;
+                out[start + i] += a < 0 ? -a : a;
+            }
+
+            frequency *= lacunarity;
+            amplitude *= gain;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,683 @@
+#ifndef __SOFT_RENDER_H__
+#define __SOFT_RENDER_H__
+
+// the render api of ats_tool.h drawn by the cpu instead of GL: render_cube, render_cube_prefab, render_rectangle,
+// render_triangle, vertex_array_render (so the bitmap text too), render_pixel_size and the window_* calls a frame
+// needs, into a Soft_Frame in memory.
+//
+// Triangles are transformed, clipped at the near plane and set up when they are drawn. render_flush (and with it
+// window_update) sorts them into 64x64 pixel tiles and rasterizes the tiles in parallel on a Job_Pool, every tile
+// goes through its triangles in the order they were drawn, so blending and the depth test come out like with GL.
+// Edge functions and the depth test do 8 pixels at a time with AVX2, 4 with SSE2, with the same float math on
+// every path: a frame is bit for bit the same for any number of threads and with either path, good enough for
+// golden images. Across builds only without FP contraction (-ffp-contract=off, build.sh and build.bat use it): a
+// fused multiply-add rounds once instead of twice, here and in the game's simulation too, so a -march=native
+// build with FMA would draw other pixels than one without. It is not the same picture as the GPU's either, there
+// is no multisampling and blending is 8 bit integer math!
+//
+// @NOTE: included by ats_tool.h when ATS_HEADLESS and ATS_SOFTWARE_RENDER are both defined, right after VERTEX ARRAY.
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define SOFT_TILE 64
+
+struct Soft_Triangle {
+    r32     a[3], b[3], c[3];       // edge i (from vertex i to i + 1) is a*x + b*y + c, inside is > 0, or >= 0 on a top or left edge
+    u32     top_left;               // bit i for edge i
+    r32     za, zb, zc;             // depth plane
+    r32     ca[4], cb[4], cc[4];    // color planes, only when the vertex colors differ
+    Color   color;
+    b32     flat;
+    b32     depth_test;
+    i32     min_x, min_y;           // pixel bounds on the frame, inclusive
+    i32     max_x, max_y;
+};
+
+struct Soft_Frame {
+    i32                     width;
+    i32                     height;
+    i32                     tiles_x;
+    i32                     tiles_y;
+    i32                     stride;         // pixels per row, whole tiles so a wide load never reaches into another tile
+
+    Array<Color>            color;          // bottom row first, like GL
+    Array<r32>              depth;
+
+    b32                     open;
+    b32                     clear;          // every tile clears itself before its triangles
+    b32                     depth_test;
+    m4                      view_proj;
+    r32                     pixel_scale;    // see render_pixel_size
+
+    Array<Soft_Triangle>    tris;
+    Array<i32>              bin_start;      // first entry of every tile in bin_tris, one more for the end
+    Array<i32>              bin_fill;
+    Array<i32>              bin_tris;
+
+    Job_Pool                pool;
+};
+
+typedef     Soft_Frame*     Render_Window;
+
+// what render_* draws into, the frame of the last window_create
+static Soft_Frame* soft_target;
+
+// ========================================= SETUP ========================================== //
+
+static void soft__setup(Soft_Frame* f, v3 p0, v3 p1, v3 p2, Color c0, Color c1, Color c2) {
+    r32 area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+    if (!(area != 0)) { return; }   // degenerate, or NaN
+
+    // counter clockwise from here on, nothing is culled
+    if (area < 0) {
+        std::swap(p1, p2);
+        std::swap(c1, c2);
+        area = -area;
+    }
+
+    r32 min_x = MAX(MIN(MIN(p0.x, p1.x), p2.x), 0.0f);
+    r32 min_y = MAX(MIN(MIN(p0.y, p1.y), p2.y), 0.0f);
+    r32 max_x = MIN(MAX(MAX(p0.x, p1.x), p2.x), (r32)(f->width - 1));
+    r32 max_y = MIN(MAX(MAX(p0.y, p1.y), p2.y), (r32)(f->height - 1));
+    if (min_x > max_x || min_y > max_y) { return; }
+
+    Soft_Triangle* t = f->tris.create();
+    RENDER_TRACE_COUNT(VERTICES, 3);
+
+    const v3 p[3] = { p0, p1, p2 };
+    t->top_left = 0;
+    for_i (0, 3) {
+        v3 u = p[i];
+        v3 v = p[(i + 1) % 3];
+        t->a[i] = u.y - v.y;
+        t->b[i] = v.x - u.x;
+        t->c[i] = -(t->a[i] * u.x + t->b[i] * u.y);
+        if (t->a[i] > 0 || (t->a[i] == 0 && t->b[i] < 0)) { t->top_left |= 1 << i; }
+    }
+
+    // the weight of vertex 0 is edge 1 / area, of vertex 1 edge 2, of vertex 2 edge 0
+    r32 inv = 1.0f / area;
+    t->za = (t->a[1] * p0.z + t->a[2] * p1.z + t->a[0] * p2.z) * inv;
+    t->zb = (t->b[1] * p0.z + t->b[2] * p1.z + t->b[0] * p2.z) * inv;
+    t->zc = (t->c[1] * p0.z + t->c[2] * p1.z + t->c[0] * p2.z) * inv;
+
+    t->color = c0;
+    t->flat  = !memcmp(&c0, &c1, sizeof (Color)) && !memcmp(&c0, &c2, sizeof (Color));
+    if (!t->flat) {
+        const u8* k0 = &c0.r;
+        const u8* k1 = &c1.r;
+        const u8* k2 = &c2.r;
+        for_i (0, 4) {
+            t->ca[i] = (t->a[1] * k0[i] + t->a[2] * k1[i] + t->a[0] * k2[i]) * inv;
+            t->cb[i] = (t->b[1] * k0[i] + t->b[2] * k1[i] + t->b[0] * k2[i]) * inv;
+            t->cc[i] = (t->c[1] * k0[i] + t->c[2] * k1[i] + t->c[0] * k2[i]) * inv;
+        }
+    }
+
+    t->depth_test = f->depth_test;
+    t->min_x = (i32)floorf(min_x);
+    t->min_y = (i32)floorf(min_y);
+    t->max_x = (i32)ceilf(max_x);
+    t->max_y = (i32)ceilf(max_y);
+}
+
+static v3 soft__to_window(const Soft_Frame* f, v4 p) {
+    r32 inv = 1.0f / p.w;
+    return {
+        (p.x * inv * 0.5f + 0.5f) * f->width,
+        (p.y * inv * 0.5f + 0.5f) * f->height,
+        p.z * inv * 0.5f + 0.5f,
+    };
+}
+
+// bit per clip plane the point is outside of
+inline static u32 soft__outcode(v4 p) {
+    return (p.x < -p.w) | (p.x > p.w) << 1 | (p.y < -p.w) << 2 | (p.y > p.w) << 3 | (p.z > p.w) << 4;
+}
+
+// clip space in, cut at the near plane (z >= -w) like GL does, the other planes are left to the pixel bounds
+static void soft__add_clipped(Soft_Frame* f, const v4* p, const Color* c) {
+    // all three outside of the same plane
+    if (soft__outcode(p[0]) & soft__outcode(p[1]) & soft__outcode(p[2])) { return; }
+
+    r32 d[3];
+    i32 inside = 0;
+    for_i (0, 3) {
+        d[i]    = p[i].z + p[i].w;
+        inside += d[i] >= 0;
+    }
+
+    if (inside == 0) { return; }
+    if (inside == 3) {
+        soft__setup(f, soft__to_window(f, p[0]), soft__to_window(f, p[1]), soft__to_window(f, p[2]), c[0], c[1], c[2]);
+        return;
+    }
+
+    v4      poly[4];
+    Color   poly_color[4];
+    i32     n = 0;
+    for_i (0, 3) {
+        i32 j = (i + 1) % 3;
+        if (d[i] >= 0) {
+            poly[n]         = p[i];
+            poly_color[n]   = c[i];
+            n++;
+        }
+        if ((d[i] >= 0) != (d[j] >= 0)) {
+            r32 t = d[i] / (d[i] - d[j]);
+            poly[n]         = p[i] + (p[j] - p[i]) * t;
+            poly_color[n]   = color_lerp(c[i], c[j], t);
+            n++;
+        }
+    }
+
+    v3 w[4];
+    for_i (0, n) { w[i] = soft__to_window(f, poly[i]); }
+    for (i32 i = 2; i < n; ++i) {
+        soft__setup(f, w[0], w[i - 1], w[i], poly_color[0], poly_color[i - 1], poly_color[i]);
+    }
+}
+
+static void soft__add_triangle(Soft_Frame* f, v3 p0, v3 p1, v3 p2, Color c0, Color c1, Color c2) {
+    const v4    p[3] = {
+        f->view_proj * v4 { p0.x, p0.y, p0.z, 1 },
+        f->view_proj * v4 { p1.x, p1.y, p1.z, 1 },
+        f->view_proj * v4 { p2.x, p2.y, p2.z, 1 },
+    };
+    const Color c[3] = { c0, c1, c2 };
+
+    soft__add_clipped(f, p, c);
+}
+
+// ========================================= RASTER ========================================= //
+
+// coverage and depth test of the pixels x .. x + SOFT_WIDTH - 1 of a row, returns a bit per pixel that passed
+// and their depth in z. depth is the depth buffer at x.
+
+#if defined(__AVX2__)
+
+#define SOFT_WIDTH 8
+
+inline static u32 soft__coverage(const Soft_Triangle* t, i32 x, r32 py, const r32* depth, r32* z) {
+    __m256  px      = _mm256_add_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))), _mm256_set1_ps(0.5f));
+    __m256  zero    = _mm256_setzero_ps();
+    __m256  inside  = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    for_i (0, 3) {
+        __m256 e    = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t->a[i]), px), _mm256_set1_ps(t->b[i] * py)), _mm256_set1_ps(t->c[i]));
+        __m256 edge = (t->top_left & (1 << i))? _mm256_cmp_ps(e, zero, _CMP_GE_OQ) : _mm256_cmp_ps(e, zero, _CMP_GT_OQ);
+        inside      = _mm256_and_ps(inside, edge);
+    }
+
+    __m256 zs = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t->za), px), _mm256_set1_ps(t->zb * py)), _mm256_set1_ps(t->zc));
+    inside    = _mm256_and_ps(inside, _mm256_cmp_ps(zs, _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+    if (t->depth_test) { inside = _mm256_and_ps(inside, _mm256_cmp_ps(zs, _mm256_loadu_ps(depth), _CMP_LT_OQ)); }
+
+    _mm256_storeu_ps(z, zs);
+    return (u32)_mm256_movemask_ps(inside);
+}
+
+#elif defined(__SSE2__)
+
+#define SOFT_WIDTH 4
+
+inline static u32 soft__coverage(const Soft_Triangle* t, i32 x, r32 py, const r32* depth, r32* z) {
+    __m128  px      = _mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x), _mm_setr_epi32(0, 1, 2, 3))), _mm_set1_ps(0.5f));
+    __m128  zero    = _mm_setzero_ps();
+    __m128  inside  = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    for_i (0, 3) {
+        __m128 e    = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->a[i]), px), _mm_set1_ps(t->b[i] * py)), _mm_set1_ps(t->c[i]));
+        __m128 edge = (t->top_left & (1 << i))? _mm_cmpge_ps(e, zero) : _mm_cmpgt_ps(e, zero);
+        inside      = _mm_and_ps(inside, edge);
+    }
+
+    __m128 zs = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->za), px), _mm_set1_ps(t->zb * py)), _mm_set1_ps(t->zc));
+    inside    = _mm_and_ps(inside, _mm_cmple_ps(zs, _mm_set1_ps(1.0f)));
+    if (t->depth_test) { inside = _mm_and_ps(inside, _mm_cmplt_ps(zs, _mm_loadu_ps(depth))); }
+
+    _mm_storeu_ps(z, zs);
+    return (u32)_mm_movemask_ps(inside);
+}
+
+#else
+
+#define SOFT_WIDTH 1
+
+inline static u32 soft__coverage(const Soft_Triangle* t, i32 x, r32 py, const r32* depth, r32* z) {
+    r32 px = (r32)x + 0.5f;
+
+    for_i (0, 3) {
+        r32 e = t->a[i] * px + t->b[i] * py + t->c[i];
+        if (!(e > 0 || ((t->top_left & (1 << i)) && e >= 0))) { return 0; }
+    }
+
+    *z = t->za * px + t->zb * py + t->zc;
+    return *z <= 1.0f && (!t->depth_test || *z < *depth);
+}
+
+#endif
+
+inline static u8 soft__channel(r32 v) {
+    return (u8)(v <= 0? 0 : v >= 255? 255 : (i32)(v + 0.5f));
+}
+
+// src over dst with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, alpha included
+inline static Color soft__blend(Color src, Color dst) {
+    u32 a = src.a;
+    u32 k = 255 - a;
+    return {
+        (u8)((src.r * a + dst.r * k + 127) / 255),
+        (u8)((src.g * a + dst.g * k + 127) / 255),
+        (u8)((src.b * a + dst.b * k + 127) / 255),
+        (u8)((src.a * a + dst.a * k + 127) / 255),
+    };
+}
+
+// x0 .. x1 and y0 .. y1 inside the tile that starts at tile_x
+static void soft__draw_triangle(Soft_Frame* f, const Soft_Triangle* t, i32 tile_x, i32 x0, i32 y0, i32 x1, i32 y1) {
+    alignas(32) r32 z[SOFT_WIDTH];
+
+    // groups of SOFT_WIDTH pixels from the start of the tile, the tile is a whole number of them
+    i32 start = tile_x + (x0 - tile_x) / SOFT_WIDTH * SOFT_WIDTH;
+
+    for (i32 y = y0; y <= y1; ++y) {
+        r32     py      = (r32)y + 0.5f;
+        Color*  colors  = f->color.ptr() + (i64)y * f->stride;
+        r32*    depths  = f->depth.ptr() + (i64)y * f->stride;
+
+        for (i32 x = start; x <= x1; x += SOFT_WIDTH) {
+            u32 mask = soft__coverage(t, x, py, depths + x, z);
+            if (x < x0)                     { mask &= ~((1u << (x0 - x)) - 1); }
+            if (x1 - x + 1 < SOFT_WIDTH)    { mask &= (1u << (x1 - x + 1)) - 1; }
+
+            for (; mask; mask &= mask - 1) {
+                i32     lane    = __builtin_ctz(mask);
+                i32     px      = x + lane;
+                Color   src     = t->color;
+
+                if (!t->flat) {
+                    r32 fx = (r32)px + 0.5f;
+                    src = {
+                        soft__channel(t->ca[0] * fx + t->cb[0] * py + t->cc[0]),
+                        soft__channel(t->ca[1] * fx + t->cb[1] * py + t->cc[1]),
+                        soft__channel(t->ca[2] * fx + t->cb[2] * py + t->cc[2]),
+                        soft__channel(t->ca[3] * fx + t->cb[3] * py + t->cc[3]),
+                    };
+                }
+
+                // the alpha test of the GL path, fully transparent pixels don't touch depth either
+                if (!src.a) { continue; }
+
+                colors[px] = src.a == 255? src : soft__blend(src, colors[px]);
+                if (t->depth_test) { depths[px] = z[lane]; }
+            }
+        }
+    }
+}
+
+static void soft__draw_tile(Soft_Frame* f, i64 tile) {
+    i32 x0 = (i32)(tile % f->tiles_x) * SOFT_TILE;
+    i32 y0 = (i32)(tile / f->tiles_x) * SOFT_TILE;
+    i32 x1 = MIN(x0 + SOFT_TILE, f->width) - 1;
+    i32 y1 = MIN(y0 + SOFT_TILE, f->height) - 1;
+
+    if (f->clear) {
+        for (i32 y = y0; y <= y1; ++y) {
+            Color*  colors = f->color.ptr() + (i64)y * f->stride;
+            r32*    depths = f->depth.ptr() + (i64)y * f->stride;
+            for (i32 x = x0; x <= x1; ++x) {
+                colors[x] = { 0, 0, 0, 255 };
+                depths[x] = 1.0f;
+            }
+        }
+    }
+
+    for (i32 k = f->bin_start[tile]; k < f->bin_start[tile + 1]; ++k) {
+        const Soft_Triangle* t = &f->tris[f->bin_tris[k]];
+        soft__draw_triangle(f, t, x0, MAX(x0, t->min_x), MAX(y0, t->min_y), MIN(x1, t->max_x), MIN(y1, t->max_y));
+    }
+}
+
+// every triangle goes into the bin of every tile its bounds touch, in the order they were drawn
+static void soft__bin(Soft_Frame* f) {
+    i32 tiles = f->tiles_x * f->tiles_y;
+
+    f->bin_start.resize(tiles + 1);
+    memset(f->bin_start.ptr(), 0, (tiles + 1) * sizeof (i32));
+
+    for_i (0, f->tris.len()) {
+        const Soft_Triangle* t = &f->tris[i];
+        for (i32 ty = t->min_y / SOFT_TILE; ty <= t->max_y / SOFT_TILE; ++ty) {
+            for (i32 tx = t->min_x / SOFT_TILE; tx <= t->max_x / SOFT_TILE; ++tx) {
+                f->bin_start[ty * f->tiles_x + tx + 1]++;
+            }
+        }
+    }
+    for_i (0, tiles) { f->bin_start[i + 1] += f->bin_start[i]; }
+
+    f->bin_tris.resize(f->bin_start[tiles]);
+    f->bin_fill.resize(tiles);
+    memcpy(f->bin_fill.ptr(), f->bin_start.ptr(), tiles * sizeof (i32));
+
+    for_i (0, f->tris.len()) {
+        const Soft_Triangle* t = &f->tris[i];
+        for (i32 ty = t->min_y / SOFT_TILE; ty <= t->max_y / SOFT_TILE; ++ty) {
+            for (i32 tx = t->min_x / SOFT_TILE; tx <= t->max_x / SOFT_TILE; ++tx) {
+                f->bin_tris[f->bin_fill[ty * f->tiles_x + tx]++] = i;
+            }
+        }
+    }
+}
+
+// ========================================= RENDER ========================================= //
+
+// rasterizes everything drawn since the last flush
+static void render_flush() {
+    Soft_Frame* f = soft_target;
+    if (!f->clear && !f->tris.len()) { return; }
+
+    PROFILE_FUNCTION();
+
+    RENDER_TRACE_COUNT(DRAW_CALLS, 1);
+    soft__bin(f);
+    job_pool_for(&f->pool, f->tiles_x * f->tiles_y, 1, [f](i64 tile) { soft__draw_tile(f, tile); });
+
+    f->tris.clear();
+    f->clear = false;
+}
+
+// only decides for the triangles drawn after it, nothing has to be flushed
+static void render_set_depth_test(b32 enabled) {
+    soft_target->depth_test = enabled;
+    RENDER_TRACE_COUNT(STATE_CHANGES, 1);
+}
+
+static void render_rectangle(r32 px, r32 py, r32 qx, r32 qy, r32 z, u8 r, u8 g, u8 b, u8 a) {
+    RENDER_TRACE_COUNT(RECTANGLES, 1);
+    Color c = { r, g, b, a };
+    soft__add_triangle(soft_target, { px, py, z }, { px, qy, z }, { qx, py, z }, c, c, c);
+    soft__add_triangle(soft_target, { px, qy, z }, { qx, qy, z }, { qx, py, z }, c, c, c);
+}
+
+// the same four faces (UP, Right, LEFT, FRONT) and triangle order as the cube mesh of the GL path, from the
+// 8 corners already transformed. Corner k has bit 0 set for qx, bit 1 for qy and bit 2 for qz.
+static void soft__cube(Soft_Frame* f, const v4 corners[8], Color color) {
+    static const u8 quads[4][4] = {
+        { 0, 1, 3, 2 },
+        { 2, 6, 7, 3 },
+        { 0, 4, 5, 1 },
+        { 0, 4, 6, 2 },
+    };
+
+    Color c[3] = { color, color, color };
+
+    u32 outside = ~0u;
+    for_i (0, 8) {
+        outside &= soft__outcode(corners[i]);
+    }
+    if (outside) { return; }
+
+    for_i (0, 4) {
+        const u8*   q       = quads[i];
+        const v4    t0[3]   = { corners[q[0]], corners[q[1]], corners[q[2]] };
+        const v4    t1[3]   = { corners[q[0]], corners[q[2]], corners[q[3]] };
+        soft__add_clipped(f, t0, c);
+        soft__add_clipped(f, t1, c);
+    }
+}
+
+static void render_cube(r32 px, r32 py, r32 qx, r32 qy, r32 pz, r32 qz, u8 r, u8 g, u8 b, u8 a) {
+    RENDER_TRACE_COUNT(CUBES, 1);
+    Soft_Frame* f = soft_target;
+    v4          corners[8];
+
+    for_i (0, 8) {
+        corners[i] = f->view_proj * v4 { (i & 1)? qx : px, (i & 2)? qy : py, (i & 4)? qz : pz, 1 };
+    }
+    soft__cube(f, corners, { r, g, b, a });
+}
+
+static void render_cube_prefab(const Cube_Prefab* prefab, r32 x, r32 y, u8 r, u8 g, u8 b, u8 a) {
+    RENDER_TRACE_COUNT(CUBES, 1);
+    Soft_Frame* f = soft_target;
+    v4          corners[8];
+
+    for_i (0, 8) {
+        const v3 c = prefab->corners[i];
+        corners[i] = f->view_proj * v4 { x + c.x, y + c.y, c.z, 1 };
+    }
+    soft__cube(f, corners, { r, g, b, a });
+}
+
+static void render_triangle(
+        r32 p0_x, r32 p0_y, r32 p0_z,
+        r32 p1_x, r32 p1_y, r32 p1_z,
+        r32 p2_x, r32 p2_y, r32 p2_z,
+        u8 r, u8 g, u8 b, u8 a) {
+    RENDER_TRACE_COUNT(TRIANGLES, 1);
+    Color c = { r, g, b, a };
+    soft__add_triangle(soft_target, { p0_x, p0_y, p0_z }, { p1_x, p1_y, p1_z }, { p2_x, p2_y, p2_z }, c, c, c);
+}
+
+static r32 render_pixel_size(v3 pos, r32 size) {
+    v4 clip = soft_target->view_proj * v4 { pos.x, pos.y, pos.z, 1 };
+    if (clip.w <= 0) { return 1e30f; }
+    return size * soft_target->pixel_scale / clip.w;
+}
+
+static void vertex_array_render(const Vertex_Array* verts) {
+    RENDER_TRACE_COUNT(VERTEX_ARRAYS, 1);
+    for (i64 i = 0; i + 2 < verts->len(); i += 3) {
+        const Vertex* v = verts->ptr() + i;
+        soft__add_triangle(soft_target, v[0].pos, v[1].pos, v[2].pos, v[0].color, v[1].color, v[2].color);
+    }
+}
+
+// ========================================= WINDOW ========================================= //
+
+// a frame in memory with the size of the window, title and vsync mean nothing here
+static Render_Window window_create(i32 width, i32 height, const char* title, u32 vsync) {
+    Soft_Frame* f = new Soft_Frame();
+
+    f->width        = width;
+    f->height       = height;
+    f->tiles_x      = (width + SOFT_TILE - 1) / SOFT_TILE;
+    f->tiles_y      = (height + SOFT_TILE - 1) / SOFT_TILE;
+    f->stride       = f->tiles_x * SOFT_TILE;
+    f->open         = true;
+    f->clear        = true;
+    f->depth_test   = true;
+    f->view_proj    = m4_identity();
+    f->pixel_scale  = 1;
+
+    f->color.resize((i64)f->stride * height);
+    f->depth.resize((i64)f->stride * height);
+    for_i (0, f->depth.len()) { f->depth[i] = 1.0f; }
+
+    job_pool_create(&f->pool, -1);
+
+    soft_target = f;
+    return f;
+}
+
+static void window_destroy(Render_Window window) {
+    if (soft_target == window) { soft_target = NULL; }
+#if defined(ATS_RENDER_TRACE)
+    render_trace_close();
+#endif
+
+    job_pool_destroy(&window->pool);
+    window->color.destroy();
+    window->depth.destroy();
+    window->tris.destroy();
+    window->bin_start.destroy();
+    window->bin_fill.destroy();
+    window->bin_tris.destroy();
+    delete window;
+}
+
+static inline b32  window_is_open (Render_Window window)  { return window->open; }
+static inline void window_close   (Render_Window window)  { window->open = false; }
+
+static inline void window_set_title(Render_Window window, const char* title) {}
+
+static inline void window_clear(Render_Window window) {
+    window->tris.clear();
+    window->clear = true;
+    RENDER_TRACE_FRAME_BEGIN();
+}
+
+// the frame is complete after it, color holds the picture
+static inline void window_update(Render_Window window) {
+    render_flush();
+    RENDER_TRACE_FRAME_END();
+}
+
+static v2 window_get_size(Render_Window window) {
+    return { (r32)window->width, (r32)window->height };
+}
+
+static void window_update_view(
+        Render_Window window,
+        r32 pos_x,  r32 pos_y,       r32 pos_z,
+        r32 look_x, r32 look_y,      r32 look_z,
+        r32 up_x,   r32 up_y,        r32 up_z,
+        r32 fov,    r32 near_plane,  r32 far_plane) {
+    window->view_proj =
+        m4_perspective(fov, (r32)window->width / (r32)window->height, near_plane, far_plane) *
+        m4_look_at({ pos_x, pos_y, pos_z }, { look_x, look_y, look_z }, { up_x, up_y, up_z });
+    window->pixel_scale = window->height / 2.0f * fov_scale(fov);
+}
+
+// ========================================= IMAGES ========================================= //
+
+// rgb, top row first, the way image files want it
+static void soft_frame_rgb(const Soft_Frame* f, Array<u8>* out) {
+    out->resize((i64)f->width * f->height * 3);
+
+    u8* o = out->ptr();
+    for (i32 y = f->height - 1; y >= 0; --y) {
+        const Color* row = f->color.ptr() + (i64)y * f->stride;
+        for_i (0, f->width) {
+            *o++ = row[i].r;
+            *o++ = row[i].g;
+            *o++ = row[i].b;
+        }
+    }
+}
+
+static b32 soft_frame_write_ppm(const Soft_Frame* f, const char* file_name) {
+    Array<u8> rgb = {};
+    soft_frame_rgb(f, &rgb);
+
+    FILE* fp = fopen(file_name, "wb");
+    b32   ok = fp != NULL;
+    if (ok) {
+        fprintf(fp, "P6\n%d %d\n255\n", f->width, f->height);
+        ok = fwrite(rgb.ptr(), 1, rgb.len(), fp) == (size_t)rgb.len();
+        fclose(fp);
+    }
+    rgb.destroy();
+    return ok;
+}
+
+struct Soft_Crc_Table {
+    u32     t[256];
+};
+
+static u32 soft__crc32(u32 crc, const u8* p, i64 n) {
+    static const Soft_Crc_Table table = [] {
+        Soft_Crc_Table table;
+        for_i (0, 256) {
+            u32 c = (u32)i;
+            for_j (0, 8) { c = (c & 1)? 0xEDB88320u ^ (c >> 1) : c >> 1; }
+            table.t[i] = c;
+        }
+        return table;
+    }();
+
+    crc = ~crc;
+    for (i64 i = 0; i < n; ++i) { crc = table.t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8); }
+    return ~crc;
+}
+
+static void soft__put_u32_be(Array<u8>* out, u32 v) {
+    out->add((u8)(v >> 24));
+    out->add((u8)(v >> 16));
+    out->add((u8)(v >> 8));
+    out->add((u8)v);
+}
+
+static void soft__png_chunk(Array<u8>* out, const char* type, const u8* data, i64 size) {
+    soft__put_u32_be(out, (u32)size);
+
+    i64 start = out->len();
+    for_i (0, 4) { out->add((u8)type[i]); }
+    for (i64 i = 0; i < size; ++i) { out->add(data[i]); }
+
+    soft__put_u32_be(out, soft__crc32(0, out->ptr() + start, size + 4));
+}
+
+// uncompressed deflate (stored blocks) so there is no zlib to depend on, the files are as big as a ppm!
+static b32 soft_frame_write_png(const Soft_Frame* f, const char* file_name) {
+    Array<u8> rgb = {};
+    soft_frame_rgb(f, &rgb);
+
+    Array<u8> raw = {};
+    i64 stride = (i64)f->width * 3;
+    for_i (0, f->height) {
+        raw.add(0);     // filter: none
+        raw.grow(stride);
+        memcpy(raw.ptr() + raw.len(), rgb.ptr() + i * stride, stride);
+        raw._len += stride;
+    }
+
+    Array<u8> zlib = {};
+    zlib.add(0x78);
+    zlib.add(0x01);
+    u32 a = 1, b = 0;
+    for (i64 at = 0; at < raw.len(); ) {
+        i64 n = MIN(raw.len() - at, (i64)65535);
+        zlib.add(at + n == raw.len());
+        zlib.add((u8)n);
+        zlib.add((u8)(n >> 8));
+        zlib.add((u8)~n);
+        zlib.add((u8)(~n >> 8));
+        for (i64 i = 0; i < n; ++i) {
+            u8 c = raw[at + i];
+            zlib.add(c);
+            a = (a + c) % 65521;
+            b = (b + a) % 65521;
+        }
+        at += n;
+    }
+    soft__put_u32_be(&zlib, (b << 16) | a);
+
+    u32 w = (u32)f->width;
+    u32 h = (u32)f->height;
+    const u8 header[13] = {
+        (u8)(w >> 24), (u8)(w >> 16), (u8)(w >> 8), (u8)w,
+        (u8)(h >> 24), (u8)(h >> 16), (u8)(h >> 8), (u8)h,
+        8, 2, 0, 0, 0,      // 8 bit rgb, no interlace
+    };
+
+    static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    Array<u8> png = {};
+    for_i (0, 8) { png.add(signature[i]); }
+    soft__png_chunk(&png, "IHDR", header, sizeof header);
+    soft__png_chunk(&png, "IDAT", zlib.ptr(), zlib.len());
+    soft__png_chunk(&png, "IEND", NULL, 0);
+
+    b32 ok = file_write_bin(file_name, png.ptr(), png.len());
+
+    rgb.destroy();
+    raw.destroy();
+    zlib.destroy();
+    png.destroy();
+    return ok;
+}
+
+#endif
@@ -0,0 +1,572 @@
+#define ATS_HEADLESS
+#include <chrono>
+#include "core.h"
+
+//==========================BENCH===========================//
+//
+// bench.exe [--out results.json] [--baseline old.json] [--threshold 10] [--filter name] [--replay file]
+//
+// Every benchmark resets the rng and its own state before each repetition,
+// so two runs of the same binary do the exact same work. Results are written
+// as json (stdout when no --out is given). With --baseline every benchmark is
+// compared by median against the old file, and the exit code is 1 when one of
+// them got slower than --threshold percent. sim_replay steps the whole game
+// through --replay (or 10 seconds of the scripted bot without one),
+// sim_midgame only its second half, starting from a snapshot, rewind_record
+// the same with the rewind history recorded every tick, rewind_seek and
+// rewind_step_back go back through that history.
+
+struct benchResult{
+	char name[64];
+	i64 ops;
+	int reps;
+	double medianNs;
+	double minNs;
+};
+
+Array<benchResult> benchResults;
+const char* benchFilter;
+gameWorld* benchWorld;	// every game benchmark works on this one
+
+double benchNow(){
+	return std::chrono::duration<double, std::nano>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void benchResetRnd(){
+	default_rnd = { 123456789u, 362436069u, 521288629u };
+	benchWorld->rnd = default_rnd;
+}
+
+int compareDouble(const void* a, const void* b){
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+bool benchWanted(const char* name){
+	return !benchFilter || strstr(name, benchFilter);
+}
+
+// setup() runs untimed before every repetition, body() is timed and does ops operations
+template <typename Setup, typename Body>
+void bench(const char* name, i64 ops, int reps, Setup setup, Body body){
+	if(!benchWanted(name))
+		return;
+
+	double samples[256];
+	if(reps > (int)count_of(samples))
+		reps = count_of(samples);
+
+	setup();
+	body(); // warm up caches and the allocator
+
+	for(int r = 0; r < reps; r++){
+		benchResetRnd();
+		setup();
+		double start = benchNow();
+		body();
+		samples[r] = (benchNow() - start) / (double)ops;
+	}
+	qsort(samples, reps, sizeof(double), compareDouble);
+
+	benchResult* res = benchResults.create();
+	snprintf(res->name, sizeof(res->name), "%s", name);
+	res->ops = ops;
+	res->reps = reps;
+	res->medianNs = samples[reps/2];
+	res->minNs = samples[0];
+	fprintf(stderr, "%-32s %12.3f ns/op  (min %.3f)\n", res->name, res->medianNs, res->minNs);
+}
+
+// keeps the optimizer from throwing away results
+volatile u32 benchSink;
+
+//==========================ATS PRIMITIVES==================//
+
+void benchArray(){
+	const i64 n = 1 << 20;
+	Array<u32> arr = {};
+
+	bench("array_add", n, 31,
+		[&]{ arr.destroy(); },
+		[&]{ for(i64 i = 0; i < n; i++) arr.add((u32)i); });
+
+	bench("array_rem", n, 31,
+		[&]{ arr.clear(); for(i64 i = 0; i < n; i++) arr.add((u32)i); },
+		[&]{ for(i64 i = 0; i < n; i++) arr.rem((i * 7) % arr.len()); });
+
+	// items sized array, erase from the front half like renderItems does
+	const i64 small = 64;
+	arr.clear();
+	for(i64 i = 0; i < small; i++) arr.add((u32)i);
+	bench("array_rem_ordered", small, 101,
+		[&]{ arr.clear(); for(i64 i = 0; i < small; i++) arr.add((u32)i); },
+		[&]{ for(i64 i = 0; i < small; i++) arr.rem_ordered((i * 7) % (arr.len() / 2 + 1)); });
+	arr.destroy();
+
+	// short lived arrays of a few elements, heap vs inline storage
+	const i64 temps = 1 << 16;
+	bench("array_temp_8", temps, 31,
+		[]{},
+		[&]{
+			for(i64 i = 0; i < temps; i++){
+				Array<u32> tmp = {};
+				for(u32 k = 0; k < 8; k++) tmp.add(k + (u32)i);
+				benchSink = tmp[7];
+				tmp.destroy();
+			}
+		});
+	bench("small_array_temp_8", temps, 31,
+		[]{},
+		[&]{
+			for(i64 i = 0; i < temps; i++){
+				Small_Array<u32, 8> tmp = {};
+				for(u32 k = 0; k < 8; k++) tmp.add(k + (u32)i);
+				benchSink = tmp[7];
+				tmp.destroy();
+			}
+		});
+
+	Array<particle> big = {};
+	const i64 chunks = 1 << 14;
+	bench("array_grow", chunks, 31,
+		[&]{ big.destroy(); },
+		[&]{
+			for(i64 i = 0; i < chunks; i++){
+				i64 k = 1 + (i & 15);
+				big.grow(k);
+				big._len += k;
+			}
+		});
+	big.destroy();
+}
+
+void benchTilemap(){
+	const int sweeps = 64;
+	const i64 n = (i64)sweeps * xtiles * ytiles;
+
+	bench("tilemap_set", n, 31,
+		[]{ mapInit(benchWorld); },
+		[]{
+			for(int s = 0; s < sweeps; s++)
+				for(int y = 0; y < ytiles; y++)
+					for(int x = 0; x < xtiles; x++)
+						benchWorld->map.set(x, y, (x + y + s) & 1);
+		});
+
+	bench("tilemap_get", n, 31,
+		[]{ mapInit(benchWorld); },
+		[]{
+			u32 sum = 0;
+			for(int s = 0; s < sweeps; s++)
+				for(int y = 0; y < ytiles; y++)
+					for(int x = 0; x < xtiles; x++)
+						sum += benchWorld->map.get(x, y);
+			benchSink = sum;
+		});
+
+	const i64 probes = 1 << 16;
+	Array<v2> pos = {};
+	for(i64 i = 0; i < probes; i++)
+		pos.add({randf(-2.0f, xtiles + 2.0f), randf(-2.0f, ytiles + 2.0f)});
+	bench("tilemap_get_collision", probes, 31,
+		[]{ mapInit(benchWorld); },
+		[&]{
+			u32 sum = 0;
+			for(i64 i = 0; i < probes; i++)
+				sum += tilemap_get_collision(&benchWorld->map, pos[i], 0.5f, 0.0f);
+			benchSink = sum;
+		});
+	pos.destroy();
+
+	// perlin blobs like the game's terrain, in chunks of 8 columns like mapMesh.h
+	Array<Tile_Rect> rects = {};
+	bench("tilemap_greedy_rects", xtiles * (ytiles - 2), 31,
+		[]{
+			mapInit(benchWorld);
+			for(int y = 1; y < ytiles - 1; y++)
+				for(int x = 0; x < xtiles; x++)
+					benchWorld->map.set(x, y, getNoise(benchWorld, x, y) > 0.0f ? BLOCK : NO_BLOCK);
+		},
+		[&]{
+			rects.clear();
+			for(int x = 0; x < xtiles; x += 8)
+				tilemap_greedy_rects(&benchWorld->map, BLOCK, x, 1, x + 7, ytiles - 2, &rects);
+			benchSink = rects.len();
+		});
+	rects.destroy();
+}
+
+void benchPerlin(){
+	const i64 n = xtiles * ytiles;
+	bench("stb_perlin_noise3", n, 31,
+		[]{},
+		[]{
+			float sum = 0;
+			for(int y = 0; y < ytiles; y++)
+				for(int x = 0; x < xtiles; x++)
+					sum += stb_perlin_noise3((1000+x)*0.1f, y*0.1f, 0, 0, 0, 0);
+			benchSink = (u32)(sum * 1000.0f);
+		});
+
+	static float xs[xtiles*ytiles], ys[xtiles*ytiles], zs[xtiles*ytiles], out[xtiles*ytiles];
+	for(int y = 0; y < ytiles; y++)
+		for(int x = 0; x < xtiles; x++){
+			xs[y*xtiles + x] = (1000+x)*0.1f;
+			ys[y*xtiles + x] = y*0.1f;
+			zs[y*xtiles + x] = 0;
+		}
+	bench("perlin_noise3_batch", n, 31,
+		[]{},
+		[]{
+			perlin_noise3_batch(xs, ys, zs, out, xtiles*ytiles);
+			benchSink = (u32)(out[n/2] * 1000.0f);
+		});
+	bench("perlin_fbm_noise3_batch_4", n, 31,
+		[]{},
+		[]{
+			perlin_fbm_noise3_batch(xs, ys, zs, out, xtiles*ytiles, 2.0f, 0.5f, 4);
+			benchSink = (u32)(out[n/2] * 1000.0f);
+		});
+}
+
+//==========================GAME KERNELS====================//
+
+void fillParticles(int n){
+	clearParticles(benchWorld);
+	for(int i = 0; i < n; i++){
+		// long lived, so every repetition updates the same amount of particles
+		singleParticle(benchWorld, {randf(0.0f, 160.0f), randf(0.0f, 40.0f)}, {randf(-5.0f, 5.0f), randf(-5.0f, 5.0f)},
+						{randf(-5.0f, 5.0f), randf(-5.0f, 5.0f)},
+						0.0f, randf(-1.0f, 1.0f),
+						0.2f, 1000.0f, i & 1 ? 0.0f : 0.01f,
+						255, 0, 0, 1.0f);
+	}
+	commitParticles(benchWorld);
+}
+
+void benchParticles(){
+	const int counts[] = {1000, 10000, 100000};
+	for(int c = 0; c < (int)count_of(counts); c++){
+		char name[64];
+		snprintf(name, sizeof(name), "update_particles_%dk", counts[c]/1000);
+		int n = counts[c];
+		bench(name, n, 31,
+			[=]{ fillParticles(n); },
+			[]{ updateParticles(benchWorld, 1.0f/60.0f, 0.1f); });
+	}
+	clearParticles(benchWorld);
+}
+
+void fillItems(int n){
+	clearItems(benchWorld);
+	const int types[] = {GRENADE, CLUSTERGRENADE, MISSILE, STAR, GRENADEPACK, MISSILEPACK};
+	for(int i = 0; i < n; i++){
+		// open space in the middle row, so projectiles fly instead of blowing up right away
+		gameItem itm = createGameItem(randf(10.0f, 100.0f), 20.0f + randf(-0.2f, 0.2f), 5, 0.25f,
+										(enum itemType)types[i % count_of(types)]);
+		spawnItem(benchWorld, itm);
+	}
+}
+
+void clearMiddleRows(){
+	for(int y = 18; y < 23; y++)
+		for(int x = 0; x < xtiles; x++)
+			benchWorld->map.set(x, y, NO_BLOCK);
+}
+
+void benchItems(){
+	const int counts[] = {1000, 10000};
+	for(int c = 0; c < (int)count_of(counts); c++){
+		char name[64];
+		snprintf(name, sizeof(name), "update_items_%dk", counts[c]/1000);
+		int n = counts[c];
+		bench(name, n, 31,
+			[=]{ mapInit(benchWorld); clearMiddleRows(); clearParticles(benchWorld); fillItems(n); commitItems(benchWorld); },
+			[]{ updateItems(benchWorld, 1.0f/60.0f, 0.1f); });
+	}
+	clearItems(benchWorld);
+	clearParticles(benchWorld);
+}
+
+void benchUpdateMap(){
+	bench("map_init", xtiles, 31,
+		[]{},
+		[]{ mapInit(benchWorld); });
+
+	const int columns = 256;
+	bench("update_map", columns, 31,
+		[]{ mapInit(benchWorld); },
+		[]{ for(int i = 0; i < columns; i++) updateMap(benchWorld); });
+}
+
+void fillBlocks(){
+	for(int y = 1; y < ytiles - 1; y++)
+		for(int x = 0; x < xtiles; x++)
+			benchWorld->map.set(x, y, BLOCK);
+	clearParticles(benchWorld);
+}
+
+void benchBlast(const char* name, void (*blast)(gameWorld*, int, int)){
+	// one blast every 10 tiles, so they never overlap and always hit full blocks
+	const i64 n = (xtiles/10) * ((ytiles-2)/10);
+	bench(name, n, 101,
+		[]{ mapInit(benchWorld); fillBlocks(); },
+		[=]{
+			for(int y = 5; y < ytiles - 5; y += 10)
+				for(int x = 5; x < xtiles; x += 10)
+					blast(benchWorld, x, y);
+		});
+	clearParticles(benchWorld);
+}
+
+void benchRenderString(){
+	const int n = 1024;
+	bench("render_string", n, 31,
+		[]{ bitmap_verts.clear(); },
+		[]{
+			for(int i = 0; i < n; i++)
+				render_string("SCORE : 1234567 LAST : 7654321 BEST : 3178705", 5, 41, 1, 0.15f, -0.15f, {255, 255, 255, 255});
+			benchSink = bitmap_verts.len();
+			bitmap_verts.clear();
+		});
+
+	// same line through the widget cache, the score changes every 16th frame
+	Text_Widget widgets[6] = {};
+	bench("render_text_widget", n, 31,
+		[]{ bitmap_verts.clear(); },
+		[&]{
+			for(int i = 0; i < n; i++){
+				Color white = {255, 255, 255, 255};
+				float x = 5;
+				x += render_text_widget(&widgets[0], "SCORE : ", x, 41, 1, 0.15f, -0.15f, white);
+				x += render_i32_widget(&widgets[1], 1234567 + i/16, x, 41, 1, 0.15f, -0.15f, white);
+				x += render_text_widget(&widgets[2], " LAST : ", x, 41, 1, 0.15f, -0.15f, white);
+				x += render_i32_widget(&widgets[3], 7654321, x, 41, 1, 0.15f, -0.15f, white);
+				x += render_text_widget(&widgets[4], " BEST : ", x, 41, 1, 0.15f, -0.15f, white);
+				x += render_i32_widget(&widgets[5], 3178705, x, 41, 1, 0.15f, -0.15f, white);
+			}
+			benchSink = bitmap_verts.len();
+			bitmap_verts.clear();
+		});
+	for(int i = 0; i < (int)count_of(widgets); i++)
+		widgets[i].verts.destroy();
+}
+
+//==========================SIM=============================//
+
+bool benchLoadReplay(const char* path){
+	if(path){
+		if(!replayLoad(path)){
+			fprintf(stderr, "could not read replay %s\n", path);
+			return false;
+		}
+	}
+	else
+		replayBot(600);
+	quietScores = true;
+	return true;
+}
+
+void benchReplay(){
+	benchWorld->rnd = replayRnd;
+	coreInitState(benchWorld);
+	bench("sim_replay", replayFrames.len(), 11,
+		[]{ benchWorld->rnd = replayRnd; coreInitState(benchWorld); },
+		[]{
+			frameInput in;
+			replayCursor = 0;
+			while(replayNext(&in))
+				coreStep(benchWorld, &in);
+			benchSink = benchWorld->SCORE;
+		});
+}
+
+Array<u8> benchImage;
+int benchHalf;
+
+// plays the first half of the replay once, the benches start from a snapshot of that
+void benchSnapshots(){
+	benchHalf = replayFrames.len() / 2;
+	benchWorld->rnd = replayRnd;
+	coreInitState(benchWorld);
+	frameInput in;
+	replayCursor = 0;
+	while(replayCursor < benchHalf && replayNext(&in))
+		coreStep(benchWorld, &in);
+	snapshotCapture(benchWorld, &benchImage);
+
+	Array<u8> image = {};
+	bench("snapshot_capture", 1, 101, []{}, [&]{ snapshotCapture(benchWorld, &image); benchSink = image.len(); });
+	bench("snapshot_restore", 1, 101, []{},
+		[]{ benchSink = snapshotRestore(benchWorld, benchImage.ptr(), benchImage.len()); });
+	bench("sim_midgame", replayFrames.len() - benchHalf, 11,
+		[]{ snapshotRestore(benchWorld, benchImage.ptr(), benchImage.len()); },
+		[]{
+			frameInput in;
+			replayCursor = benchHalf;
+			while(replayNext(&in))
+				coreStep(benchWorld, &in);
+			benchSink = benchWorld->SCORE;
+		});
+	image.destroy();
+}
+
+void benchRecordRewind(){
+	frameInput in;
+	replayCursor = benchHalf;
+	while(replayNext(&in)){
+		coreStep(benchWorld, &in);
+		rewindRecord(benchWorld);
+	}
+}
+
+// the second half of the replay, recorded into the rewind history every tick. The seek goes
+// to the last tick of a keyframe group, the longest chain of deltas there is.
+void benchRewind(){
+	bench("rewind_record", replayFrames.len() - benchHalf, 11,
+		[]{ snapshotRestore(benchWorld, benchImage.ptr(), benchImage.len()); rewindClear(); },
+		[]{ benchRecordRewind(); benchSink = rewindNext; });
+	if(!benchWanted("rewind_record") && !benchWanted("rewind_seek") && !benchWanted("rewind_step_back"))
+		return;
+
+	snapshotRestore(benchWorld, benchImage.ptr(), benchImage.len());
+	rewindClear();
+	benchRecordRewind();
+	int ticks = rewindLast() - rewindFirst() + 1;
+	fprintf(stderr, "  rewind history: %d ticks, %.0f bytes/tick\n", ticks, (double)rewindBytes() / ticks);
+	if(ticks < rewindKeyInterval)
+		return;
+
+	static int tick;
+	tick = rewindFirst() + rewindKeyInterval - 1;
+	bench("rewind_seek", 1, 21, []{},
+		[]{ benchSink = rewindSeek(benchWorld, tick); });
+
+	// what holding BACKSPACE does, a keyframe group back one tick at a time (one of the
+	// steps crosses into the group before)
+	if(ticks <= rewindKeyInterval)
+		return;
+	bench("rewind_step_back", rewindKeyInterval, 11,
+		[]{ snapshotRestore(benchWorld, benchImage.ptr(), benchImage.len()); rewindClear(); benchRecordRewind(); },
+		[]{
+			int steps = 0;
+			for(int i = 0; i < rewindKeyInterval; i++)
+				steps += rewindStepBack(benchWorld);
+			benchSink = steps;
+		});
+}
+
+//==========================OUTPUT==========================//
+
+void writeResults(FILE* fp){
+	fprintf(fp, "{\n  \"benchmarks\": [\n");
+	for(int i = 0; i < benchResults.len(); i++){
+		benchResult* res = benchResults.get(i);
+		fprintf(fp, "    {\"name\": \"%s\", \"ops\": %lld, \"reps\": %d, \"median_ns\": %.4f, \"min_ns\": %.4f}%s\n",
+				res->name, (long long)res->ops, res->reps, res->medianNs, res->minNs,
+				i + 1 < benchResults.len() ? "," : "");
+	}
+	fprintf(fp, "  ]\n}\n");
+}
+
+// only understands what writeResults writes, returns -1 when name is missing
+double baselineMedian(const char* json, const char* name){
+	char key[96];
+	snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+	const char* at = strstr(json, key);
+	if(!at)
+		return -1;
+	at = strstr(at, "\"median_ns\":");
+	if(!at)
+		return -1;
+	return atof(at + strlen("\"median_ns\":"));
+}
+
+int compareBaseline(const char* path, double threshold){
+	char* json = file_read_str(path);
+	if(!json){
+		fprintf(stderr, "could not read baseline %s\n", path);
+		return 1;
+	}
+	int regressions = 0;
+	fprintf(stderr, "\n%-32s %12s %12s %9s\n", "benchmark", "baseline", "current", "delta");
+	for(int i = 0; i < benchResults.len(); i++){
+		benchResult* res = benchResults.get(i);
+		double base = baselineMedian(json, res->name);
+		if(base <= 0){
+			fprintf(stderr, "%-32s %12s %12.3f %9s\n", res->name, "-", res->medianNs, "new");
+			continue;
+		}
+		double delta = 100.0 * (res->medianNs - base) / base;
+		int slower = delta > threshold;
+		regressions += slower;
+		fprintf(stderr, "%-32s %12.3f %12.3f %+8.1f%%%s\n", res->name, base, res->medianNs, delta,
+				slower ? "  REGRESSION" : "");
+	}
+	free(json);
+	return regressions ? 1 : 0;
+}
+
+//==========================BENCH END=======================//
+
+int main(int argc, char** argv){
+	const char* out = NULL;
+	const char* baseline = NULL;
+	const char* replay = NULL;
+	double threshold = 10.0;
+
+	for(int i = 1; i < argc; i++){
+		if(!strcmp(argv[i], "--out") && i + 1 < argc) out = argv[++i];
+		else if(!strcmp(argv[i], "--baseline") && i + 1 < argc) baseline = argv[++i];
+		else if(!strcmp(argv[i], "--threshold") && i + 1 < argc) threshold = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--filter") && i + 1 < argc) benchFilter = argv[++i];
+		else if(!strcmp(argv[i], "--replay") && i + 1 < argc) replay = argv[++i];
+		else{
+			fprintf(stderr, "usage: %s [--out file] [--baseline file] [--threshold pct] [--filter name] [--replay file]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	benchWorld = worldCreate();
+	job_pool_create(&mapJobPool, -1);	// like the game's world
+	benchWorld->mapJobs = &mapJobPool;
+	benchArray();
+	benchTilemap();
+	benchPerlin();
+	benchParticles();
+	benchItems();
+	benchUpdateMap();
+	benchBlast("blast1", blast1);
+	benchBlast("blast2", blast2);
+	benchBlast("blast3", blast3);
+	benchBlast("blast4", blast4);
+	benchRenderString();
+	if((benchWanted("sim_replay") || benchWanted("sim_midgame") ||
+			benchWanted("snapshot_capture") || benchWanted("snapshot_restore") ||
+			benchWanted("rewind_record") || benchWanted("rewind_seek") || benchWanted("rewind_step_back")) &&
+			benchLoadReplay(replay)){
+		benchReplay();
+		benchSnapshots();
+		benchRewind();
+	}
+	worldDestroy(benchWorld);
+	job_pool_destroy(&mapJobPool);
+
+	if(out){
+		FILE* fp = fopen(out, "w");
+		if(!fp){
+			fprintf(stderr, "could not write %s\n", out);
+			return 1;
+		}
+		writeResults(fp);
+		fclose(fp);
+	}
+	else
+		writeResults(stdout);
+
+	if(baseline)
+		return compareBaseline(baseline, threshold);
+	return 0;
+}
@@ -1,3 +1,21 @@
 @echo off
-g++ main.cpp -o game.exe -O3 -s -std=c++17 -march=native ^
- -fno-exceptions -lglfw3 -lopengl32 -lglu32 -lgdi32
+if "%1"=="bench" goto bench
+if "%1"=="sim" goto sim
+if "%1"=="pack" goto pack
+g++ main.cpp -o game.exe -O3 -s -std=c++17 -march=native -ffp-contract=off ^
+ -fno-exceptions -lglfw3 -lopengl32 -lgdi32
+goto :eof
+
+:bench
+g++ bench.cpp -o bench.exe -O3 -s -std=c++17 -march=native -ffp-contract=off ^
+ -fno-exceptions
+goto :eof
+
+:sim
+g++ sim.cpp -o sim.exe -O3 -s -std=c++17 -march=native -ffp-contract=off ^
+ -fno-exceptions
+goto :eof
+
+:pack
+g++ pack.cpp -o pack.exe -O3 -s -std=c++17 -march=native -ffp-contract=off ^
+ -fno-exceptions
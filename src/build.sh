@@ -0,0 +1,93 @@
+#!/bin/sh
+# ./build.sh [release|lto|pgo|trace|profile] [game] [sim] [bench] [pack]
+#
+# Linux counterpart of build.bat. Binaries go to build/<config>/, no targets
+# means all of them. game needs GLFW and OpenGL, the others are headless.
+#
+#   release  -O3 -march=native -ffp-contract=off, same as build.bat (no fused
+#            multiply-adds, so sim hashes and golden frames are the same as
+#            those of a build for any other cpu)
+#   lto      release + link time optimization
+#   pgo      lto + two stage profile guided optimization: the targets are
+#            built instrumented, run on $REPLAY, then rebuilt with the profile.
+#            $REPLAY defaults to ../replays/train.rep (record one with
+#            `game --record file`), without it the sim's scripted bot is used.
+#            Training the game opens a window, without $DISPLAY it is built
+#            without a profile.
+#   trace    release + ATS_RENDER_TRACE: game and sim --render take
+#            --trace file.json and --trace-summary frames (draw calls,
+#            vertices and state changes per phase of a frame)
+#   profile  release + ATS_PROFILE: game and sim take --profile file.json,
+#            a timeline of every frame for chrome://tracing or perfetto
+#
+# Compare configs with bench, e.g.
+#   build/release/bench --out release.json
+#   build/pgo/bench --baseline release.json
+
+set -e
+cd "$(dirname "$0")"
+
+CXX=${CXX:-g++}
+CONFIG=release
+TARGETS=""
+
+for arg in "$@"; do
+	case $arg in
+		release|lto|pgo|trace|profile) CONFIG=$arg ;;
+		game|sim|bench|pack) TARGETS="$TARGETS $arg" ;;
+		*) echo "usage: $0 [release|lto|pgo|trace|profile] [game] [sim] [bench] [pack]"; exit 2 ;;
+	esac
+done
+[ -z "$TARGETS" ] && TARGETS="game sim bench pack"
+
+OUT=build/$CONFIG
+FLAGS="-O3 -s -std=c++17 -march=native -ffp-contract=off -fno-exceptions -pthread"
+case $CONFIG in
+	lto|pgo) FLAGS="$FLAGS -flto=auto" ;;
+	trace)   FLAGS="$FLAGS -DATS_RENDER_TRACE" ;;
+	profile) FLAGS="$FLAGS -DATS_PROFILE" ;;
+esac
+
+build() { # target extra-flags
+	case $1 in
+		game)  $CXX main.cpp  -o $OUT/game  $FLAGS $2 -lglfw -lGL ;;
+		sim)   $CXX sim.cpp   -o $OUT/sim   $FLAGS $2 ;;
+		bench) $CXX bench.cpp -o $OUT/bench $FLAGS $2 ;;
+		pack)  $CXX pack.cpp  -o $OUT/pack  $FLAGS $2 ;;
+	esac
+}
+
+mkdir -p $OUT
+
+if [ "$CONFIG" != pgo ]; then
+	for t in $TARGETS; do build $t ""; done
+	exit 0
+fi
+
+PROFILE=$PWD/$OUT/profile
+rm -rf $PROFILE
+mkdir -p $PROFILE
+
+REPLAY=${REPLAY:-../replays/train.rep}
+if [ ! -f "$REPLAY" ]; then
+	echo "no replay at $REPLAY, training on the scripted bot"
+	$CXX sim.cpp -o $OUT/sim $FLAGS
+	REPLAY=$OUT/bot.rep
+	$OUT/sim --bot 3600 --record $REPLAY > /dev/null
+fi
+
+# stage 1: instrumented, the map streamer is a second thread so the counters have to be atomic
+for t in $TARGETS; do build $t "-fprofile-generate=$PROFILE -fprofile-update=prefer-atomic"; done
+
+for t in $TARGETS; do
+	case $t in
+		sim)   $OUT/sim --replay $REPLAY --repeat 3 ;;
+		bench) $OUT/bench --replay $REPLAY --filter sim_replay --out /dev/null ;;
+		game)
+			if [ -n "$DISPLAY" ]; then $OUT/game --replay $REPLAY
+			else echo "no \$DISPLAY, game is built without a profile"; fi ;;
+	esac
+done
+
+# stage 2: code the replay never reached is still optimized normally (partial training)
+for t in $TARGETS; do build $t "-fprofile-use=$PROFILE -fprofile-partial-training -Wno-missing-profile"; done
@@ -3,103 +3,176 @@
 #define ATS_TILEMAP
 #include "ats/ats_tool.h"
 #include "ats/bitmaps.h"
-#include "gameState.h"
+#include "gameWorld.h"
 #include "gameData.h"
 #include "gameObject.h"
 #include "gameItem.h"
 #include "particle.h"
+#include "replay.h"
 
 
+#ifdef ATS_RENDER
 Render_Window Window;
+float cameraFov = 60;	// of the game's view, not the hud's (--fov)
+float lodPixels = 3;	// map columns and particles smaller than that on the screen are drawn flat (--lod, 0 turns it off)
+
+// what is left of a cube so far away that it is only a few pixels big: the face of it that
+// covers the most of the screen. The camera looks along x and down at a flat angle, so that
+// is the front face (p.x == q.x, z from p.z to q.z) of anything with some height, only the
+// floor and the lava are flat (p.z == q.z), a top face. The rising blocks on the right are
+// see-through towers that only look right with all of their faces, they never are flat.
+struct lodQuad{
+	v3 p, q;
+	Color color;
+};
+
+Array<lodQuad> lodQuads;
+#endif
+#ifndef ATS_HEADLESS
 Timer timer;
-float time;
-float delay;
-float mapWarp;
-float speed;
-
-float cameraXpos;
-float cameraYpos;
-float lastCamXpos;
-float lastCamYpos;
-float newCamXpos;
-float newCamYpos;
-float camDelay;
-
-int HIGH_SCORE = 3178705;
+Frame_Pacing pacing = FRAME_PACING_LOW_LATENCY;	// of the window, F7 switches through the modes
+#endif
+gameWorld* world;	// the one the window shows
+Job_Pool mapJobPool;	// mapJobs of world (and of the sim's), created by whoever creates it
+bool quietScores;	// bench and sim runs don't print every restart
+
+#include "snapshot.h"
+#include "rewind.h"
+#ifdef ATS_RENDER
+#include "mapMesh.h"
+#endif
+
+#define quickSavePath "quick.snap"
+bool quickSave;
+bool quickLoad;
+
+#ifdef ATS_PROFILE
+#define profileDefaultPath "profile.json"
+const char* profilePath;	// coreDestroy writes the profile there, F8 any time (profileDefaultPath without one)
+bool profileDump;
+#endif
+
+// a world that starts like the game always did, coreInitState makes it playable
+gameWorld* worldCreate(){
+	gameWorld* w = new gameWorld();
+	w->rnd = default_rnd;	// nothing in the simulation draws from default_rnd, it only seeds new worlds
+	w->fxRnd = rnd_stream(0xf00d);
+	w->HIGH_SCORE = 3178705;
 				//2661082;
 				//10045391;
 				//4113240
 				//930249
-int BEST_SCORE;
-int LAST_SCORE;
-int SCORE;
+	w->streamMap = true;
+	return w;
+}
 
-gameState* STATE;
-gameObject* player;
-Array<gameItem> items;
+void worldDestroy(gameWorld* w){
+	mapStreamStop(w);
+	tilemap_destroy(&w->map);
+	w->gameObjects.destroy();
+	for(int type = 0; type < itemTypes; type++){
+		itemPool* p = &w->itemPools[type];
+		p->x.destroy(); p->y.destroy(); p->vx.destroy(); p->vy.destroy(); p->ax.destroy();
+		p->initVel.destroy(); p->r.destroy(); p->active.destroy(); p->id.destroy(); p->col.destroy();
+		w->itemDeaths[type].destroy();
+	}
+	w->itemHandles.destroy();
+	w->itemSpawns.destroy();
+	w->itemSpawnIds.destroy();
+	w->itemKeep.destroy();
+	w->particles.destroy();
+	w->particleIds.destroy();
+	w->particleHandles.destroy();
+	w->particleSpawns.destroy();
+	w->particleSpawnIds.destroy();
+	w->particleDeaths.destroy();
+	w->particleKeep.destroy();
+	delete w;
+}
 
+// everything the simulation needs, without a window. Can be called again to start over.
+void coreInitState(gameWorld* w){
+	w->delay = 5.0f;
+	w->mapWarp = 0;
+	w->frameTime = 0;
+	w->speed = 0;
+	mapInit(w);
+	w->particles.reserve(2048);
+
+	destroyGameObject(w, w->playerId);
+	w->playerId = createGameObject(w, 5, 20);
+	w->player = getGameObject(w, w->playerId);
+	activate(w->player);
+	w->warp = 0.0f;
+	clearItems(w);
+	restartItems(w);
+	clearParticles(w);
+	w->BEST_SCORE = 0;
+	w->LAST_SCORE = 0;
+	w->SCORE = 0;
+	w->camDelay = 0;
+	w->lastCamXpos = getXpos(w->player);
+	w->lastCamYpos = getYpos(w->player);
+	w->newCamXpos = getXpos(w->player);
+	w->newCamYpos = getYpos(w->player);
+	setState(&w->state, STARTUP);
+}
 
-void coreInit(int w, int h, const char* title){
-	Window = window_create(w, h, title, 1);
-	timer = timer_create();
-	delay = 5.0f;
-	mapWarp = 0;
-	mapInit();
-	particles.reserve(2048);
-
-	//STATE = allocGameState();
-	player = allocGameObject(5, 20);
-	activate(player);
-	BEST_SCORE = 0;
-	LAST_SCORE = 0;
-	SCORE = 0;
-	camDelay = 0;
-	lastCamXpos = getXpos(player);
-	lastCamYpos = getYpos(player);
-	newCamXpos = getXpos(player);
-	newCamYpos = getYpos(player);
-	STATE = allocGameState();
-	setState(STATE, STARTUP);
-
-	render_init();
-}
-
-void restart(){
-	delay = 5.0f;
-	mapWarp = 0;
-	mapInit();
+void restart(gameWorld* w){
+	PROFILE_FUNCTION();
+	gameObject* player = w->player;
+	w->delay = 5.0f;
+	w->mapWarp = 0;
+	mapInit(w);
 	restartGameObject(player);
-	items.clear();
-	restartItems();
-	particles.clear();
-	restartAnimation(0.7, 1);
-	LAST_SCORE = SCORE;
-	if(SCORE > HIGH_SCORE){
-		printf("HIGH ");
-		HIGH_SCORE = SCORE;
+	clearItems(w);
+	restartItems(w);
+	clearParticles(w);
+	restartAnimation(w, 0.7, 1);
+	w->LAST_SCORE = w->SCORE;
+	if(w->SCORE > w->HIGH_SCORE){
+		if(!quietScores)
+			printf("HIGH ");
+		w->HIGH_SCORE = w->SCORE;
 	}
-	if(SCORE > BEST_SCORE){
-		BEST_SCORE = SCORE;
+	if(w->SCORE > w->BEST_SCORE){
+		w->BEST_SCORE = w->SCORE;
 	}
-	printf("SCORE : %d\n", SCORE);
-	SCORE = 0;
-	camDelay = 0;
-	lastCamXpos = getXpos(player);
-	lastCamYpos = getYpos(player);
-	newCamXpos = getXpos(player);
-	newCamYpos = getYpos(player);
-	setState(STATE, STARTUP);
+	if(!quietScores)
+		printf("SCORE : %d\n", w->SCORE);
+	w->SCORE = 0;
+	w->camDelay = 0;
+	w->lastCamXpos = getXpos(player);
+	w->lastCamYpos = getYpos(player);
+	w->newCamXpos = getXpos(player);
+	w->newCamYpos = getYpos(player);
+	setState(&w->state, STARTUP);
 }
 
-int coreIsOpen(){
-	if(window_is_open(Window))
-		return 1;
-	return 0;
+void coreDestroy(){
+	if(world){
+		worldDestroy(world);
+		world = NULL;
+	}
+	job_pool_destroy(&mapJobPool);
+	if(replayRecordPath && !replaySave(replayRecordPath))
+		printf("could not write replay %s\n", replayRecordPath);
+#ifdef ATS_PROFILE
+	if(profilePath && !profile_write(profilePath))
+		printf("could not write profile %s\n", profilePath);
+#endif
+#ifdef ATS_RENDER
+	mapMeshDestroy();
+	lodQuads.destroy();
+	if(Window)
+		window_destroy(Window);
+	Window = NULL;
+#endif
 }
-void coreDestroy(){ window_destroy(Window);}
 
-void cameraPos(){
-	/*camDelay += time;
+void cameraPos(gameWorld* w){
+	gameObject* player = w->player;
+	/*camDelay += frameTime;
 	while(camDelay > 0.05f){
 		camDelay -= 0.05f;
 		lastCamXpos = newCamYpos;
@@ -107,260 +180,490 @@ void cameraPos(){
 		newCamYpos = getYpos(player);
 		newCamXpos = 0;
 	}*/	
-	newCamXpos -= mapWarp;
+	w->newCamXpos -= w->mapWarp;
 
 	//cameraXpos = 0;//getXpos(player) - 10; //lerp(lastCamXpos, newCamXpos, 10*camDelay);
 	//cameraYpos = lerp(lastCamYpos, newCamYpos, 20*camDelay);
 	
-	cameraXpos = lerp(cameraXpos, getXpos(player) - 10, 10.0f * time);
-	cameraYpos = lerp(cameraYpos, getYpos(player), 5.0f * time);
+	w->cameraXpos = lerp(w->cameraXpos, getXpos(player) - 10, 10.0f * w->frameTime);
+	w->cameraYpos = lerp(w->cameraYpos, getYpos(player), 5.0f * w->frameTime);
 }
 
-void stateUpdate(){
+void stateUpdate(gameWorld* w){
+	PROFILE_FUNCTION();
+	gameObject* player = w->player;
 	if(getXpos(player) < 0.7 ||
 		getYpos(player) < 1.7 ||
-		getYpos(player) > 38.3){restart();}
+		getYpos(player) > 38.3){restart(w);}
 	else if(getXpos(player) < 50){
-		speed = 6;
-		if(randf(0.0f, 1.0f) > 0.98)
-			flashRed(30, 0.5f, 0.5f);
+		w->speed = 6;
+		if(randf(&w->rnd, 0.0f, 1.0f) > 0.98)
+			flashRed(w, 30, 0.5f, 0.5f);
 	}
 	else if(getXpos(player) < 50){
-		if(getXpos(player) < 30){speed = 8;}
-		else if(getXpos(player) < 40){speed = 10;}
-		else {speed = 12;}
-		if(randf(0.0f, 1.0f) > 0.98)
-			flashPurple(20, 0.5f, 0.3f);
+		if(getXpos(player) < 30){w->speed = 8;}
+		else if(getXpos(player) < 40){w->speed = 10;}
+		else {w->speed = 12;}
+		if(randf(&w->rnd, 0.0f, 1.0f) > 0.98)
+			flashPurple(w, 20, 0.5f, 0.3f);
 	}
 	else if(getXpos(player) < 120){
-		if(getXpos(player) < 60){speed = 14;}
-		else if(getXpos(player) < 70){speed = 16;}
-		else {speed = 18;}
-		if(randf(0.0f, 1.0f) > 0.98)
-			flashRainbow(20, 0.5f, 0.3f);
-	} else {speed = 100; setAcc(player, -10.0f, getYacc(player)); SCORE += 10000; flashRainbow(50, 0.5f, 0.8f);}
-	SCORE += (int)((time*(float)(speed*speed))*10.0f) + getScore();
-	if(SCORE < 10000)
-		speed *= 0.7f;
-	else if(SCORE < 50000)
-		speed *= 0.9f;
-	else if(SCORE < 100000)
-		speed *= 1.0f;
-	else if(SCORE < 500000)
-		speed *= 1.25f;
-	else if(SCORE < 1000000)
-		speed *= 1.5f;
-	else if(SCORE < 5000000)
-		speed *= 1.65f;
-	else if(SCORE < 10000000)
-		speed *= 1.85f;
+		if(getXpos(player) < 60){w->speed = 14;}
+		else if(getXpos(player) < 70){w->speed = 16;}
+		else {w->speed = 18;}
+		if(randf(&w->rnd, 0.0f, 1.0f) > 0.98)
+			flashRainbow(w, 20, 0.5f, 0.3f);
+	} else {w->speed = 100; setAcc(player, -10.0f, getYacc(player)); w->SCORE += 10000; flashRainbow(w, 50, 0.5f, 0.8f);}
+	w->SCORE += (int)((w->frameTime*(float)(w->speed*w->speed))*10.0f) + getScore(w);
+	if(w->SCORE < 10000)
+		w->speed *= 0.7f;
+	else if(w->SCORE < 50000)
+		w->speed *= 0.9f;
+	else if(w->SCORE < 100000)
+		w->speed *= 1.0f;
+	else if(w->SCORE < 500000)
+		w->speed *= 1.25f;
+	else if(w->SCORE < 1000000)
+		w->speed *= 1.5f;
+	else if(w->SCORE < 5000000)
+		w->speed *= 1.65f;
+	else if(w->SCORE < 10000000)
+		w->speed *= 1.85f;
 	else
-		speed *= 2.0f;
+		w->speed *= 2.0f;
 }
 
-void keyEvents(){
-	if(is_key_pressed(Window, W))
+void applyInput(gameWorld* w, const frameInput* in){
+	gameObject* player = w->player;
+	if(in->held & inputUp)
 		move(player, 100, 0);
-	if(is_key_pressed(Window, S))
+	if(in->held & inputDown)
 		move(player, -100, 0);
-	if(is_key_pressed(Window, A))
+	if(in->held & inputLeft)
 		move(player, 0, 100);
-	if(is_key_pressed(Window, D))
+	if(in->held & inputRight)
 		move(player, 0, -100);
-	if(is_key_pressed(Window, R)){
+	if(in->held & inputReset){
 		setVel(player, 0, 0); 
 		setPos(player, 40, 20);}
-	for(int i = 0; i < key_events.len(); i++){
-		Key_Event* event = key_events.get(i);
+	for(int i = 0; i < in->shots; i++){
+		if(shootClusterGrenade(player))
+			spawnItem(w, createGameItem(getXpos(player), getYpos(player), getXvel(player), 0.25, CLUSTERGRENADE));
+		else if(shootMissile(player))
+			spawnItem(w, createGameItem(getXpos(player), getYpos(player), getXvel(player), 0.25, MISSILE));
+		else if(shootGrenade(player))
+			spawnItem(w, createGameItem(getXpos(player), getYpos(player), getXvel(player), 0.25, GRENADE));
+	}
+}
+
+void mapUpdate(gameWorld* w){
+	PROFILE_FUNCTION();
+	while(w->mapWarp >= 1){
+		w->mapWarp -= 1;
+		updateMap(w);
+	}
+}
+
+void spawnMapItem(gameWorld* w, int x, int y){
+	setBlock(w, x, y, NO_BLOCK);
+	if(randf(&w->rnd, 0.0f, 1.0f) > 0.95 && getState(&w->state) == GAME)// 0.95 <---CHANGE TO!
+		spawnItem(w, randomPowerUp(x, y));
+	else
+		spawnItem(w, randomCollectable(w, x, y));
+}
+
+// ITEM tiles turn into pickups, same order the old renderMap visited them in: row by row, the left
+// xtiles - 40 columns first. Only the columns the map summary has an ITEM in are visited.
+void spawnMapItems(gameWorld* w){
+	int columns[xtiles];
+	int n = 0;
+	for(int x = 0; x < xtiles; x++)
+		if(tilemap_column_kinds(&w->map, x) & tilemap_kind(ITEM))
+			columns[n++] = x;
+	if(!n)
+		return;
+
+	int split = 0;
+	while(split < n && columns[split] < xtiles - 40)
+		split++;
+	for(int y = 1; y < ytiles - 1; y++)
+		for(int i = 0; i < split; i++)
+			if(tileType(w, columns[i], y) == ITEM)
+				spawnMapItem(w, columns[i], y);
+	for(int y = 1; y < ytiles - 1; y++)
+		for(int i = split; i < n; i++)
+			if(tileType(w, columns[i], y) == ITEM)
+				spawnMapItem(w, columns[i], y);
+}
+
+void updatePlayer(gameWorld* w){
+	gameObject* player = w->player;
+	updateObject(w, player, w->frameTime, w->frameTime*w->speed);
+	if(randf(&w->rnd, 0.0f, 1.0f) > 0.6){
+		singleParticle(w, {getXpos(player), getYpos(player)}, 
+						{0, 0}, 
+						{((float)randi(&w->rnd, 0,100)/100.0f-0.5f)*10.0f, ((float)randi(&w->rnd, 0,100)/100.0f-0.5f)*20.0f},
+						randf(&w->rnd, 0.1f, 0.15f), ((float)randi(&w->rnd, 0,100)/100.0f-0.5f)*10.0f,
+						0.2f, 1.0f, 0.0f,
+						255, 0, randi(&w->rnd, 50, 150), 0.3f);
+	}
+	if(randf(&w->rnd, 0.0f, 1.0f) > 0.97){
+		singleParticle(w, {getXpos(player), getYpos(player)}, {0, 0}, 
+						{((float)randi(&w->rnd, 0,100)/100.0f-0.5f)*50.0f, ((float)randi(&w->rnd, 0,100)/100.0f-0.5f)*50.0f},
+						-0.1f, -(float)randi(&w->rnd, 50, 100)/10.0f,
+						1.45f, (float)randi(&w->rnd, 20,70)/100.0f, (float)randi(&w->rnd, 0,30)/100.0f,
+						randi(&w->rnd, 200, 255), 0, randi(&w->rnd, 0, 50), (float)randi(&w->rnd, 20, 40)/100.0f
+						);
+	}
+}
+
+// drops dead items and everything that left the screen, before they get updated
+void cullItems(gameWorld* w){
+	for(int type = 0; type < itemTypes; type++){
+		itemPool* p = &w->itemPools[type];
+		int n = itemPoolLen(p);
+		for(int i = 0; i < n; i++)
+			if(!(p->active[i] &&
+				p->y[i] > -10 && p->y[i] < 50 &&
+				p->x[i] > -10 && p->x[i] < 160))
+				destroyItem(w, type, i);
+	}
+}
+
+void collectItems(gameWorld* w){
+	gameObject* player = w->player;
+	float px = getXpos(player);
+	float py = getYpos(player);
+	for(int type = 0; type < itemTypes; type++){
+		itemPool* p = &w->itemPools[type];
+		int n = itemPoolLen(p);
+		for(int i = 0; i < n; i++){
+			float xdiff = px - p->x[i];
+			float ydiff = py - p->y[i];
+			if(xdiff > -0.3f && xdiff < 1.7f &&
+				ydiff > -0.3f && ydiff < 1.7f){
+				gameItem itm = getItem(w, type, i);
+				collect(w, &itm, player);
+				destroyItem(w, type, i);
+			}
+		}
+	}
+}
+
+void stepItems(gameWorld* w){
+	cullItems(w);
+	commitItems(w);
+	updateItems(w, w->frameTime, w->frameTime*w->speed);
+	collectItems(w);
+	commitItems(w);
+
+	itemPool* missiles = &w->itemPools[MISSILE];
+	for(int i = 0; i < itemPoolLen(missiles); i++)
+		thrust(w, {missiles->x[i]-1.0f, missiles->y[i]}, -0.1f, 10.0f,
+				0.2f, 1.0f, 0.0f);
+}
+
+void stepWorld(gameWorld* w){
+	PROFILE_FUNCTION();
+	spawnMapItems(w);
+	updatePlayer(w);
+	stepItems(w);
+	updateParticles(w, w->frameTime, w->frameTime*w->speed);
+}
+
+// one frame of the game without drawing anything, the same for the game and the headless sim
+void coreStep(gameWorld* w, const frameInput* in){
+	PROFILE_FUNCTION();
+	w->player = getGameObject(w, w->playerId);
+	gameObject* player = w->player;
+	stateUpdate(w);
+	w->frameTime = in->dt;
+	w->mapWarp += w->frameTime*w->speed;
+
+	if(getState(&w->state) == STARTUP){
+		w->delay -= w->frameTime;
+		mapUpdate(w);
+		stepWorld(w);
+
+		if(w->delay <= 5.0f && w->delay > 2.0f){
+			while(w->mapWarp >= 1)
+				w->mapWarp -= 1;
+		}
+		if(w->delay < 2.0f && w->delay > 0.0f) {
+			applyInput(w, in);
+			mapUpdate(w); 
+		}
+		else {setVel(player, 5.0f, 0); setAcc(player, 0.0f, 0);}
+
+		if (w->delay < 0.0f){
+			setState(&w->state, GAME);
+		}
+	}
+	else if(getState(&w->state) == GAME){
+		applyInput(w, in);
+		mapUpdate(w);
+		stepWorld(w);
+	}
+}
+
+#ifndef ATS_HEADLESS
+
+void coreInit(int w, int h, const char* title){
+	PROFILE_THREAD_NAME("main");
+	Window = window_create(w, h, title, 1);
+	window_set_pacing(Window, pacing);
+	timer = timer_create();
+	world = worldCreate();
+	job_pool_create(&mapJobPool, -1);
+	world->mapJobs = &mapJobPool;
+	if(replayPlaying)
+		world->rnd = replayRnd;
+	replayRnd = world->rnd;
+	coreInitState(world);
+	rewindClear();
+}
+
+int coreIsOpen(){
+	if(window_is_open(Window))
+		return 1;
+	return 0;
+}
+
+// polls the window into a frameInput, key events are drained every frame
+frameInput readInput(float dt){
+	PROFILE_FUNCTION();
+	frameInput in = {};
+	in.dt = dt;
+	if(is_key_pressed(Window, W)) in.held |= inputUp;
+	if(is_key_pressed(Window, S)) in.held |= inputDown;
+	if(is_key_pressed(Window, A)) in.held |= inputLeft;
+	if(is_key_pressed(Window, D)) in.held |= inputRight;
+	if(is_key_pressed(Window, R)) in.held |= inputReset;
+	Key_Event e;
+	while(window_poll_key_event(&e)){
+		Key_Event* event = &e;
 		/*if(is_key_event(event, W, PRESS)){
 			flipGravity(player);
 			itemFlipGravity();
 		}*/
-		if(is_key_event(event, SPACE, PRESS)){
-			if(shootClusterGrenade(player))
-				items.add(createGameItem(getXpos(player), getYpos(player), getXvel(player), 0.25, CLUSTERGRENADE));
-			else if(shootMissile(player))
-				items.add(createGameItem(getXpos(player), getYpos(player), getXvel(player), 0.25, MISSILE));
-			else if(shootGrenade(player))
-				items.add(createGameItem(getXpos(player), getYpos(player), getXvel(player), 0.25, GRENADE));
+		if(is_key_event(event, SPACE, PRESS) && in.shots < 255)
+			in.shots++;
+		if(is_key_event(event, F5, PRESS))
+			quickSave = true;
+		if(is_key_event(event, F9, PRESS))
+			quickLoad = true;
+		if(is_key_event(event, F6, PRESS)){
+			mapMeshed = !mapMeshed;
+			printf("map mesh: %s\n", mapMeshed ? "on" : "off");
 		}
+		if(is_key_event(event, F7, PRESS)){
+			pacing = (Frame_Pacing)((pacing + 1) % FRAME_PACING_COUNT);
+			window_set_pacing(Window, pacing);
+			printf("frame pacing: %s\n", frame_pacing_names[pacing]);
+		}
+#ifdef ATS_PROFILE
+		if(is_key_event(event, F8, PRESS))
+			profileDump = true;
+#endif
+	}
+	return in;
+}
+
+#endif
+
+// drawing only needs a render api, the sim has one with ATS_SOFTWARE_RENDER
+#ifdef ATS_RENDER
+
+// the cubes that always have the same shape, relative to where they are drawn (see CUBE PREFAB in ats_tool.h)
+constexpr Cube_Prefab floorPrefab = cube_prefab(0.1f, 0.1f, 0.9f, 0.9f, 0.0f, -0.05f);
+constexpr Cube_Prefab lavaPrefab = cube_prefab(0.0f, 0.0f, 1.0f, 1.0f, 0.5f, 0.0f);
+constexpr Cube_Prefab shipPrefabs[3] = {
+	cube_prefab(-0.3f, -0.55f, 0.3f, -0.3f, 0.4f, 0.2f),
+	cube_prefab(-0.55f, -0.3f, 0.55f, 0.3f, 0.6f, 0.2f),
+	cube_prefab(-0.3f, 0.3f, 0.3f, 0.55f, 0.4f, 0.2f),
+};
+
+// after all the cubes, so the cube batch isn't flushed for every quad
+void lodDrawQuads(){
+	for(int i = 0; i < lodQuads.len(); i++){
+		lodQuad* l = &lodQuads[i];
+		v3 p = l->p, q = l->q;
+		Color c = l->color;
+		if(p.z == q.z)
+			render_rectangle(p.x, p.y, q.x, q.y, p.z, c.r, c.g, c.b, c.a);
+		else{
+			render_triangle(p.x, p.y, p.z, p.x, q.y, p.z, p.x, q.y, q.z, c.r, c.g, c.b, c.a);
+			render_triangle(p.x, p.y, p.z, p.x, q.y, q.z, p.x, p.y, q.z, c.r, c.g, c.b, c.a);
+		}
+	}
+	lodQuads.clear();
+}
+
+// a column is flat when a tile at its nearest corner (the lava outside of the map
+// included) is smaller than lodPixels on the screen
+void lodFlatColumns(gameWorld* w, bool* flat){
+	for(int x = 0; x < xtiles; x++){
+		float cx = x + 0.5f - w->mapWarp;
+		float size = 0;
+		for(int corner = 0; corner < 4; corner++)
+			size = MAX(size, render_pixel_size({cx, corner & 1 ? ytiles + 19.0f : -19.0f, corner & 2 ? 2.0f : 0.0f}, 1.0f));
+		flat[x] = size < lodPixels;
 	}
 }
 
-void mapUpdate(){
-	while(mapWarp >= 1){
-		mapWarp -= 1;
-		updateMap();
+Color mapFloorColor(int x){
+	if(x < 10)
+		return {255, 0, 0, 80};
+	if(x < 30){
+		r32 rfade = 255.0f-105.0f*((x-10.0f)/20.0f);
+		r32 bfade = 60.0f+195.0f*((x-10.0f)/20.0f);
+		r32 afade = 80.0f-40.0f*((x-10.0f)/20.0f);
+		return {(u8)rfade, 0, (u8)bfade, (u8)afade};
 	}
+	return {150, 0, 255, 40};
 }
 
-void renderMap(){
+// the floor of a flat column, one strip for every run of tiles without a block
+void lodFloorStrips(gameWorld* w, int x){
+	int y = 1;
+	while(y < ytiles - 1){
+		if(tileType(w, x, y) == BLOCK){
+			y++;
+			continue;
+		}
+		int from = y;
+		while(y < ytiles - 1 && tileType(w, x, y) != BLOCK)
+			y++;
+		lodQuads.add({{x+0.1f-w->mapWarp, from+0.1f, 0.0f}, {x+0.9f-w->mapWarp, y-0.1f, 0.0f}, mapFloorColor(x)});
+	}
+}
+
+void drawMap(gameWorld* w){
+	PROFILE_FUNCTION();
+	gameObject* player = w->player;
+	// with mapMeshed the blocks of the whole chunks in between come from drawMapMesh
+	int meshFrom = 0, meshTo = 0;
+	if(mapMeshed){
+		meshFrom = (meshChunkColumns - w->counter % meshChunkColumns) % meshChunkColumns;
+		meshTo = meshFrom + (xtiles - 40 - meshFrom) / meshChunkColumns * meshChunkColumns;
+	}
+	// the lava of flat columns still draws from fxRnd, so the rest looks the same with and without LOD
+	bool flat[xtiles];
+	lodFlatColumns(w, flat);
 	for(int y = 1; y < ytiles - 1; y++){
 		for(int x = 0; x < xtiles - 40; x++){
-			if(tileType(x, y) == BLOCK){
-				render_cube	(x+0.05-mapWarp, y+0.05, 
-							x+0.95-mapWarp, y+0.95, 
-							getNoise(x, y)*0.9f+1.0f, 0.0, 
-							120, 50, 210, 255-100*(abs(x-getXpos(player))/100.0));
+			if(tileType(w, x, y) == BLOCK){
+				if(x >= meshFrom && x < meshTo)
+					continue;
+				if(flat[x])
+					lodQuads.add({{(float)(x+0.05-w->mapWarp), y+0.05f, 0.0f}, {(float)(x+0.05-w->mapWarp), y+0.95f, getNoise(w, x, y)*0.9f+1.0f},
+								{120, 50, 210, (u8)(255-100*(abs(x-getXpos(player))/100.0))}});
+				else
+					render_cube	(x+0.05-w->mapWarp, y+0.05, 
+								x+0.95-w->mapWarp, y+0.95, 
+								getNoise(w, x, y)*0.9f+1.0f, 0.0, 
+								120, 50, 210, 255-100*(abs(x-getXpos(player))/100.0));
 			} 
-			else {
-				if(x < 10){
-					render_cube(x+0.1-mapWarp, y+0.1, 
-								x+0.9-mapWarp, y+0.9, 0.0, -0.05, 
-								255, 0, 0, 80);
-				}
-				else if(x < 30){
-					r32 rfade = 255.0f-105.0f*((x-10.0f)/20.0f);
-					r32 bfade = 60.0f+195.0f*((x-10.0f)/20.0f);
-					r32 afade = 80.0f-40.0f*((x-10.0f)/20.0f);
-					render_cube(x+0.1-mapWarp, y+0.1, 
-								x+0.9-mapWarp, y+0.9, 0.0, -0.05, 
-								rfade, 0, bfade, afade);
-				}
-				else{
-					render_cube(x+0.1-mapWarp, y+0.1, 
-									x+0.9-mapWarp, y+0.9, 0.0, -0.05, 
-									150, 0, 255, 40);
-					}
-				if(tileType(x, y) == ITEM){
-					setBlock(x, y, NO_BLOCK);
-					if(randf(0.0f, 1.0f) > 0.95 && getState(STATE) == GAME)// 0.95 <---CHANGE TO!
-						items.add(randomPowerUp(x, y));
-					else
-						items.add(randomCollectable(x, y));
-				}
+			else if(!flat[x]){
+				Color c = mapFloorColor(x);
+				render_cube_prefab(&floorPrefab, x-w->mapWarp, y, c.r, c.g, c.b, c.a);
 			}
 		}
 	}
 	for(int y = 1; y < ytiles - 1; y++){
 		for(int x = xtiles - 40; x < xtiles; x++){
-			if(tileType(x, y) == BLOCK){
-				render_cube	(x+0.05-mapWarp, y+0.05, 
-							x+0.95-mapWarp, y+0.95, 
-							getNoise(x, y)*0.9f + randf(0.25f, 0.35f)*(x - (xtiles - 39)) + 1.0, randf(0.05f, 0.2f)*(x - (xtiles - 39)), 
+			if(tileType(w, x, y) == BLOCK){
+				render_cube	(x+0.05-w->mapWarp, y+0.05, 
+							x+0.95-w->mapWarp, y+0.95, 
+							getNoise(w, x, y)*0.9f + randf(&w->fxRnd, 0.25f, 0.35f)*(x - (xtiles - 39)) + 1.0, randf(&w->fxRnd, 0.05f, 0.2f)*(x - (xtiles - 39)), 
 							50, 50, 100, 255-100*(abs(x-getXpos(player))/100.0));
 			} 
 			else{
-				render_cube(x+0.1-mapWarp, y+0.1, 
-							x+0.9-mapWarp, y+0.9, 0.2*(x - (xtiles - 39)), -0.05, 
+				render_cube(x+0.1-w->mapWarp, y+0.1, 
+							x+0.9-w->mapWarp, y+0.9, 0.2*(x - (xtiles - 39)), -0.05, 
 							50, 50, 255, 50);
 			}
-			if(tileType(x, y) == ITEM){
-					setBlock(x, y, NO_BLOCK);
-					if(randf(0.0f, 1.0f) > 0.95 && getState(STATE) == GAME)// 0.95 <---CHANGE TO!
-						items.add(randomPowerUp(x, y));
-					else
-						items.add(randomCollectable(x, y));
-				}
 		}
 	}
 	for(int x = 0; x < 160; x++){
 		for(int y = 0; y < 20; y++){
-			float a = (randf(150.0f, 190.0f)*((20.0f-y)/20.0f));
-			render_cube(x-mapWarp, 0-y, 
-						x+1-mapWarp, 1-y, 0.5, 0, 
-						randi(205, 255), randi(0, 20), randi(10, 50), a);
-			render_cube(x-mapWarp, 39+y, 
-						x+1-mapWarp, 40+y, 0.5, 0, 
-						randi(205, 255), randi(0, 20), randi(10, 50), a);		
+			float a = (randf(&w->fxRnd, 150.0f, 190.0f)*((20.0f-y)/20.0f));
+			if(flat[x]){
+				Color top = {(u8)randi(&w->fxRnd, 205, 255), (u8)randi(&w->fxRnd, 0, 20), (u8)randi(&w->fxRnd, 10, 50), (u8)a};
+				Color bot = {(u8)randi(&w->fxRnd, 205, 255), (u8)randi(&w->fxRnd, 0, 20), (u8)randi(&w->fxRnd, 10, 50), (u8)a};
+				lodQuads.add({{x-w->mapWarp, 0.0f-y, 0.5f}, {x+1-w->mapWarp, 1.0f-y, 0.5f}, top});
+				lodQuads.add({{x-w->mapWarp, 39.0f+y, 0.5f}, {x+1-w->mapWarp, 40.0f+y, 0.5f}, bot});
+				continue;
+			}
+			render_cube_prefab(&lavaPrefab, x-w->mapWarp, 0-y, 
+						randi(&w->fxRnd, 205, 255), randi(&w->fxRnd, 0, 20), randi(&w->fxRnd, 10, 50), a);
+			render_cube_prefab(&lavaPrefab, x-w->mapWarp, 39+y, 
+						randi(&w->fxRnd, 205, 255), randi(&w->fxRnd, 0, 20), randi(&w->fxRnd, 10, 50), a);
 		}
 	}
+	for(int x = 0; x < xtiles - 40; x++)
+		if(flat[x])
+			lodFloorStrips(w, x);
+	lodDrawQuads();
+	if(meshTo > meshFrom)
+		drawMapMesh(w, meshFrom, meshTo);
 }
 
-void renderPlayer(){	
-	updateObject(player, time, time*speed);
-	render_cube(getXpos(player)-0.3, getYpos(player)-0.55, 
-					getXpos(player)+0.3, getYpos(player)-0.3, 0.4, 0.2, 
-					255, 0, 200, 255);
-	render_cube(getXpos(player)-0.55, getYpos(player)-0.3, 
-					getXpos(player)+0.55, getYpos(player)+0.3, 0.6, 0.2, 
-					255, 0, 200, 255);
-	render_cube(getXpos(player)-0.3, getYpos(player)+0.3, 
-					getXpos(player)+0.3, getYpos(player)+0.55, 0.4, 0.2, 
-					255, 0, 200, 255);
-	if(randf(0.0f, 1.0f) > 0.6){
-		singleParticle({getXpos(player), getYpos(player)}, 
-						{0, 0}, 
-						{((float)randi(0,100)/100.0f-0.5f)*10.0f, ((float)randi(0,100)/100.0f-0.5f)*20.0f},
-						randf(0.1f, 0.15f), ((float)randi(0,100)/100.0f-0.5f)*10.0f,
-						0.2f, 1.0f, 0.0f,
-						255, 0, randi(50, 150), 0.3f);
-	}
-	if(randf(0.0f, 1.0f) > 0.97){
-		singleParticle({getXpos(player), getYpos(player)}, {0, 0}, 
-						{((float)randi(0,100)/100.0f-0.5f)*50.0f, ((float)randi(0,100)/100.0f-0.5f)*50.0f},
-						-0.1f, -(float)randi(50, 100)/10.0f,
-						1.45f, (float)randi(20,70)/100.0f, (float)randi(0,30)/100.0f,
-						randi(200, 255), 0, randi(0, 50), (float)randi(20, 40)/100.0f
-						);
-	}
+void drawPlayer(gameWorld* w){
+	PROFILE_FUNCTION();
+	gameObject* player = w->player;
+	for(int i = 0; i < 3; i++)
+		render_cube_prefab(&shipPrefabs[i], getXpos(player), getYpos(player), 255, 0, 200, 255);
 }
 
-void renderItems(){
-	for(int i = 0; i < items.len(); i++){
-		gameItem* itm = items.get(i);
-		if(itemIsActive(itm) && 
-			itemYPos(itm) > -10 &&
-			itemYPos(itm) < 50 &&
-			itemXPos(itm) > -10 &&
-			itemXPos(itm) < 160){
-			updateGameItem(itm, time, time*speed, &items);
-
-			float xdiff = getXpos(player) - itemXPos(itm);
-			float ydiff = getYpos(player) - itemYPos(itm);
-			if(xdiff > -0.3 && xdiff < 1.7 &&
-				ydiff > -0.3 && ydiff < 1.7){
-				collect(itm, player);
-				items.rem(i); i--;
-			}
-			else if(itemType(itm) == GRENADE){
-				render_cube(itemXPos(itm)-0.25, itemYPos(itm)-0.25,
-								itemXPos(itm)+0.25, itemYPos(itm)+0.25, 0.6, 0.3,
-								255, 255, 100, 255);
-			}
-			else if(itemType(itm) == GRENADEPACK){
-				render_cube(itemXPos(itm)+0.25, itemYPos(itm)+0.25,
-								itemXPos(itm)+0.75, itemYPos(itm)+0.75, 0.6, 0.3,
-								255, 255, 100, 255);
-			}
-			else if(itemType(itm) == CLUSTERGRENADE ||
-					itemType(itm) == CLUSTERCHILD){
-				render_cube(itemXPos(itm)-0.25, itemYPos(itm)-0.25,
-								itemXPos(itm)+0.25, itemYPos(itm)+0.25, 0.6, 0.3,
-								100, 255, 0, 255);
-			}
-			else if(itemType(itm) == CLUSTERGRENADEPACK){
-				render_cube(itemXPos(itm)+0.25, itemYPos(itm)+0.25,
-								itemXPos(itm)+0.75, itemYPos(itm)+0.75, 0.6, 0.3,
-								100, 255, 0, 255);
-			}
-			else if(itemType(itm) == MISSILE){
-				render_cube(itemXPos(itm)-1.0, itemYPos(itm)-0.15,
-								itemXPos(itm)+0.25, itemYPos(itm)+0.15, 0.6, 0.3,
-								255, 0, 0, 255);
-				thrust({itemXPos(itm)-1.0f, itemYPos(itm)}, -0.1f, 10.0f,
-						0.2f, 1.0f, 0.0f);
-			}
-			else if(itemType(itm) == MISSILEPACK){
-				render_cube(itemXPos(itm)+0.25, itemYPos(itm)+0.25,
-								itemXPos(itm)+0.75, itemYPos(itm)+0.75, 0.6, 0.3,
-								255, 0, 0, 255);
-			}
-			else if(itemType(itm) == STAR){
-				render_cube(itemXPos(itm)+0.35, itemYPos(itm)+0.35,
-								itemXPos(itm)+0.65, itemYPos(itm)+0.65, 0.6, 0.3,
-								255, 255, 255, 100);
-			}
-		}
-		else {items.rem(i); i--;}
+struct itemLook{
+	Cube_Prefab cube;
+	u8 r, g, b, a;
+};
+
+// cube of every item type, relative to the item position
+constexpr itemLook itemLooks[itemTypes] = {
+	/* STAR               */ {cube_prefab( 0.35f,  0.35f, 0.65f, 0.65f, 0.6f, 0.3f), 255, 255, 255, 100},
+	/* GRENADE            */ {cube_prefab(-0.25f, -0.25f, 0.25f, 0.25f, 0.6f, 0.3f), 255, 255, 100, 255},
+	/* GRENADEPACK        */ {cube_prefab( 0.25f,  0.25f, 0.75f, 0.75f, 0.6f, 0.3f), 255, 255, 100, 255},
+	/* CLUSTERGRENADE     */ {cube_prefab(-0.25f, -0.25f, 0.25f, 0.25f, 0.6f, 0.3f), 100, 255,   0, 255},
+	/* CLUSTERCHILD       */ {cube_prefab(-0.25f, -0.25f, 0.25f, 0.25f, 0.6f, 0.3f), 100, 255,   0, 255},
+	/* CLUSTERGRENADEPACK */ {cube_prefab( 0.25f,  0.25f, 0.75f, 0.75f, 0.6f, 0.3f), 100, 255,   0, 255},
+	/* MISSILE            */ {cube_prefab(-1.0f,  -0.15f, 0.25f, 0.15f, 0.6f, 0.3f), 255,   0,   0, 255},
+	/* MISSILEPACK        */ {cube_prefab( 0.25f,  0.25f, 0.75f, 0.75f, 0.6f, 0.3f), 255,   0,   0, 255},
+};
+
+void drawItemPool(gameWorld* w, int type){
+	itemPool* p = &w->itemPools[type];
+	const itemLook* look = &itemLooks[type];
+	int n = itemPoolLen(p);
+	for(int i = 0; i < n; i++){
+		render_cube_prefab(&look->cube, p->x[i], p->y[i], look->r, look->g, look->b, look->a);
 	}
 }
 
-void renderParticles(){
-	updateParticles(time, time*speed);
-	for(int i = 0; i < particles.len(); i++){
-		particle* par = particles.get(i);
+void drawItems(gameWorld* w){
+	PROFILE_FUNCTION();
+	for(int type = 0; type < itemTypes; type++)
+		drawItemPool(w, type);
+}
+
+// particles smaller than lodPixels are only their front face, the ones that can't even cover
+// a quarter of that (hardly ever the center of a pixel) aren't drawn at all
+void drawParticles(gameWorld* w){
+	PROFILE_FUNCTION();
+	for(int i = 0; i < w->particles.len(); i++){
+		particle* par = w->particles.get(i);
 		if(!particleDelay(par)){
+			float size = render_pixel_size({particleXPos(par), particleYPos(par), particleZPos(par)}, 2*particleR(par));
+			if(size < lodPixels*0.25f)
+				continue;
+			if(size < lodPixels){
+				lodQuads.add({{particleXPos(par)-particleR(par), particleYPos(par)-particleR(par), particleZPos(par)},
+							{particleXPos(par)-particleR(par), particleYPos(par)+particleR(par), particleZPos(par) + 0.25f},
+							{(u8)particleRed(par), (u8)particleGreen(par), (u8)particleBlue(par), (u8)(int)(255.0f*particleAlpha(par))}});
+				continue;
+			}
 			render_cube(particleXPos(par)-particleR(par), particleYPos(par)-particleR(par),
 							particleXPos(par)+particleR(par), particleYPos(par)+particleR(par), 
 							particleZPos(par) + 0.25f, particleZPos(par),
@@ -368,98 +671,135 @@ void renderParticles(){
 							(int)(255.0f*particleAlpha(par)));
 		}
 	}
+	lodDrawQuads();
 }
 
-void renderText(){
-	char buffer [50];
-	sprintf(buffer, "SCORE : %d LAST : %d BEST : %d", SCORE, LAST_SCORE, BEST_SCORE);
-	render_string(buffer, 5, 41, 1, 0.15f, -0.15f, {255, 255, 255, 255});
-	sprintf(buffer, "%d", grenadesLeft(player));
-	render_string(buffer, 60, 41, 1, 0.15f, -0.15f, {255, 255, 100, 255});
-	sprintf(buffer, "%d", missilesLeft(player));
-	render_string(buffer, 65, 41, 1, 0.15f, -0.15f, {255, 0, 0, 255});
-	sprintf(buffer, "%d", clusterGrenadesLeft(player));
-	render_string(buffer, 70, 41, 1, 0.15f, -0.15f, {100, 255, 0, 255});
-
-	glDisable(GL_DEPTH_TEST);
+Text_Widget hudScoreLabel;
+Text_Widget hudScore;
+Text_Widget hudLastLabel;
+Text_Widget hudLast;
+Text_Widget hudBestLabel;
+Text_Widget hudBest;
+Text_Widget hudGrenades;
+Text_Widget hudMissiles;
+Text_Widget hudClusters;
+
+void renderText(gameWorld* w){
+	PROFILE_FUNCTION();
+	gameObject* player = w->player;
+	// same layout as "SCORE : %d LAST : %d BEST : %d", but only changed parts get rebuilt
+	Color white = {255, 255, 255, 255};
+	float x = 5;
+	x += render_text_widget(&hudScoreLabel, "SCORE : ", x, 41, 1, 0.15f, -0.15f, white);
+	x += render_i32_widget(&hudScore, w->SCORE, x, 41, 1, 0.15f, -0.15f, white);
+	x += render_text_widget(&hudLastLabel, " LAST : ", x, 41, 1, 0.15f, -0.15f, white);
+	x += render_i32_widget(&hudLast, w->LAST_SCORE, x, 41, 1, 0.15f, -0.15f, white);
+	x += render_text_widget(&hudBestLabel, " BEST : ", x, 41, 1, 0.15f, -0.15f, white);
+	x += render_i32_widget(&hudBest, w->BEST_SCORE, x, 41, 1, 0.15f, -0.15f, white);
+
+	render_i32_widget(&hudGrenades, grenadesLeft(player), 60, 41, 1, 0.15f, -0.15f, {255, 255, 100, 255});
+	render_i32_widget(&hudMissiles, missilesLeft(player), 65, 41, 1, 0.15f, -0.15f, {255, 0, 0, 255});
+	render_i32_widget(&hudClusters, clusterGrenadesLeft(player), 70, 41, 1, 0.15f, -0.15f, {100, 255, 0, 255});
+
+	render_set_depth_test(false);
 	render_rectangle(3.0f, 39.0f, 75.0f, 42.0f, 0.9f, 0, 0, 0, 150);
 	bitmaps_render();
-	glEnable(GL_DEPTH_TEST);
+	render_set_depth_test(true);
 }
 
-void coreUpdateAndRender(){
-	stateUpdate();
-	time = timer_restart(&timer);
-	mapWarp += time*speed;
-
-	cameraPos();
+void coreRender(gameWorld* w){
+	PROFILE_FUNCTION();
+	gameObject* player = w->player;
+	cameraPos(w);
 	
 	window_update_view(Window, 
-						cameraXpos, cameraYpos, 4,
+						w->cameraXpos, w->cameraYpos, 4,
 						getXpos(player), getYpos(player), 0,
 						0, 0, 1,
-						60, 1, 300
+						cameraFov, 1, 300
 						);
 	
 	window_clear(Window);
 
-	if(getState(STATE) == STARTUP){
-		delay -= time;
-		mapUpdate();
-		renderMap();
-		renderPlayer();
-		renderItems();
-		renderParticles();
-
-		window_update_view(Window, 
-						40, 20, 45,
-						40, 20, 0,
-						0, 1, 0,
-						60, 1, 300
-						);
+	RENDER_TRACE_PHASE("map");
+	drawMap(w);
+	RENDER_TRACE_PHASE("player");
+	drawPlayer(w);
+	RENDER_TRACE_PHASE("items");
+	drawItems(w);
+	RENDER_TRACE_PHASE("particles");
+	drawParticles(w);
 
-		if(delay <= 5.0f && delay > 2.0f){
+	RENDER_TRACE_PHASE("hud");
+	window_update_view(Window, 
+					40, 20, 45,
+					40, 20, 0,
+					0, 1, 0,
+					60, 1, 300
+					);
+
+	if(getState(&w->state) == STARTUP){
+		if(w->delay <= 5.0f && w->delay > 2.0f){
 			char buffer [50];
-			sprintf(buffer, "READY IN %d", ((int)delay)-1);
-			glPushMatrix();
-			glRotatef(0, 0, 1, PI/2);
+			sprintf(buffer, "READY IN %d", ((int)w->delay)-1);
 			render_string(buffer, 34, 23, 35, 0.15f, -0.15f, {255, 255, 255, 255});
-			glPopMatrix();
-			while(mapWarp >= 1)
-				mapWarp -= 1;
 		}
-		if(delay < 2.0f && delay > 0.0f) {
-			keyEvents();
-			mapUpdate(); 
-			Color c = color_lerp({255, 255, 255, 255}, {120, 50, 210, 100}, 1.0f - delay/2.0f);
+		if(w->delay < 2.0f && w->delay > 0.0f) {
+			Color c = color_lerp({255, 255, 255, 255}, {120, 50, 210, 100}, 1.0f - w->delay/2.0f);
 			render_string("GO!", 38, 22, 35, 0.2f, -0.2f, {c.r, c.g, c.b, c.a});
 		}
-		else {setVel(player, 5.0f, 0); setAcc(player, 0.0f, 0);}
-
-		renderText();
-		if (delay < 0.0f){
-			setState(STATE, GAME);
-		}
 	}
-	else if(getState(STATE) == GAME){
-		keyEvents();
-		mapUpdate();
-		renderMap();
-		renderPlayer();
-		renderItems();
-		renderParticles();
-
-		window_update_view(Window, 
-						40, 20, 45,
-						40, 20, 0,
-						0, 1, 0,
-						60, 1, 300
-						);
 
-		renderText();
+	renderText(w);
+}
+
+#endif
+
+#ifndef ATS_HEADLESS
+
+void coreUpdateAndRender(){
+	PROFILE_FUNCTION();
+	window_begin_frame(Window);
+	float dt = timer_restart(&timer);
+	frameInput in = readInput(dt);
+	if(replayPlaying && !replayNext(&in)){
+		replayPlaying = false;
+		window_close(Window);
+		return;
 	}
-	if(is_key_pressed(Window, ESCAPE)){restart(); window_close(Window); printf("BEST SCORE : %d\n", BEST_SCORE);}
+	if(replayRecordPath)
+		replayRecord(&in);
+
+	// F5 saves, F9 loads. No loading while a replay records or plays, the state would not match its input
+	if(quickSave && !snapshotSave(world, quickSavePath))
+		printf("could not write %s\n", quickSavePath);
+	if(quickLoad && !replayRecordPath && !replayPlaying && !snapshotLoad(world, quickSavePath))
+		printf("could not load %s\n", quickSavePath);
+	quickSave = false;
+	quickLoad = false;
+#ifdef ATS_PROFILE
+	if(profileDump){
+		const char* path = profilePath ? profilePath : profileDefaultPath;
+		if(profile_write(path))
+			printf("profile written to %s\n", path);
+		else
+			printf("could not write %s\n", path);
+		profileDump = false;
+	}
+#endif
+
+	// hold BACKSPACE to step back a tick per frame, the game goes on from where it is let go
+	if(is_key_pressed(Window, BACKSPACE) && !replayRecordPath && !replayPlaying)
+		rewindStepBack(world);
+	else{
+		coreStep(world, &in);
+		rewindRecord(world);
+	}
+	coreRender(world);
+
+	if(is_key_pressed(Window, ESCAPE)){restart(world); window_close(Window); printf("BEST SCORE : %d\n", world->BEST_SCORE);}
 	window_update(Window);
 }
 
-#endif
\ No newline at end of file
+#endif
+#endif
@@ -5,201 +5,336 @@
 
 //==========================GAME DATA=======================//
 
-#define xtiles 		160
-#define ytiles 		40
-#define NO_BLOCK	0
-#define BLOCK 		1
-#define LAVA		2
-#define ITEM		3
-
-
-int counter;
-int score;
-
-Tilemap map;
+void mapStreamStart(gameWorld* w, int column);
+void columnNoise(int column, float* out);
+
+#define mapJobColumns	16	// columns a job of mapColumnsFor takes at once
+
+// fn(x) for every x in [0, count) on w->mapJobs. Every column only writes its own
+// tiles and noise and only rolls its own rng stream, so the map comes out the same
+// for any number of threads. Only from the thread that steps the world!
+template <typename F>
+void mapColumnsFor(gameWorld* w, int count, F&& fn){
+	if(w->mapJobs)
+		job_pool_for(w->mapJobs, count, mapJobColumns, fn);
+	else
+		for(int x = 0; x < count; x++)
+			fn(x);
+}
 
-void mapInit(){
-	tilemap_init(&map, xtiles, ytiles);
+// mapNoise only depends on counter
+void mapRebuildNoise(gameWorld* w){
+	mapColumnsFor(w, xtiles, [w](i64 x){ columnNoise(w->counter + x, w->mapNoise[x]); });
+}
 
-	//CLEAR MAP
-	for(int y = 1; y < ytiles-1; y++){
-		for(int x = 0; x < xtiles; x++)
-			if(x > 20 && randf(0.0f, 1.0f) > 0.975) {map.set(x, y, ITEM);}
-			else {map.set(x, y, NO_BLOCK);}
+// mapNoise was built for counter == from: columns still on the map are moved, only new ones computed
+void mapMoveNoise(gameWorld* w, int from){
+	int d = w->counter - from;
+	if(d >= xtiles || d <= -xtiles)
+		mapRebuildNoise(w);
+	else if(d > 0){
+		memmove(w->mapNoise[0], w->mapNoise[d], sizeof(w->mapNoise[0]) * (xtiles-d));
+		mapColumnsFor(w, d, [w, d](i64 i){ columnNoise(w->counter + xtiles-d + i, w->mapNoise[xtiles-d + i]); });
 	}
-
-	for(int x = 0; x < xtiles; x++){
-		map.set(x, 1, BLOCK);
-		map.set(x, ytiles - 2, BLOCK);
-		map.set(x, 0, LAVA);
-		map.set(x, ytiles - 1, LAVA);
+	else if(d < 0){
+		memmove(w->mapNoise[-d], w->mapNoise[0], sizeof(w->mapNoise[0]) * (xtiles+d));
+		mapColumnsFor(w, -d, [w](i64 x){ columnNoise(w->counter + x, w->mapNoise[x]); });
 	}
+}
+
+// column x of a new map: lava and a wall at the top and the bottom, in between nothing
+// but a few items. Those are rolled from a stream of the column's own, apart from the
+// one generateColumn rolls the same column of the world with.
+void mapInitColumn(gameWorld* w, int x){
+	Rnd_Gen rnd = rnd_stream((u32)(w->counter + x) ^ 0x80000000u);
+	u32* tiles = w->map.tiles.ptr();
+	tiles[x] = LAVA;
+	tiles[xtiles + x] = BLOCK;
+	for(int y = 2; y < ytiles-2; y++)
+		tiles[y*xtiles + x] = x > 20 && randf(&rnd, 0.0f, 1.0f) > 0.975 ? ITEM : NO_BLOCK;
+	tiles[(ytiles-2)*xtiles + x] = BLOCK;
+	tiles[(ytiles-1)*xtiles + x] = LAVA;
+	columnNoise(w->counter + x, w->mapNoise[x]);
+}
 
-	counter = randi(0, 100000);
-	score = 0;
+// the columns write the tiles without Tilemap::set, the summary is built once after all of them
+void mapInit(gameWorld* w){
+	PROFILE_FUNCTION();
+	tilemap_init(&w->map, xtiles, ytiles);
+	w->counter = randi(&w->rnd, 0, 100000);
+	w->score = 0;
+	mapColumnsFor(w, xtiles, [w](i64 x){ mapInitColumn(w, (int)x); });
+	tilemap_rebuild_summary(&w->map);
+	mapStreamStart(w, w->counter + 1);
 }
 
-int tileType(int x, int y){
-	return map.get(x, y);
+int tileType(gameWorld* w, int x, int y){
+	return w->map.get(x, y);
 }
 
-void setBlock(int x, int y, int type){
-	map.set(x, y, type);
+void setBlock(gameWorld* w, int x, int y, int type){
+	w->map.set(x, y, type);
 }
 
-int getScore(){
-	int temp = score;
-	score = 0;
+int getScore(gameWorld* w){
+	int temp = w->score;
+	w->score = 0;
 	return temp;
 }
 
-void deleteBlock(int x, int y){
+void deleteBlock(gameWorld* w, int x, int y){
 	if(x >= 0 && x < xtiles - 1 &&
 		y >= 1 && y < ytiles - 1){
-		if(map.get(x, y) == BLOCK){
-			splitBlock(x, y);
-			map.set(x, y, NO_BLOCK);
-			score += 100;
+		if(w->map.get(x, y) == BLOCK){
+			splitBlock(w, x, y);
+			w->map.set(x, y, NO_BLOCK);
+			w->score += 100;
 		}
-		if(randf(0.0f, 1.0f) > 0.8){
-			singleParticle(
+		if(randf(&w->rnd, 0.0f, 1.0f) > 0.8){
+			singleParticle(w,
 					{(float)x+0.5f, (float)y+0.5f}, {0, 0}, 
-					{randf(-15.0f, 15.0f), randf(-15.0f, 15.0f)},
-					-0.1f, randf(-10.0f, -5.0f),
-					2.45f, randf(0.0f, 1.0f), randf(0.0f, 0.5f),
-					randi(200, 255), 0, randi(0, 50), randf(0.1f, 0.3f)
+					{randf(&w->rnd, -15.0f, 15.0f), randf(&w->rnd, -15.0f, 15.0f)},
+					-0.1f, randf(&w->rnd, -10.0f, -5.0f),
+					2.45f, randf(&w->rnd, 0.0f, 1.0f), randf(&w->rnd, 0.0f, 0.5f),
+					randi(&w->rnd, 200, 255), 0, randi(&w->rnd, 0, 50), randf(&w->rnd, 0.1f, 0.3f)
 					);
 		}
 	}
 }
 
-void blast1(int x, int y){
-	deleteBlock(x-1, y-1);
-	deleteBlock(x-1, y);
-	deleteBlock(x-1, y+1);
+void blast1(gameWorld* w, int x, int y){
+	deleteBlock(w, x-1, y-1);
+	deleteBlock(w, x-1, y);
+	deleteBlock(w, x-1, y+1);
 
-	deleteBlock(x, y-1);
-	deleteBlock(x, y);
-	deleteBlock(x, y+1);
+	deleteBlock(w, x, y-1);
+	deleteBlock(w, x, y);
+	deleteBlock(w, x, y+1);
 
-	deleteBlock(x+1, y-1);
-	deleteBlock(x+1, y);
-	deleteBlock(x+1, y+1);
+	deleteBlock(w, x+1, y-1);
+	deleteBlock(w, x+1, y);
+	deleteBlock(w, x+1, y+1);
 }
 
-void blast2(int x, int y){
-	blast1(x, y);
+void blast2(gameWorld* w, int x, int y){
+	blast1(w, x, y);
 
-	deleteBlock(x-2, y-1);
-	deleteBlock(x-2, y);
-	deleteBlock(x-2, y+1);
+	deleteBlock(w, x-2, y-1);
+	deleteBlock(w, x-2, y);
+	deleteBlock(w, x-2, y+1);
 
-	deleteBlock(x-1, y-2);
-	deleteBlock(x-1, y+2);
+	deleteBlock(w, x-1, y-2);
+	deleteBlock(w, x-1, y+2);
 
-	deleteBlock(x, y-2);
-	deleteBlock(x, y+2);
+	deleteBlock(w, x, y-2);
+	deleteBlock(w, x, y+2);
 
-	deleteBlock(x+1, y-2);
-	deleteBlock(x+1, y+2);
+	deleteBlock(w, x+1, y-2);
+	deleteBlock(w, x+1, y+2);
 
-	deleteBlock(x+2, y-1);
-	deleteBlock(x+2, y);
-	deleteBlock(x+2, y+1);
+	deleteBlock(w, x+2, y-1);
+	deleteBlock(w, x+2, y);
+	deleteBlock(w, x+2, y+1);
 }
 
-void blast3(int x, int y){
-	blast2(x, y);
+void blast3(gameWorld* w, int x, int y){
+	blast2(w, x, y);
 
-	deleteBlock(x-3, y-1);
-	deleteBlock(x-3, y);
-	deleteBlock(x-3, y+1);
+	deleteBlock(w, x-3, y-1);
+	deleteBlock(w, x-3, y);
+	deleteBlock(w, x-3, y+1);
 
-	deleteBlock(x-2, y-2);
-	deleteBlock(x-2, y+2);
+	deleteBlock(w, x-2, y-2);
+	deleteBlock(w, x-2, y+2);
 
-	deleteBlock(x-1, y-3);
-	deleteBlock(x-1, y+3);
+	deleteBlock(w, x-1, y-3);
+	deleteBlock(w, x-1, y+3);
 
-	deleteBlock(x, y-3);
-	deleteBlock(x, y+3);
+	deleteBlock(w, x, y-3);
+	deleteBlock(w, x, y+3);
 
-	deleteBlock(x+1, y-3);
-	deleteBlock(x+1, y+3);
+	deleteBlock(w, x+1, y-3);
+	deleteBlock(w, x+1, y+3);
 
-	deleteBlock(x+2, y-2);
-	deleteBlock(x+2, y+2);
+	deleteBlock(w, x+2, y-2);
+	deleteBlock(w, x+2, y+2);
 
-	deleteBlock(x+3, y-1);
-	deleteBlock(x+3, y);
-	deleteBlock(x+3, y+1);
+	deleteBlock(w, x+3, y-1);
+	deleteBlock(w, x+3, y);
+	deleteBlock(w, x+3, y+1);
 }
 
-void blast4(int x, int y){
-	blast3(x, y);
+void blast4(gameWorld* w, int x, int y){
+	blast3(w, x, y);
 
-	deleteBlock(x-4, y-1);
-	deleteBlock(x-4, y);
-	deleteBlock(x-4, y+1);
+	deleteBlock(w, x-4, y-1);
+	deleteBlock(w, x-4, y);
+	deleteBlock(w, x-4, y+1);
 
-	deleteBlock(x-3, y-3);
-	deleteBlock(x-3, y-2);
-	deleteBlock(x-3, y+2);
-	deleteBlock(x-3, y+3);
+	deleteBlock(w, x-3, y-3);
+	deleteBlock(w, x-3, y-2);
+	deleteBlock(w, x-3, y+2);
+	deleteBlock(w, x-3, y+3);
 
-	deleteBlock(x-2, y-3);
-	deleteBlock(x-2, y+3);
+	deleteBlock(w, x-2, y-3);
+	deleteBlock(w, x-2, y+3);
 
-	deleteBlock(x-1, y-4);
-	deleteBlock(x-1, y+4);
+	deleteBlock(w, x-1, y-4);
+	deleteBlock(w, x-1, y+4);
 
-	deleteBlock(x, y-4);
-	deleteBlock(x, y+4);
+	deleteBlock(w, x, y-4);
+	deleteBlock(w, x, y+4);
 
-	deleteBlock(x+1, y-4);
-	deleteBlock(x+1, y+4);
+	deleteBlock(w, x+1, y-4);
+	deleteBlock(w, x+1, y+4);
 
-	deleteBlock(x+2, y-3);
-	deleteBlock(x+2, y+3);
+	deleteBlock(w, x+2, y-3);
+	deleteBlock(w, x+2, y+3);
 
-	deleteBlock(x+3, y-3);
-	deleteBlock(x+3, y-2);
-	deleteBlock(x+3, y+2);
-	deleteBlock(x+3, y+3);
-
-	deleteBlock(x+4, y-1);
-	deleteBlock(x+4, y);
-	deleteBlock(x+4, y+1);
-}
+	deleteBlock(w, x+3, y-3);
+	deleteBlock(w, x+3, y-2);
+	deleteBlock(w, x+3, y+2);
+	deleteBlock(w, x+3, y+3);
 
-float getNoise(int x, int y){
-	return stb_perlin_noise3((counter+x)*0.1, y*0.1, 0, 0, 0, 0);
+	deleteBlock(w, x+4, y-1);
+	deleteBlock(w, x+4, y);
+	deleteBlock(w, x+4, y+1);
 }
 
-void updateMap(){	
-	counter++;
+// the noise of a whole column in one batch, out[y] == stb_perlin_noise3(column*0.1, y*0.1, 0, 0, 0, 0)
+void columnNoise(int column, float* out){
+	float xs[ytiles], ys[ytiles], zs[ytiles];
 	for(int y = 0; y < ytiles; y++){
-		for(int x = 0; x < xtiles - 1; x++){
-			if (map.get(x+1, y) == ITEM)
-				map.set(x, y, NO_BLOCK);
-			else
-				map.set(x, y, map.get(x+1, y));
-		}
+		xs[y] = (column)*0.1;
+		ys[y] = y*0.1;
+		zs[y] = 0;
 	}
+	perlin_noise3_batch(xs, ys, zs, out, ytiles);
+}
+
+float getNoise(gameWorld* w, int x, int y){
+	if(x >= 0 && x < xtiles && y >= 0 && y < ytiles)
+		return w->mapNoise[x][y];
+	return stb_perlin_noise3((w->counter+x)*0.1, y*0.1, 0, 0, 0, 0);
+}
+
+//==========================MAP STREAMING===================//
+
+// Columns are generated ahead of the camera on a background thread, in chunks
+// of chunkColumns, and handed to updateMap through a lock free queue. Every
+// column has its own rng stream, so a column looks the same no matter if it
+// was streamed or generated on the spot. Worlds without streamMap have no
+// thread and generate every chunk on the spot.
+
+void generateColumn(int column, u32* tiles){
+	Rnd_Gen rnd = rnd_stream((u32)column);
+	float noise[ytiles];
+	columnNoise(column, noise);
 	for(int y = 1; y < ytiles -1; y++){
-		float r = stb_perlin_noise3((counter)*0.1, y*0.1, 0, 0, 0, 0);
+		float r = noise[y];
 		if (r <= 0 || r > 0.5){
-			if (randf(0.0f, 1.0f) < 0.98)
-				map.set(xtiles-1, y, NO_BLOCK);
-			else{
-				map.set(xtiles-1, y, ITEM);
-			}
+			if (randf(&rnd, 0.0f, 1.0f) < 0.98)
+				tiles[y] = NO_BLOCK;
+			else
+				tiles[y] = ITEM;
 		}
 		else
-			map.set(xtiles-1, y, BLOCK);
+			tiles[y] = BLOCK;
+	}
+	tiles[0] = LAVA;
+	tiles[ytiles-1] = LAVA;
+}
+
+void generateChunk(mapChunk* chunk, int first){
+	PROFILE_FUNCTION();
+	chunk->first = first;
+	for(int i = 0; i < chunkColumns; i++)
+		generateColumn(first + i, chunk->tiles[i]);
+}
+
+void mapStreamLoop(gameWorld* w, int first){
+	PROFILE_THREAD_NAME("map streamer");
+	mapChunk chunk;
+	generateChunk(&chunk, first);
+	while(w->mapStreaming.load(std::memory_order_relaxed)){
+		if(w->mapChunks.push(chunk))
+			generateChunk(&chunk, chunk.first + chunkColumns);
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void mapStreamStop(gameWorld* w){
+	if(w->mapStreamer.joinable()){
+		w->mapStreaming = 0;
+		w->mapStreamer.join();
+	}
+	w->mapChunks.clear();
+}
+
+// restarts the producer so the next chunk it delivers starts at column
+void mapStreamStart(gameWorld* w, int column){
+	mapStreamStop(w);
+	generateChunk(&w->mapCurrent, column);
+	if(!w->streamMap)
+		return;
+	w->mapStreaming = 1;
+	w->mapStreamer = std::thread(mapStreamLoop, w, column + chunkColumns);
+}
+
+// continues the stream at column after the map jumped (snapshots, rewind). Columns before
+// the stream are generated on the spot until it is reached again, the producer is only
+// restarted for a jump past what it already has queued.
+void mapStreamSeek(gameWorld* w, int column){
+	if(!w->streamMap)
+		generateChunk(&w->mapCurrent, column);
+	else if(!w->mapStreamer.joinable() || column >= w->mapCurrent.first + chunkColumns*chunksAhead)
+		mapStreamStart(w, column);
+}
+
+// returns the tiles of column, waits for nothing: if the producer is behind
+// the chunk is generated here instead
+u32* streamColumn(gameWorld* w, int column){
+	if(column < w->mapCurrent.first){
+		generateColumn(column, w->mapBehind);
+		return w->mapBehind;
+	}
+	while(column >= w->mapCurrent.first + chunkColumns){
+		int next = w->mapCurrent.first + chunkColumns;
+		if(!w->streamMap){
+			generateChunk(&w->mapCurrent, next);
+			continue;
+		}
+		do{
+			if(!w->mapChunks.pop(&w->mapCurrent)){
+				PROFILE_SCOPE("map stall");
+				w->mapStalls++;
+				generateChunk(&w->mapCurrent, next);
+			}
+		}while(w->mapCurrent.first < next);
+	}
+	return w->mapCurrent.tiles[column - w->mapCurrent.first];
+}
+
+//==========================MAP STREAMING END===============//
+
+void updateMap(gameWorld* w){	
+	PROFILE_FUNCTION();
+	w->counter++;
+	// items that were not picked up by spawnMapItems don't scroll along, only columns that have one are looked at
+	tilemap_scroll_left(&w->map);
+	for(int x = 0; x < xtiles - 1; x++){
+		if(!(tilemap_column_kinds(&w->map, x) & tilemap_kind(ITEM)))
+			continue;
+		for(int y = 0; y < ytiles; y++)
+			if(w->map.get(x, y) == ITEM)
+				w->map.set(x, y, NO_BLOCK);
 	}
-	map.set(xtiles-1, 0, LAVA);
-	map.set(xtiles-1, ytiles-1, LAVA);
+	u32* column = streamColumn(w, w->counter);
+	for(int y = 0; y < ytiles; y++)
+		w->map.set(xtiles-1, y, column[y]);
+	memmove(w->mapNoise[0], w->mapNoise[1], sizeof(w->mapNoise[0]) * (xtiles-1));
+	columnNoise(w->counter + xtiles-1, w->mapNoise[xtiles-1]);
 }
 
 //==========================GAME DATA END===================//
@@ -5,29 +5,6 @@
 
 //==========================GAME ITEM=======================//
 
-bool itemGravityFlipped = false;
-
-enum itemType{
-	STAR,
-	GRENADE,
-	GRENADEPACK,
-	CLUSTERGRENADE,
-	CLUSTERCHILD,
-	CLUSTERGRENADEPACK,
-	MISSILE,
-	MISSILEPACK
-};
-
-struct gameItem{
-	v2 pos;
-	v2 vel;
-	v2 acc;
-	float initVel;
-	float r;
-	itemType type;
-	bool active;
-};
-
 gameItem createGameItem(float x, float y, float initVel, float r, itemType type){
 	gameItem itm;
 	itm.pos = {x, y};
@@ -40,13 +17,13 @@ gameItem createGameItem(float x, float y, float initVel, float r, itemType type)
 	return itm;
 }
 
-void restartItems(){
-	itemGravityFlipped = false;
+void restartItems(gameWorld* w){
+	w->itemGravityFlipped = false;
 }
 
-gameItem randomCollectable(float x, float y){
+gameItem randomCollectable(gameWorld* w, float x, float y){
 	gameItem itm;
-	int chance = randi(0,100);
+	int chance = randi(&w->rnd, 0,100);
 	if(chance < 70){
 		itm = createGameItem(x, y, 0, 0.25, GRENADEPACK);
 	}
@@ -79,120 +56,309 @@ bool itemIsActive(gameItem* itm){
 	return itm->active;
 }
 
-void itemFlipGravity(){
-	itemGravityFlipped = !itemGravityFlipped;
+void itemFlipGravity(gameWorld* w){
+	w->itemGravityFlipped = !w->itemGravityFlipped;
 }
 
 //==========================UPDATE==========================//
 
-void itemGravity(gameItem* itm, float t){
-	if (itemGravityFlipped){itm->acc.y += 40;}
+void itemGravity(gameWorld* w, gameItem* itm, float t){
+	if (w->itemGravityFlipped){itm->acc.y += 40;}
 	else{itm->acc.y -= 40;}
 	itm->vel.y = itm->acc.y * t;
 	itm->pos.y += itm->vel.y * t;
 }
 
-void collect(gameItem* itm, gameObject* obj){
+void collect(gameWorld* w, gameItem* itm, gameObject* obj){
 	if(itm->type == GRENADEPACK){
 		obj->grenades += 5;
-		collectEffect(itm->pos.x, itm->pos.y, 255, 255, 100);
+		collectEffect(w, itm->pos.x, itm->pos.y, 255, 255, 100);
 	}
 	if(itm->type == MISSILEPACK){
 		obj->missiles += 5;
-		collectEffect(itm->pos.x, itm->pos.y, 255, 0, 0);
+		collectEffect(w, itm->pos.x, itm->pos.y, 255, 0, 0);
 	}
 	if(itm->type == CLUSTERGRENADEPACK){
 		obj->clustergrenades += 5;
-		collectEffect(itm->pos.x, itm->pos.y, 0, 255, 100);
+		collectEffect(w, itm->pos.x, itm->pos.y, 0, 255, 100);
 	}
 	if(itm->type == STAR){
 		obj->starlife = 10.0f;
-		collectEffect(itm->pos.x, itm->pos.y, 255, 255, 255);
+		collectEffect(w, itm->pos.x, itm->pos.y, 255, 255, 255);
 	}
 }
 
-void updateGrenade(gameItem* itm, float t, int col){
-	//itemGravity(itm, t);
-	if(!(COLLISION(col, Right) || 
-		COLLISION(col, Top) || 
-		COLLISION(col, Bot)) && 
-		itm->pos.x < 210){
-		if(itm->initVel < 0)
-			itm->initVel = 0;
-		itm->pos.x += (itm->initVel + 50) * t;
-	} else {
-		blast3((int)itm->pos.x, (int)itm->pos.y);
-		itm->active = false;
+//==========================ITEM POOLS======================//
+
+// every itemType has its own pool (itemPool in gameWorld.h)
+#define ITEM_HIT(col) (COLLISION(col, Right) || COLLISION(col, Top) || COLLISION(col, Bot))
+
+// item handles resolve to the pool and the index in it, the index is updated whenever
+// a compaction moves the item. Spawned but not yet committed items are itemPending.
+
+#define itemPending 0xffffffffu
+#define itemLocation(type, i) (((u32)(type) << 24) | (u32)(i))
+
+int itemPoolLen(itemPool* p){
+	return p->x.len();
+}
+
+int itemCount(gameWorld* w){
+	int n = 0;
+	for(int t = 0; t < itemTypes; t++)
+		n += itemPoolLen(&w->itemPools[t]);
+	return n;
+}
+
+void addItem(gameWorld* w, gameItem itm, Handle id){
+	itemPool* p = &w->itemPools[itm.type];
+	w->itemHandles.set(id, itemLocation(itm.type, itemPoolLen(p)));
+	p->id.add(id);
+	p->x.add(itm.pos.x);
+	p->y.add(itm.pos.y);
+	p->vx.add(itm.vel.x);
+	p->vy.add(itm.vel.y);
+	p->ax.add(itm.acc.x);
+	p->initVel.add(itm.initVel);
+	p->r.add(itm.r);
+	p->active.add(itm.active);
+	p->col.add(0);
+}
+
+gameItem getItem(gameWorld* w, int type, int i){
+	itemPool* p = &w->itemPools[type];
+	gameItem itm = createGameItem(p->x[i], p->y[i], p->initVel[i], p->r[i], (enum itemType)type);
+	itm.vel = {p->vx[i], p->vy[i]};
+	itm.acc = {p->ax[i], 0};
+	itm.active = p->active[i];
+	return itm;
+}
+
+// false for stale handles and for items that are not committed yet
+bool findItem(gameWorld* w, Handle id, int* type, int* i){
+	if(!w->itemHandles.valid(id) || w->itemHandles.get(id) == itemPending)
+		return false;
+	u32 location = w->itemHandles.get(id);
+	*type = location >> 24;
+	*i = location & 0xffffff;
+	return true;
+}
+
+//==========================COMMANDS=======================//
+
+// same as for particles: spawns and removals are recorded and applied in commitItems,
+// so the pools never change size while a kernel or a loop in core.h walks them
+
+// the handle is valid right away, findItem resolves it after the next commit
+Handle spawnItem(gameWorld* w, gameItem itm){
+	Handle id = w->itemHandles.acquire(itemPending);
+	w->itemSpawns.add(itm);
+	w->itemSpawnIds.add(id);
+	return id;
+}
+
+void destroyItem(gameWorld* w, int type, int i){
+	w->itemDeaths[type].add(i);
+}
+
+// drops every item where keep is 0, keeps the order, one pass over all fields
+void compactItemPool(gameWorld* w, int type, const u8* keep){
+	itemPool* p = &w->itemPools[type];
+	int n = itemPoolLen(p);
+	int k = 0;
+	for(int i = 0; i < n; i++){
+		if(!keep[i]){
+			w->itemHandles.release(p->id[i]);
+			continue;
+		}
+		if(k != i)
+			w->itemHandles.set(p->id[i], itemLocation(type, k));
+		p->id[k] = p->id[i];
+		p->x[k] = p->x[i];
+		p->y[k] = p->y[i];
+		p->vx[k] = p->vx[i];
+		p->vy[k] = p->vy[i];
+		p->ax[k] = p->ax[i];
+		p->initVel[k] = p->initVel[i];
+		p->r[k] = p->r[i];
+		p->active[k] = p->active[i];
+		k++;
 	}
+	p->x._len = p->y._len = p->vx._len = p->vy._len = p->ax._len = k;
+	p->initVel._len = p->r._len = p->active._len = p->id._len = p->col._len = k;
 }
 
-void updateClusterGrenade(gameItem* itm, float t, int col, Array<gameItem>* items){
-	//itemGravity(itm, t);
-	if(!(COLLISION(col, Right) || 
-		COLLISION(col, Top) || 
-		COLLISION(col, Bot)) && 
-		itm->pos.x < 210){
-		if(itm->initVel < 0)
-			itm->initVel = 0;
-		itm->pos.x += (itm->initVel + 50) * t;
-	} else {
-		blast4((int)itm->pos.x, (int)itm->pos.y);
-		int m = 0;
-		int n = 1;
-		gameItem c1 = createGameItem(itm->pos.x, itm->pos.y, 0, 0.25f, CLUSTERCHILD);
-			c1.vel = {15.0f, 15.0f};
-		gameItem c2 = createGameItem(itm->pos.x, itm->pos.y, 0, 0.25f, CLUSTERCHILD);
-			c2.vel = {25.0f, 15.0f};
-		gameItem c3 = createGameItem(itm->pos.x, itm->pos.y, 0, 0.25f, CLUSTERCHILD);
-			c3.vel = {40.0f, 0.0f};
-		gameItem c4 = createGameItem(itm->pos.x, itm->pos.y, 0, 0.25f, CLUSTERCHILD);
-			c4.vel = {25.0f, -15.0f};
-		gameItem c5 = createGameItem(itm->pos.x, itm->pos.y, 0, 0.25f, CLUSTERCHILD);
-			c5.vel = {15.0f, -15.0f};
-		items->add(c1);
-		items->add(c2);
-		items->add(c3);
-		items->add(c4);
-		items->add(c5);
-		itm->active = false;
+// removals with one compaction per pool, then the spawns in recorded order
+void commitItems(gameWorld* w){
+	PROFILE_FUNCTION();
+	for(int type = 0; type < itemTypes; type++){
+		Array<int>* deaths = &w->itemDeaths[type];
+		if(!deaths->len())
+			continue;
+		int n = itemPoolLen(&w->itemPools[type]);
+		w->itemKeep.resize(n);
+		memset(w->itemKeep.ptr(), 1, n);
+		for(int i = 0; i < deaths->len(); i++)
+			w->itemKeep[(*deaths)[i]] = 0;
+		compactItemPool(w, type, w->itemKeep.ptr());
+		deaths->clear();
 	}
+	for(int i = 0; i < w->itemSpawns.len(); i++)
+		addItem(w, w->itemSpawns[i], w->itemSpawnIds[i]);
+	w->itemSpawns.clear();
+	w->itemSpawnIds.clear();
 }
 
-void updateClusterChild(gameItem* itm, float t, int col){
-	if(!((COLLISION(col, Right) || 
-		COLLISION(col, Top) || 
-		COLLISION(col, Bot)))){
-		itm->pos += itm->vel * t;
-	} else {
-		blast4((int)itm->pos.x, (int)itm->pos.y);
-		itm->active = false;
+void clearItems(gameWorld* w){
+	for(int t = 0; t < itemTypes; t++){
+		itemPool* p = &w->itemPools[t];
+		for(int i = 0; i < p->id.len(); i++)
+			w->itemHandles.release(p->id[i]);
+		p->id.clear();
+		p->x.clear(); p->y.clear(); p->vx.clear(); p->vy.clear(); p->ax.clear();
+		p->initVel.clear(); p->r.clear(); p->active.clear(); p->col.clear();
+		w->itemDeaths[t].clear();
 	}
+	for(int i = 0; i < w->itemSpawnIds.len(); i++)
+		w->itemHandles.release(w->itemSpawnIds[i]);
+	w->itemSpawns.clear();
+	w->itemSpawnIds.clear();
 }
 
-void updateMissile(gameItem* itm, float t, int col){
-	itm->acc.x += 20.0f;
-	itm->vel.x += itm->acc.x * t;
-	if(!(COLLISION(col, Right) || 
-		COLLISION(col, Top) || 
-		COLLISION(col, Bot)) && 
-		itm->pos.x < 210){
-		if(itm->initVel < 0)
-			itm->initVel = 0;
-		itm->pos.x += (itm->initVel + 20 + itm->vel.x) * t;
-	} else {
-		blast4((int)itm->pos.x, (int)itm->pos.y);
-		itm->active = false;
+//==========================UPDATE KERNELS==================//
+
+// scroll with the map and look up the tilemap, the only part that is not a straight loop
+void scrollItems(itemPool* p, float cOffset){
+	int n = itemPoolLen(p);
+	float* x = p->x.ptr();
+	for(int i = 0; i < n; i++)
+		x[i] -= cOffset;
+}
+
+void collideItems(gameWorld* w, itemPool* p, float cOffset){
+	int n = itemPoolLen(p);
+	for(int i = 0; i < n; i++)
+		p->col[i] = tilemap_get_collision(&w->map, {p->x[i], p->y[i]}, p->r[i]*2, cOffset);
+}
+
+// flies right until it hits something, hit items are marked inactive
+void updateGrenades(itemPool* p, float t){
+	int n = itemPoolLen(p);
+	float* x = p->x.ptr();
+	float* initVel = p->initVel.ptr();
+	const int* col = p->col.ptr();
+	u8* active = p->active.ptr();
+	for(int i = 0; i < n; i++){
+		int fly = !ITEM_HIT(col[i]) && x[i] < 210;
+		float v = initVel[i] < 0 ? 0 : initVel[i];
+		initVel[i] = fly ? v : initVel[i];
+		x[i] += fly ? (v + 50) * t : 0;
+		active[i] = fly;
+	}
+}
+
+void updateMissiles(itemPool* p, float t){
+	int n = itemPoolLen(p);
+	float* x = p->x.ptr();
+	float* vx = p->vx.ptr();
+	float* ax = p->ax.ptr();
+	float* initVel = p->initVel.ptr();
+	const int* col = p->col.ptr();
+	u8* active = p->active.ptr();
+	for(int i = 0; i < n; i++){
+		ax[i] += 20.0f;
+		vx[i] += ax[i] * t;
+		int fly = !ITEM_HIT(col[i]) && x[i] < 210;
+		float v = initVel[i] < 0 ? 0 : initVel[i];
+		initVel[i] = fly ? v : initVel[i];
+		x[i] += fly ? (v + 20 + vx[i]) * t : 0;
+		active[i] = fly;
+	}
+}
+
+void updateClusterChildren(itemPool* p, float t){
+	int n = itemPoolLen(p);
+	float* x = p->x.ptr();
+	float* y = p->y.ptr();
+	const float* vx = p->vx.ptr();
+	const float* vy = p->vy.ptr();
+	const int* col = p->col.ptr();
+	u8* active = p->active.ptr();
+	for(int i = 0; i < n; i++){
+		int fly = !ITEM_HIT(col[i]);
+		x[i] += fly ? vx[i] * t : 0;
+		y[i] += fly ? vy[i] * t : 0;
+		active[i] = fly;
+	}
+}
+
+void updateStars(gameWorld* w, itemPool* p, float t){
+	int n = itemPoolLen(p);
+	float* x = p->x.ptr();
+	for(int i = 0; i < n; i++)
+		x[i] -= 10*t;
+	for(int i = 0; i < n; i++)
+		starfall(w, x[i], p->y[i]);
+}
+
+// blasts for everything the kernel marked inactive this frame
+void explodeItems(gameWorld* w, itemPool* p, void (*blast)(gameWorld*, int, int)){
+	int n = itemPoolLen(p);
+	for(int i = 0; i < n; i++)
+		if(!p->active[i])
+			blast(w, (int)p->x[i], (int)p->y[i]);
+}
+
+void spawnClusterChildren(gameWorld* w, itemPool* p){
+	const v2 vels[] = {{15.0f, 15.0f}, {25.0f, 15.0f}, {40.0f, 0.0f}, {25.0f, -15.0f}, {15.0f, -15.0f}};
+	int n = itemPoolLen(p);
+	for(int i = 0; i < n; i++){
+		if(p->active[i])
+			continue;
+		for(int c = 0; c < (int)count_of(vels); c++){
+			gameItem child = createGameItem(p->x[i], p->y[i], 0, 0.25f, CLUSTERCHILD);
+			child.vel = vels[c];
+			spawnItem(w, child);
+		}
 	}
 }
 
-void updateGameItem(gameItem* itm, float t, float cOffset, Array<gameItem>* items){
-	itm->pos.x -= cOffset;
-	int col = tilemap_get_collision(&map, itm->pos, itm->r*2, cOffset);
-	if(itm->type == GRENADE){updateGrenade(itm, t, col);}
-	else if(itm->type == CLUSTERGRENADE){updateClusterGrenade(itm, t, col, items);}
-	else if(itm->type == CLUSTERCHILD){updateClusterChild(itm, t, col);}
-	else if(itm->type == MISSILE){updateMissile(itm, t, col);}
-	else if(itm->type == STAR){itm->pos.x -= 10*t; starfall(itm->pos.x, itm->pos.y);}	
+// cluster children are spawned through itemSpawns, so they start moving with the next commit
+void updateItems(gameWorld* w, float t, float cOffset){
+	PROFILE_FUNCTION();
+	itemPool* grenades = &w->itemPools[GRENADE];
+	scrollItems(grenades, cOffset);
+	collideItems(w, grenades, cOffset);
+	updateGrenades(grenades, t);
+	explodeItems(w, grenades, blast3);
+
+	itemPool* clusters = &w->itemPools[CLUSTERGRENADE];
+	scrollItems(clusters, cOffset);
+	collideItems(w, clusters, cOffset);
+	updateGrenades(clusters, t);
+	explodeItems(w, clusters, blast4);
+	spawnClusterChildren(w, clusters);
+
+	itemPool* children = &w->itemPools[CLUSTERCHILD];
+	scrollItems(children, cOffset);
+	collideItems(w, children, cOffset);
+	updateClusterChildren(children, t);
+	explodeItems(w, children, blast4);
+
+	itemPool* missiles = &w->itemPools[MISSILE];
+	scrollItems(missiles, cOffset);
+	collideItems(w, missiles, cOffset);
+	updateMissiles(missiles, t);
+	explodeItems(w, missiles, blast4);
+
+	itemPool* stars = &w->itemPools[STAR];
+	scrollItems(stars, cOffset);
+	updateStars(w, stars, t);
+
+	// pickups only move with the map
+	scrollItems(&w->itemPools[GRENADEPACK], cOffset);
+	scrollItems(&w->itemPools[CLUSTERGRENADEPACK], cOffset);
+	scrollItems(&w->itemPools[MISSILEPACK], cOffset);
 }
 
 //==========================UPDATE END======================//
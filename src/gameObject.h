@@ -6,45 +6,34 @@
 #define gravityConst		-20
 #define frictionConst		-50
 
-float warp = 0.0f;
-
-struct gameObject{
-	v2 pos;
-	v2 vel;
-	v2 acc;
-	v2 initialPos;
-	bool gravityFlipped;
-	bool active;
-	float offset;
-	int col;
-	int coins;
-	int grenades;
-	int clustergrenades;
-	int missiles;
-
-	float starlife;
-};
-
 //================================ALLOC ACTIVE=================================//
 
-gameObject* allocGameObject(float x, float y)
+// objects live in gameObjects and are referenced by handle, a gameObject* from
+// getGameObject is only good until the next createGameObject/destroyGameObject
+Handle createGameObject(gameWorld* w, float x, float y)
 {
-	gameObject* obj = (gameObject*)calloc(1, sizeof(gameObject));
-	if (obj != NULL)
-	{
-		obj->initialPos = {x, y};
-		obj->pos = obj->initialPos;
-		obj->vel = {};
-		obj->acc = {};
-		obj->gravityFlipped = false;
-		obj->active = false;
-		obj->coins = 0;
-		obj->grenades = 10;
-		obj->clustergrenades = 0;
-		obj->missiles = 0;
-		obj->starlife = 10.0f;
-	}
-	return obj;
+	Handle id = w->gameObjects.create();
+	gameObject* obj = w->gameObjects.get(id);
+	obj->initialPos = {x, y};
+	obj->pos = obj->initialPos;
+	obj->vel = {};
+	obj->acc = {};
+	obj->gravityFlipped = false;
+	obj->active = false;
+	obj->coins = 0;
+	obj->grenades = 10;
+	obj->clustergrenades = 0;
+	obj->missiles = 0;
+	obj->starlife = 10.0f;
+	return id;
+}
+
+gameObject* getGameObject(gameWorld* w, Handle id){
+	return w->gameObjects.get(id);
+}
+
+void destroyGameObject(gameWorld* w, Handle id){
+	w->gameObjects.rem(id);
 }
 
 void activate(gameObject* obj){
@@ -155,7 +144,7 @@ void friction(gameObject* obj){
 	}
 }
 
-void bounce(gameObject* obj){
+void bounce(gameWorld* w, gameObject* obj){
 	bool bounced = false;
 	if(obj->starlife == 0.0f) {
 		if(COLLISION(obj->col, Bot)){
@@ -179,12 +168,12 @@ void bounce(gameObject* obj){
 			obj->pos.x += 0.1;
 		}
 		if(bounced){
-			systemGlitch();
+			systemGlitch(w);
 			if(abs(obj->vel.x) > 15 &&(COLLISION(obj->col, Right)||COLLISION(obj->col, Left))||
 				abs(obj->vel.y) > 15 &&(COLLISION(obj->col, Top)||COLLISION(obj->col, Bot)))
-				blast3((int)obj->pos.x, (int)obj->pos.y);
+				blast3(w, (int)obj->pos.x, (int)obj->pos.y);
 			else
-				blast1((int)obj->pos.x, (int)obj->pos.y);
+				blast1(w, (int)obj->pos.x, (int)obj->pos.y);
 		}
 	}
 }
@@ -225,7 +214,7 @@ int missilesLeft(gameObject* obj){
 
 //================================MOVE OPERATIONS END==========================//
 
-void updateObject(gameObject* obj, float t, float cOffset){
+void updateObject(gameWorld* w, gameObject* obj, float t, float cOffset){
 	obj->pos.x -= cOffset;
 	obj->pos += obj->vel * t;
 	obj->vel += obj->acc * t;
@@ -233,14 +222,14 @@ void updateObject(gameObject* obj, float t, float cOffset){
 
 	if(obj->starlife > 0.0f){
 		obj->starlife -= t;
-		warp += t;
-		while(warp > 0.5f){
-			blast1((int)obj->pos.x, (int)obj->pos.y);
+		w->warp += t;
+		while(w->warp > 0.5f){
+			blast1(w, (int)obj->pos.x, (int)obj->pos.y);
 			if(obj->starlife > 2.0f)
-				starEffect(obj->pos.x+0.05f, obj->pos.y+0.05f, randi(150, 255), randi(150, 255), randi(150, 255));
+				starEffect(w, obj->pos.x+0.05f, obj->pos.y+0.05f, randi(&w->rnd, 150, 255), randi(&w->rnd, 150, 255), randi(&w->rnd, 150, 255));
 			else
-				starEffect(obj->pos.x+0.05f, obj->pos.y+0.05f, 255,  0, 50);
-			warp -= 0.05f;
+				starEffect(w, obj->pos.x+0.05f, obj->pos.y+0.05f, 255,  0, 50);
+			w->warp -= 0.05f;
 		}
 		if(obj->pos.y < 2.0f){
 			obj->vel.y = 15.0f;
@@ -253,15 +242,15 @@ void updateObject(gameObject* obj, float t, float cOffset){
 	}
 
 
-	obj->col = tilemap_get_collision(&map, obj->pos, 0.5, cOffset);
+	obj->col = tilemap_get_collision(&w->map, obj->pos, 0.5, cOffset);
 	
 	//gravity(obj);
 	friction(obj);
-	bounce(obj);
+	bounce(w, obj);
 
 	if(obj->starlife < 0.0f){
 		obj->starlife = 0.0f;
-		warp = 0.0f;
+		w->warp = 0.0f;
 	}
 }
 
@@ -0,0 +1,169 @@
+#ifndef gameWorld_h
+#define gameWorld_h
+
+#include "gameState.h"
+
+//==========================GAME WORLD======================//
+
+// Everything one game is made of. Every function of the simulation takes the
+// world it works on and nothing it changes is global, so one process can run
+// any number of games, on as many threads as it likes as long as a world is
+// only stepped by one thread at a time (see sim --batch).
+//
+// The data types of the simulation are all here, the functions on them stay
+// in their headers. Not part of a world: the window and the renderer, the
+// replay and the rewind history, they belong to the one game on the screen.
+
+#define xtiles 		160
+#define ytiles 		40
+#define NO_BLOCK	0
+#define BLOCK 		1
+#define LAVA		2
+#define ITEM		3
+
+// map streaming, see gameData.h
+#define chunkColumns	8
+#define chunksAhead		16
+
+struct mapChunk{
+	int first;
+	u32 tiles[chunkColumns][ytiles];
+};
+
+struct particle{
+	v2 pos;
+	v2 vel;
+	v2 acc;
+	float zpos;
+	float zvel;
+	float r;
+	float life;
+	float delay;
+	int red;
+	int green;
+	int blue;
+	float alpha;
+};
+
+struct gameObject{
+	v2 pos;
+	v2 vel;
+	v2 acc;
+	v2 initialPos;
+	bool gravityFlipped;
+	bool active;
+	float offset;
+	int col;
+	int coins;
+	int grenades;
+	int clustergrenades;
+	int missiles;
+
+	float starlife;
+};
+
+enum itemType{
+	STAR,
+	GRENADE,
+	GRENADEPACK,
+	CLUSTERGRENADE,
+	CLUSTERCHILD,
+	CLUSTERGRENADEPACK,
+	MISSILE,
+	MISSILEPACK
+};
+
+#define itemTypes (MISSILEPACK + 1)
+
+struct gameItem{
+	v2 pos;
+	v2 vel;
+	v2 acc;
+	float initVel;
+	float r;
+	itemType type;
+	bool active;
+};
+
+// every itemType has its own pool, the fields are separate arrays so the
+// update kernels are plain loops over floats instead of a type switch per item
+struct itemPool{
+	Array<float> x;
+	Array<float> y;
+	Array<float> vx;
+	Array<float> vy;
+	Array<float> ax;
+	Array<float> initVel;
+	Array<float> r;
+	Array<u8> active;
+	Array<Handle> id;
+	Array<int> col; // scratch, collision of this frame
+};
+
+struct gameWorld{
+	Rnd_Gen rnd;	// everything the simulation rolls
+	Rnd_Gen fxRnd;	// vfx only randomness (lava, far columns), so drawing never changes what the simulation rolls
+
+	//core.h
+	float frameTime;
+	float delay;
+	float mapWarp;
+	float speed;
+
+	float cameraXpos;
+	float cameraYpos;
+	float lastCamXpos;
+	float lastCamYpos;
+	float newCamXpos;
+	float newCamYpos;
+	float camDelay;
+
+	int HIGH_SCORE;
+	int BEST_SCORE;
+	int LAST_SCORE;
+	int SCORE;
+
+	gameState state;
+	Handle playerId;
+	gameObject* player; // resolved from playerId every frame
+
+	//gameData.h
+	int counter;
+	int score;		// of destroyed blocks, getScore moves it to SCORE
+	Tilemap map;
+	float mapNoise[xtiles][ytiles];	// getNoise of every tile, scrolls with the map
+
+	bool streamMap;	// columns come from a thread of their own, off for worlds that run in a batch
+	Job_Pool* mapJobs;	// splits a new map up by columns, NULL does it all on the calling thread
+	Spsc_Queue<mapChunk, chunksAhead> mapChunks;
+	std::thread mapStreamer;
+	std::atomic<int> mapStreaming;
+	mapChunk mapCurrent;
+	u32 mapBehind[ytiles];	// a column before mapCurrent, after going back in time
+	int mapStalls;
+
+	//gameObject.h
+	Slot_Map<gameObject> gameObjects;
+	float warp;
+
+	//gameItem.h
+	bool itemGravityFlipped;
+	itemPool itemPools[itemTypes];
+	Handle_Table itemHandles;	// resolve to the pool and the index in it
+	Array<gameItem> itemSpawns;
+	Array<Handle> itemSpawnIds;
+	Array<int> itemDeaths[itemTypes];
+	Array<u8> itemKeep;
+
+	//particle.h
+	Array<particle> particles;
+	Array<Handle> particleIds;
+	Handle_Table particleHandles;	// resolve to the index in particles
+	Array<particle> particleSpawns;
+	Array<Handle> particleSpawnIds;
+	Array<int> particleDeaths;
+	Array<u8> particleKeep;
+};
+
+//==========================GAME WORLD END==================//
+#endif
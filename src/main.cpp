@@ -1,9 +1,62 @@
 #include "core.h"
 
-int main() {
+// game [--record file] [--replay file] [--pacing vsync|adaptive|latency|uncapped] [--mesh]
+//      [--fov degrees] [--lod pixels] [--trace file.json] [--trace-summary frames] [--profile file.json]
+//
+// --pacing is how frames wait for the display, low latency by default, F7 switches
+// through the modes while playing (see FRAME PACING in ats_tool.h).
+//
+// --mesh draws the map's blocks as a greedy mesh instead of a cube each, F6 switches
+// (see mapMesh.h).
+//
+// --fov is the vertical field of view of the camera, 60 by default. Map columns and
+// particles smaller than --lod pixels on the screen (3 by default, 0 turns it off) are
+// drawn as flat quads, particles under a quarter of that not at all.
+//
+// --trace and --trace-summary only exist in a build with ATS_RENDER_TRACE (build.sh trace),
+// see RENDER TRACE in ats_tool.h. --profile only with ATS_PROFILE (build.sh profile), the
+// timeline is written on exit and with F8, see PROFILER in ats_tool.h.
+int main(int argc, char** argv) {
+#ifdef ATS_RENDER_TRACE
+	const char* tracePath = NULL;
+	int traceSummary = 0;
+#endif
+	for(int i = 1; i < argc; i++){
+		if(!strcmp(argv[i], "--record") && i + 1 < argc) replayRecordPath = argv[++i];
+		else if(!strcmp(argv[i], "--mesh")) mapMeshed = true;
+		else if(!strcmp(argv[i], "--fov") && i + 1 < argc) cameraFov = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--lod") && i + 1 < argc) lodPixels = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--pacing") && i + 1 < argc){
+			const char* modes[FRAME_PACING_COUNT] = {"vsync", "adaptive", "latency", "uncapped"};
+			i++;
+			for(int m = 0; m < FRAME_PACING_COUNT; m++)
+				if(!strcmp(argv[i], modes[m]))
+					pacing = (Frame_Pacing)m;
+		}
+#ifdef ATS_PROFILE
+		else if(!strcmp(argv[i], "--profile") && i + 1 < argc) profilePath = argv[++i];
+#endif
+#ifdef ATS_RENDER_TRACE
+		else if(!strcmp(argv[i], "--trace") && i + 1 < argc) tracePath = argv[++i];
+		else if(!strcmp(argv[i], "--trace-summary") && i + 1 < argc) traceSummary = atoi(argv[++i]);
+#endif
+		else if(!strcmp(argv[i], "--replay") && i + 1 < argc){
+			if(!replayLoad(argv[++i])){
+				printf("could not read replay %s\n", argv[i]);
+				return 1;
+			}
+			replayPlaying = true;
+		}
+	}
+#ifdef ATS_RENDER_TRACE
+	if(!render_trace_open(tracePath, tracePath || traceSummary ? traceSummary : 60)){
+		printf("could not write %s\n", tracePath);
+		return 1;
+	}
+#endif
 	coreInit(1980, 1080, "Floor is lava!");
 	while(coreIsOpen()){
 		coreUpdateAndRender();
 	}
 	coreDestroy();
-}
\ No newline at end of file
+}
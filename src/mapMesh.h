@@ -0,0 +1,113 @@
+#ifndef mapMesh_h
+#define mapMesh_h
+
+//==========================MAP MESH========================//
+
+// drawMap's BLOCK tiles as a greedy mesh instead of one cube each (--mesh, F6 switches).
+// Block heights are quantized to meshLevels levels of their noise, and greedy_rects merges
+// the blocks of each level into rectangles: every rectangle is one box (render_cube's faces)
+// without the gaps between its tiles, as high as its level and shaded by it. So every tile
+// still has the height and shade of its own noise, only in meshLevels steps instead of smooth.
+//
+// Meshes are kept per chunk of meshChunkColumns columns of the world (counter + x), so
+// scrolling doesn't touch them. A chunk is rebuilt when one of its columns has another
+// stamp than the chunk was built from (setBlock, deleteBlock and new columns change them).
+// Only chunks that are whole in the left xtiles - 40 columns are drawn from a mesh, the
+// columns before and after them still are drawn by drawMap tile by tile. A chunk that was
+// never built can't be taken for one that was, stamps start at 1.
+
+#define meshChunkColumns	8
+#define meshLevels		4	// of noise, fewer make bigger boxes and bigger steps
+#define meshChunkCount		(xtiles / meshChunkColumns + 1)	// more than can be on the map at once
+
+struct meshChunk{
+	int column;		// of the world, the first one of the chunk
+	u32 stamps[meshChunkColumns];
+	Vertex_Array verts;	// x from 0 at the left of the chunk
+};
+
+bool mapMeshed;
+meshChunk meshChunks[meshChunkCount];
+Array<Tile_Rect> meshRects;
+Vertex_Array meshFrame;	// the chunks of a frame, moved to where they are on the screen
+
+// the noise in the middle of level
+float meshLevelNoise(int level){
+	return (level + 0.5f) / meshLevels * 2.0f - 1.0f;
+}
+
+int meshLevel(gameWorld* w, int x, int y){
+	int level = (int)floorf((getNoise(w, x, y) + 1.0f) * 0.5f * meshLevels);
+	return MIN(MAX(level, 0), meshLevels - 1);
+}
+
+Color meshShade(float noise){
+	float k = MAX(1.0f + noise*0.8f, 0.3f);
+	return {(u8)MIN(120*k, 255.0f), (u8)MIN(50*k, 255.0f), (u8)MIN(210*k, 255.0f), 255};
+}
+
+// map column x is the first of the chunk
+void meshChunkBuild(gameWorld* w, meshChunk* c, int x){
+	PROFILE_FUNCTION();
+	c->column = w->counter + x;
+	for(int i = 0; i < meshChunkColumns; i++)
+		c->stamps[i] = tilemap_column_stamp(&w->map, x + i);
+
+	// bit y of levels[level][i]: the block in row y of column x + i is on that level
+	u64 levels[meshLevels][meshChunkColumns] = {};
+	for(int i = 0; i < meshChunkColumns; i++)
+		for(int y = 1; y < ytiles - 1; y++)
+			if(tileType(w, x + i, y) == BLOCK)
+				levels[meshLevel(w, x + i, y)][i] |= 1ull << y;
+
+	c->verts.clear();
+	for(int level = 0; level < meshLevels; level++){
+		float noise = meshLevelNoise(level);
+		Color shade = meshShade(noise);
+		meshRects.clear();
+		greedy_rects(levels[level], meshChunkColumns, 0, &meshRects);
+		for(int i = 0; i < meshRects.len(); i++){
+			Tile_Rect r = meshRects[i];
+			vertex_array_add_cube(&c->verts, r.x0 + 0.05f, r.y0 + 0.05f, r.x1 + 0.95f, r.y1 + 0.95f,
+								noise*0.9f + 1.0f, 0.0f, shade.r, shade.g, shade.b, shade.a);
+		}
+	}
+}
+
+meshChunk* meshChunkGet(gameWorld* w, int x){
+	int column = w->counter + x;
+	meshChunk* c = &meshChunks[(column / meshChunkColumns) % meshChunkCount];
+	if(c->column != column || memcmp(c->stamps, &w->map.column_stamps[x], sizeof(c->stamps)))
+		meshChunkBuild(w, c, x);
+	return c;
+}
+
+// the blocks of map columns x0 to x1 (not included), both on a chunk border
+void drawMapMesh(gameWorld* w, int x0, int x1){
+	PROFILE_FUNCTION();
+	float playerX = getXpos(w->player);
+	meshFrame.clear();
+	for(int x = x0; x < x1; x += meshChunkColumns){
+		meshChunk* c = meshChunkGet(w, x);
+		meshFrame.grow(c->verts.len());
+		Vertex* out = meshFrame.ptr() + meshFrame.len();
+		for(i64 v = 0; v < c->verts.len(); v++){
+			Vertex vert = c->verts[v];
+			float tileX = x + floorf(vert.x);
+			vert.x += x - w->mapWarp;
+			vert.a = 255 - 100*(fabsf(tileX - playerX)/100.0f);	// the fade of drawMap's cubes
+			out[v] = vert;
+		}
+		meshFrame._len += c->verts.len();
+	}
+	vertex_array_render(&meshFrame);
+}
+
+void mapMeshDestroy(){
+	for(int i = 0; i < meshChunkCount; i++)
+		meshChunks[i].verts.destroy();
+	meshRects.destroy();
+	meshFrame.destroy();
+}
+
+#endif
@@ -0,0 +1,103 @@
+#define ATS_HEADLESS
+#include "ats/ats_tool.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include "ats/stb_image.h"
+
+//==========================PACK============================//
+//
+// pack [--out assets.pak] files...
+// pack --list packs...
+//
+// Builds an asset pack (see ASSET PACK in ats_tool.h) from files, every asset
+// is named by the path it was given as. .png files are decoded to RGBA8 here,
+// so the game uploads them without decoding, everything else goes in as is.
+// --list prints the toc of existing packs instead.
+
+bool hasExtension(const char* path, const char* ext){
+	size_t n = strlen(path), e = strlen(ext);
+	return n >= e && !strcmp(path + n - e, ext);
+}
+
+bool addFile(Asset_Pack_Builder* builder, const char* path){
+	if(strlen(path) >= sizeof(((Asset_Entry*)0)->name)){
+		fprintf(stderr, "name too long: %s\n", path);
+		return false;
+	}
+	if(hasExtension(path, ".png")){
+		int w, h, channels;
+		u8* pixels = stbi_load(path, &w, &h, &channels, 4);
+		if(!pixels){
+			fprintf(stderr, "could not decode %s\n", path);
+			return false;
+		}
+		asset_pack_add(builder, path, ASSET_TEXTURE, ASSET_FORMAT_RGBA8, w, h, pixels, (u64)w * h * 4);
+		stbi_image_free(pixels);
+		return true;
+	}
+	File_Map file;
+	if(!file_map_read(&file, path)){
+		fprintf(stderr, "could not read %s\n", path);
+		return false;
+	}
+	asset_pack_add(builder, path, ASSET_BLOB, ASSET_FORMAT_NONE, 0, 0, file.data, file.size);
+	file_unmap(&file);
+	return true;
+}
+
+int listPack(const char* path){
+	Asset_Pack pack;
+	if(!asset_pack_open(&pack, path)){
+		fprintf(stderr, "%s is not an asset pack\n", path);
+		return 1;
+	}
+	for(u32 i = 0; i < pack.count; i++){
+		const Asset_Entry* e = &pack.toc[i];
+		if(e->type == ASSET_TEXTURE)
+			printf("%-48s texture %ux%u  %llu bytes\n", e->name, e->width, e->height, (unsigned long long)e->size);
+		else
+			printf("%-48s blob  %llu bytes\n", e->name, (unsigned long long)e->size);
+	}
+	asset_pack_close(&pack);
+	return 0;
+}
+
+int main(int argc, char** argv){
+	const char* out = "assets.pak";
+	bool list = false;
+	Array<const char*> files = {};
+
+	for(int i = 1; i < argc; i++){
+		if(!strcmp(argv[i], "--out") && i + 1 < argc) out = argv[++i];
+		else if(!strcmp(argv[i], "--list")) list = true;
+		else if(argv[i][0] == '-'){
+			fprintf(stderr, "usage: %s [--out assets.pak] files...\n       %s --list packs...\n", argv[0], argv[0]);
+			return 2;
+		}
+		else
+			files.add(argv[i]);
+	}
+
+	int result = 0;
+	if(list){
+		for(int i = 0; i < files.len(); i++)
+			result |= listPack(files[i]);
+		files.destroy();
+		return result;
+	}
+
+	Asset_Pack_Builder builder = {};
+	for(int i = 0; i < files.len() && !result; i++)
+		if(!addFile(&builder, files[i]))
+			result = 1;
+	if(!result && !asset_pack_write(&builder, out)){
+		fprintf(stderr, "could not write %s (or two files have the same name)\n", out);
+		result = 1;
+	}
+	if(!result)
+		printf("%s: %lld assets, %lld bytes of data\n", out, (long long)files.len(), (long long)builder.data.len());
+	asset_pack_builder_destroy(&builder);
+	files.destroy();
+	return result;
+}
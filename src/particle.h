@@ -6,23 +6,6 @@
 float NR_OFF	=	20/10;
 float ACC 		=	10;
 
-struct particle{
-	v2 pos;
-	v2 vel;
-	v2 acc;
-	float zpos;
-	float zvel;
-	float r;
-	float life;
-	float delay;
-	int red;
-	int green;
-	int blue;
-	float alpha;
-};
-
-Array<particle> particles;
-
 particle createParticle(v2 pos, v2 vel, v2 acc, 
 						float zpos, float zvel,
 						float r, float life, float delay, 
@@ -48,6 +31,82 @@ particle createParticle(v2 pos, v2 vel, v2 acc,
 	return par;
 }
 
+//==========================COMMANDS=======================//
+
+// spawns and removals are only recorded while a phase runs and get applied
+// together in commitParticles, so nothing moves under a loop over particles.
+// Particle handles resolve to the index in particles, spawned but not yet
+// committed particles are particlePending
+
+#define particlePending 0xffffffffu
+
+Handle spawnParticle(gameWorld* w, const particle& par){
+	Handle id = w->particleHandles.acquire(particlePending);
+	w->particleSpawns.add(par);
+	w->particleSpawnIds.add(id);
+	return id;
+}
+
+void destroyParticle(gameWorld* w, int i){
+	w->particleDeaths.add(i);
+}
+
+// NULL for stale handles and for particles that are not committed yet
+particle* getParticle(gameWorld* w, Handle id){
+	if(!w->particleHandles.valid(id) || w->particleHandles.get(id) == particlePending)
+		return NULL;
+	return w->particles.get(w->particleHandles.get(id));
+}
+
+// removals first (the recorded indices are into the current array), one
+// order-keeping compaction pass, then all spawns appended in one copy
+void commitParticles(gameWorld* w){
+	PROFILE_FUNCTION();
+	if(w->particleDeaths.len()){
+		int n = w->particles.len();
+		w->particleKeep.resize(n);
+		memset(w->particleKeep.ptr(), 1, n);
+		for(int i = 0; i < w->particleDeaths.len(); i++)
+			w->particleKeep[w->particleDeaths[i]] = 0;
+		int k = 0;
+		for(int i = 0; i < n; i++){
+			if(!w->particleKeep[i]){
+				w->particleHandles.release(w->particleIds[i]);
+				continue;
+			}
+			if(k != i){
+				w->particles[k] = w->particles[i];
+				w->particleIds[k] = w->particleIds[i];
+				w->particleHandles.set(w->particleIds[k], k);
+			}
+			k++;
+		}
+		w->particles.resize(k);
+		w->particleIds.resize(k);
+		w->particleDeaths.clear();
+	}
+	if(w->particleSpawns.len()){
+		int n = w->particles.len();
+		int m = w->particleSpawns.len();
+		w->particles.resize(n + m);
+		w->particleIds.resize(n + m);
+		memcpy(w->particles.get(n), w->particleSpawns.ptr(), m * sizeof(particle));
+		memcpy(w->particleIds.get(n), w->particleSpawnIds.ptr(), m * sizeof(Handle));
+		for(int i = 0; i < m; i++)
+			w->particleHandles.set(w->particleSpawnIds[i], n + i);
+		w->particleSpawns.clear();
+		w->particleSpawnIds.clear();
+	}
+}
+
+void clearParticles(gameWorld* w){
+	commitParticles(w);
+	for(int i = 0; i < w->particleIds.len(); i++)
+		w->particleHandles.release(w->particleIds[i]);
+	w->particles.clear();
+	w->particleIds.clear();
+}
+
 float particleXPos(particle* par){
 	return par->pos.x;
 }
@@ -88,11 +147,11 @@ int particleBlue(particle* par){
 	return par->blue;
 }
 
-void singleParticle(v2 pos, v2 vel, v2 acc,
+void singleParticle(gameWorld* w, v2 pos, v2 vel, v2 acc,
 					float zpos, float zvel,
 					float r, float life, float delay,
 					int red, int green, int blue, float alpha){
-	particles.add(
+	spawnParticle(w,
 				createParticle(
 					pos, vel, acc,
 					zpos, zvel,
@@ -101,67 +160,68 @@ void singleParticle(v2 pos, v2 vel, v2 acc,
 					));
 }
 
-void flashRainbow(int amount, float life, float intensity){
+void flashRainbow(gameWorld* w, int amount, float life, float intensity){
 	for(int i = 0; i < amount; i++){
-		particles.add(
+		spawnParticle(w,
 		createParticle(
-			{randf(70.0f, 120.0f), randf(1.0f, 39.0f)}, {0, 0}, {0, 0},
+			{randf(&w->rnd, 70.0f, 120.0f), randf(&w->rnd, 1.0f, 39.0f)}, {0, 0}, {0, 0},
 			2.0f, 1.0f,
-			randf(1.0f, 2.0f), life/randf(1.0f, 2.0f), randf(0, life),
-			randi(0, 255), randi(0, 255), randi(0, 255), intensity
+			randf(&w->rnd, 1.0f, 2.0f), life/randf(&w->rnd, 1.0f, 2.0f), randf(&w->rnd, 0, life),
+			randi(&w->rnd, 0, 255), randi(&w->rnd, 0, 255), randi(&w->rnd, 0, 255), intensity
 			));
 	}
 }
 
-void flashPurple(int amount, float life, float intensity){
+void flashPurple(gameWorld* w, int amount, float life, float intensity){
 	for(int i = 0; i < amount; i++){
-		particles.add(
+		spawnParticle(w,
 		createParticle(
-			{randf(40.0f, 100.0f), randf(1.0f, 39.0f)}, {0, 0}, {0, 0},
+			{randf(&w->rnd, 40.0f, 100.0f), randf(&w->rnd, 1.0f, 39.0f)}, {0, 0}, {0, 0},
 			2.0f, 1.0f,
-			randf(0.3f, 1.2f), life/randf(1.0f, 2.0f), randf(0, life),
-			randi(100, 140), 50, randi(190, 240), intensity
+			randf(&w->rnd, 0.3f, 1.2f), life/randf(&w->rnd, 1.0f, 2.0f), randf(&w->rnd, 0, life),
+			randi(&w->rnd, 100, 140), 50, randi(&w->rnd, 190, 240), intensity
 			));
 	}
 }
 
-void flashRed(int amount, float life, float intensity){
+void flashRed(gameWorld* w, int amount, float life, float intensity){
 	for(int i = 0; i < amount; i++){
-		particles.add(
+		spawnParticle(w,
 		createParticle(
-			{randf(5.0f, 60.0f), randf(1.0f, 39.0f)}, {0, 0}, {0, 0},
+			{randf(&w->rnd, 5.0f, 60.0f), randf(&w->rnd, 1.0f, 39.0f)}, {0, 0}, {0, 0},
 			2.0f, 1.0f,
-			randf(0.5f, 1.0f), life/randf(1.0f, 2.0f), randf(0, life),
-			randi(200, 255), 0, randi(0, 50), intensity
+			randf(&w->rnd, 0.5f, 1.0f), life/randf(&w->rnd, 1.0f, 2.0f), randf(&w->rnd, 0, life),
+			randi(&w->rnd, 200, 255), 0, randi(&w->rnd, 0, 50), intensity
 			));
 	}
 }
 
-void systemGlitch(){
+void systemGlitch(gameWorld* w){
 	for(int i = 0; i < 20; i++){
-		particles.add(
+		spawnParticle(w,
 			createParticle(
-				{randf(60.0f, 120.0f), randf(5.0f, 35.0f)}, {0, 0}, {0, 0},
+				{randf(&w->rnd, 60.0f, 120.0f), randf(&w->rnd, 5.0f, 35.0f)}, {0, 0}, {0, 0},
 				2.0f, 1.0f,
-				randf(0.3f, 0.7f), randf(0.1f, 0.3f), randf(0.0f, 0.1f),
-				255, 255, 255, randf(0.4f, 0.6f)
+				randf(&w->rnd, 0.3f, 0.7f), randf(&w->rnd, 0.1f, 0.3f), randf(&w->rnd, 0.0f, 0.1f),
+				255, 255, 255, randf(&w->rnd, 0.4f, 0.6f)
 				));
 	}
 }
 
-void starfall(float x, float y){
+void starfall(gameWorld* w, float x, float y){
 	for(int i = 0; i < 2; i++){
-		particles.add(
+		spawnParticle(w,
 			createParticle(
-				{x+0.5f, y+0.5f}, {randf(-5.0f, 40.0f), randf(-25.0f, 25.0f)}, {0, 0},
+				{x+0.5f, y+0.5f}, {randf(&w->rnd, -5.0f, 40.0f), randf(&w->rnd, -25.0f, 25.0f)}, {0, 0},
 				0.3f, 0.0f,
-				randf(0.05f, 0.1f), randf(0.3f, 0.6f), randf(0.0f, 0.01f),
-				randi(150, 255), randi(150, 255), randi(150, 255), randf(0.4f, 0.7f)
+				randf(&w->rnd, 0.05f, 0.1f), randf(&w->rnd, 0.3f, 0.6f), randf(&w->rnd, 0.0f, 0.01f),
+				randi(&w->rnd, 150, 255), randi(&w->rnd, 150, 255), randi(&w->rnd, 150, 255), randf(&w->rnd, 0.4f, 0.7f)
 				));
 	}
 }
 
-void restartAnimation(float life, float intensity){
+void restartAnimation(gameWorld* w, float life, float intensity){
+	PROFILE_FUNCTION();
 	if(life > 1.2f)
 		life = 1.2f;
 	else if(life < 0.5f)
@@ -172,82 +232,82 @@ void restartAnimation(float life, float intensity){
 		intensity = 0.1f;
 
 	for(int i = 0; i < 20; i++){
-		particles.add(
+		spawnParticle(w,
 		createParticle(
-			{randf(5.0f, 75.0f), randf(5.0f, 35.0f)}, {0, 0}, {0, 0},
+			{randf(&w->rnd, 5.0f, 75.0f), randf(&w->rnd, 5.0f, 35.0f)}, {0, 0}, {0, 0},
 			2.0f, 1.0f,
-			randf(5.0f, 15.0f), life/randf(1.0f, 2.0f), randf(0.0f, life),
+			randf(&w->rnd, 5.0f, 15.0f), life/randf(&w->rnd, 1.0f, 2.0f), randf(&w->rnd, 0.0f, life),
 			255, 255, 255, intensity
 			));
 	}
 	for(int i = 0; i < 10; i++){
-		particles.add(
+		spawnParticle(w,
 		createParticle(
-			{randf(5.0f, 75.0f), randf(5.0f, 35.0f)}, {0, 0}, {0, 0},
+			{randf(&w->rnd, 5.0f, 75.0f), randf(&w->rnd, 5.0f, 35.0f)}, {0, 0}, {0, 0},
 			2.0f, 1.0f,
-			randf(2.0f, 8.0f), life/randf(1.0f, 2.0f), randf(life/2.0f, life*2),
-			randi(150, 200), randi(150, 200), randi(150, 200), intensity*0.8f
+			randf(&w->rnd, 2.0f, 8.0f), life/randf(&w->rnd, 1.0f, 2.0f), randf(&w->rnd, life/2.0f, life*2),
+			randi(&w->rnd, 150, 200), randi(&w->rnd, 150, 200), randi(&w->rnd, 150, 200), intensity*0.8f
 			));
 	}
 	for(int i = 0; i < 20; i++){
-		particles.add(
+		spawnParticle(w,
 		createParticle(
-			{randf(1.0f, 79.0f), randf(1.0f, 39.0f)}, {0, 0}, {0, 0},
+			{randf(&w->rnd, 1.0f, 79.0f), randf(&w->rnd, 1.0f, 39.0f)}, {0, 0}, {0, 0},
 			2.0f, 1.0f,
-			randf(1.0f, 2.0f), life/randf(1.0f, 2.0f), randf(life/2.0f, life*2),
-			randi(100, 140), 50, randi(190, 240), intensity*0.5f
+			randf(&w->rnd, 1.0f, 2.0f), life/randf(&w->rnd, 1.0f, 2.0f), randf(&w->rnd, life/2.0f, life*2),
+			randi(&w->rnd, 100, 140), 50, randi(&w->rnd, 190, 240), intensity*0.5f
 			));
 	}
 	for(int i = 0; i < 20; i++){
-		particles.add(
+		spawnParticle(w,
 		createParticle(
-			{randf(1.0f, 79.0f), randf(1.0f, 39.0f)}, {0, 0}, {0, 0},
+			{randf(&w->rnd, 1.0f, 79.0f), randf(&w->rnd, 1.0f, 39.0f)}, {0, 0}, {0, 0},
 			2.0f, 1.0f,
-			randf(0.5f, 1.0f), life/randf(1.0f, 3.0f), randf(life*1.5f, life*3.0f),
-			randi(200, 255), 0, randi(0, 50), intensity*0.5f
+			randf(&w->rnd, 0.5f, 1.0f), life/randf(&w->rnd, 1.0f, 3.0f), randf(&w->rnd, life*1.5f, life*3.0f),
+			randi(&w->rnd, 200, 255), 0, randi(&w->rnd, 0, 50), intensity*0.5f
 			));
 	}
 }
 
-void thrust(v2 pos, float zpos, float zvel,
+void thrust(gameWorld* w, v2 pos, float zpos, float zvel,
 			float r, float life, float delay){
-	particles.add(
+	spawnParticle(w,
 			createParticle(
-				pos, {randf(-50.0f, -15.0f), randf(-10.0f, 10.0f)}, {0, 0},
+				pos, {randf(&w->rnd, -50.0f, -15.0f), randf(&w->rnd, -10.0f, 10.0f)}, {0, 0},
 				zpos, zvel,
 				r, life, delay,
-				randi(200, 255), 0, randi(0, 50), 0.5f
+				randi(&w->rnd, 200, 255), 0, randi(&w->rnd, 0, 50), 0.5f
 				));
 }
 
-void splitBlock(int x, int y){
-	/*particles.add(
+void splitBlock(gameWorld* w, int x, int y){
+	/*spawnParticle(w,
 				createParticle(
-					{(float)x+0.5f, (float)y+0.5f}, {((float)randi(0,100)-50.0f)/100.0f, ((float)randi(0,100)-50)/10.0f}, {0, 0},
-					0.1f, randf(5.0f, 10.0f),
-					randf(0.4f, 0.5f), randf(0.4f, 1.2f), 0,
-					randi(100, 140), 50, randi(190, 240), randf(0.5f, 0.7f)
+					{(float)x+0.5f, (float)y+0.5f}, {((float)randi(&w->rnd, 0,100)-50.0f)/100.0f, ((float)randi(&w->rnd, 0,100)-50)/10.0f}, {0, 0},
+					0.1f, randf(&w->rnd, 5.0f, 10.0f),
+					randf(&w->rnd, 0.4f, 0.5f), randf(&w->rnd, 0.4f, 1.2f), 0,
+					randi(&w->rnd, 100, 140), 50, randi(&w->rnd, 190, 240), randf(&w->rnd, 0.5f, 0.7f)
 					));*/
 	for(int xp = 0; xp < NR_OFF/3; xp++){
 		for(int yp = 0; yp < NR_OFF/3; yp++){
 			float posx = ((float)x)+xp/NR_OFF;
 			float posy = ((float)y)+yp/NR_OFF;
-			float accx = ((((float)xp)-NR_OFF/2.0f)*ACC)*((float)randi(250,400))/100.0f;
-			float accy = ((((float)yp)-NR_OFF/2.0f)*ACC)*((float)randi(250,400))/100.0f;
+			float accx = ((((float)xp)-NR_OFF/2.0f)*ACC)*((float)randi(&w->rnd, 250,400))/100.0f;
+			float accy = ((((float)yp)-NR_OFF/2.0f)*ACC)*((float)randi(&w->rnd, 250,400))/100.0f;
 
-			particles.add(
+			spawnParticle(w,
 				createParticle(
 					{posx, posy}, {0, 0}, {accx, accy},
-					randf(-1.5f, 0.5f), randf(2.0f, 40.0f),
-					randf(0.1f, 0.25f), randf(0.3f, 1.3f), 0,
-					randi(80, 160), 50, randi(180, 250), randf(0.2f, 0.6f)
+					randf(&w->rnd, -1.5f, 0.5f), randf(&w->rnd, 2.0f, 40.0f),
+					randf(&w->rnd, 0.1f, 0.25f), randf(&w->rnd, 0.3f, 1.3f), 0,
+					randi(&w->rnd, 80, 160), 50, randi(&w->rnd, 180, 250), randf(&w->rnd, 0.2f, 0.6f)
 					));
 		}
 	}
 }
 
-void starEffect(float x, float y, int red, int green, int blue){
-	particles.add(
+void starEffect(gameWorld* w, float x, float y, int red, int green, int blue){
+	spawnParticle(w,
 		createParticle(
 			{x, y}, {0, 0}, {0, 0},
 			0.5f, 2.0f,
@@ -256,36 +316,36 @@ void starEffect(float x, float y, int red, int green, int blue){
 			));
 }
 
-void collectEffect(float x, float y, int red, int green, int blue){
-	particles.add(
+void collectEffect(gameWorld* w, float x, float y, int red, int green, int blue){
+	spawnParticle(w,
 		createParticle(
 			{x, y}, {0, 0}, {0, 0},
 			0.5f, 2.0f,
 			0.6f, 0.5f, 0.0f,
 			red, green, blue, 0.5
 			));
-	particles.add(
+	spawnParticle(w,
 		createParticle(
 			{x-0.5f, y-0.5f}, {-2, -2}, {0, 0},
 			0.5f, 0.0f,
 			0.3f, 0.4f, 0.2f,
 			red, green, blue, 0.5
 			));
-	particles.add(
+	spawnParticle(w,
 		createParticle(
 			{x-0.5f, y+0.5f}, {-2, 2}, {0, 0},
 			0.5f, 0.0f,
 			0.3f, 0.4f, 0.2f,
 			red, green, blue, 0.5
 			));
-	particles.add(
+	spawnParticle(w,
 		createParticle(
 			{x+0.5f, y-0.5f}, {2, -2}, {0, 0},
 			0.5f, 0.0f,
 			0.3f, 0.4f, 0.2f,
 			red, green, blue, 0.5
 			));
-	particles.add(
+	spawnParticle(w,
 		createParticle(
 			{x+0.5f, y+0.5f}, {2, 2}, {0, 0},
 			0.5f, 0.0f,
@@ -294,9 +354,11 @@ void collectEffect(float x, float y, int red, int green, int blue){
 			));
 }
 
-void updateParticles(float t, float cOffset){
-	for(int i = 0; i < particles.len(); i++){
-		particle* par = particles.get(i);
+void updateParticles(gameWorld* w, float t, float cOffset){
+	PROFILE_FUNCTION();
+	commitParticles(w); // whatever the earlier phases of this frame spawned
+	for(int i = 0; i < w->particles.len(); i++){
+		particle* par = w->particles.get(i);
 		par->pos.x -= cOffset;
 		if(par->delay <= 0){
 			par->life -= t;
@@ -307,13 +369,14 @@ void updateParticles(float t, float cOffset){
 				par->zpos += par->zvel * t;
 				par->zvel *= 0.9f;
 			} else 
-					particles.rem(i--);
+					destroyParticle(w, i);
 		} else {
 			par->delay -= t;
 			if(par->delay < 0)
 				par->life += par->delay;
 		}
 	}
+	commitParticles(w);
 }
 
 
@@ -0,0 +1,105 @@
+#ifndef replay_h
+#define replay_h
+
+//==========================INPUT===========================//
+
+// everything the simulation reads from the player in one frame. The game fills
+// it from the window, the headless sim from a replay, so both step the same way.
+#define inputUp		(1 << 0)
+#define inputDown	(1 << 1)
+#define inputLeft	(1 << 2)
+#define inputRight	(1 << 3)
+#define inputReset	(1 << 4)
+
+struct frameInput{
+	float dt;
+	u8 held;	// input* bits of the keys that are down
+	u8 shots;	// SPACE presses this frame
+	u8 pad[2];
+};
+
+//==========================REPLAY==========================//
+
+// replay file: replayHeader followed by header.frames frameInputs. The rng
+// state at the start is stored too, so a replay does not depend on the seed
+// the binary happens to start with.
+#define replayMagic		0x50524753	// "SGRP"
+#define replayVersion	2	// 2: new maps roll their items per column
+
+struct replayHeader{
+	u32 magic;
+	u32 version;
+	u32 frames;
+	Rnd_Gen rnd;
+};
+
+Array<frameInput> replayFrames;
+Rnd_Gen replayRnd;
+int replayCursor;
+bool replayPlaying;
+const char* replayRecordPath;
+
+void replayRecord(const frameInput* in){
+	replayFrames.add(*in);
+}
+
+// false at the end of the replay
+bool replayNext(frameInput* in){
+	if(replayCursor >= replayFrames.len())
+		return false;
+	*in = replayFrames[replayCursor++];
+	return true;
+}
+
+// scripted input for when there is no recorded replay: weaves up and down
+// and fires every half second, at a fixed 60 fps
+void replayBot(int frames){
+	Rnd_Gen rnd = rnd_stream(7);
+	replayFrames.clear();
+	replayRnd = default_rnd;
+	replayCursor = 0;
+	for(int i = 0; i < frames; i++){
+		frameInput in = {};
+		in.dt = 1.0f/60.0f;
+		int phase = (i / 45) % 4;
+		if(phase == 0) in.held |= inputUp;
+		if(phase == 2) in.held |= inputDown;
+		if(randf(&rnd, 0.0f, 1.0f) > 0.7f) in.held |= inputRight;
+		if(i % 30 == 0) in.shots = 1;
+		replayFrames.add(in);
+	}
+}
+
+bool replaySave(const char* path){
+	FILE* fp = fopen(path, "wb");
+	if(!fp)
+		return false;
+	replayHeader header = {replayMagic, replayVersion, (u32)replayFrames.len(), replayRnd};
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+			(u32)fwrite(replayFrames.ptr(), sizeof(frameInput), replayFrames.len(), fp) == header.frames;
+	fclose(fp);
+	return ok;
+}
+
+bool replayLoad(const char* path){
+	FILE* fp = fopen(path, "rb");
+	if(!fp)
+		return false;
+	replayHeader header;
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+			header.magic == replayMagic &&
+			header.version == replayVersion;
+	if(ok){
+		replayFrames.resize(header.frames);
+		ok = (u32)fread(replayFrames.ptr(), sizeof(frameInput), header.frames, fp) == header.frames;
+		replayRnd = header.rnd;
+		replayCursor = 0;
+	}
+	fclose(fp);
+	if(!ok)
+		replayFrames.clear();
+	return ok;
+}
+
+//==========================REPLAY END======================//
+#endif
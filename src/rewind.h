@@ -0,0 +1,337 @@
+#ifndef rewind_h
+#define rewind_h
+
+//==========================REWIND==========================//
+
+// History of the last ticks to step back through. Every tick is a snapshot
+// image, but only keyframes (every rewindKeyInterval ticks) are stored whole,
+// the ticks in between as the difference to the tick before them.
+//
+// Images are compared piece by piece: the fixed part at the start, then every
+// array on its own, so one particle more only changes the particle array and
+// not the offset of everything behind it. A piece is xor'ed with the same piece
+// of the previous image, over the longer of both (past its end a piece reads as
+// 0), and packed in groups of 8 bytes: a mask of the bytes that changed, then
+// only those bytes. An unchanged group is followed by the count of unchanged
+// groups after it, so an untouched tile row costs 2 bytes. Keyframes are packed
+// the same way, against nothing.
+//
+// Since a delta is the xor over both pieces, it takes a tick back to the one
+// before it as well as forward: rewindStepBack only undoes the last tick's delta,
+// rewindSeek unpacks forward from the keyframe.
+//
+// Whole keyframe groups are dropped from the front once the rest still covers
+// rewindTicks, or the history holds more than rewindBudget bytes.
+//
+// There is one history, of the world on the screen (or the sim's): every
+// rewindRecord, rewindSeek and rewindStepBack until the next rewindClear has to get the
+// same world.
+
+#define rewindKeyInterval	120
+#define rewindTicks			(60*60)
+#define rewindBudget		(32 << 20)
+
+struct rewindGroup{
+	int first;			// tick of the keyframe
+	Array<u8> data;		// keyframe, then the delta of every tick after it
+	Array<i64> ends;	// end of every tick in data
+};
+
+Array<rewindGroup> rewindGroups;
+rewindGroup rewindSpare;	// buffers of the last dropped group, reused for the next one
+Array<i64> rewindGaps;		// bytes before, between and after the arrays, the same in every image
+int rewindNext;				// tick the next rewindRecord stores
+Array<u8> rewindPrev;		// image of the last stored tick
+Array<u8> rewindImage;
+Array<u8> rewindScratch;
+
+// k bytes at i of a buffer of len bytes, what is past the end reads as 0
+u64 rewindLoad(const u8* p, i64 i, i64 k, i64 len){
+	u64 v = 0;
+	if(i + 8 <= len && k == 8)
+		memcpy(&v, p + i, 8);
+	else if(i < len)
+		memcpy(&v, p + i, len - i < k ? len - i : k);
+	return v;
+}
+
+// bit j set when byte j of x is not 0
+u8 rewindByteMask(u64 x){
+	const u64 low = 0x7f7f7f7f7f7f7f7full;
+	u64 high = (((x & low) + low) | x) & ~low;
+	return (u8)(((high >> 7) * 0x0102040810204080ull) >> 56);
+}
+
+u8* rewindPackGroup(u8* out, u64 x, i64 k){
+	*out++ = rewindByteMask(x);
+	for(int j = 0; j < k; j++){
+		u8 byte = (u8)(x >> (8*j));
+		*out = byte;
+		out += byte != 0;
+	}
+	return out;
+}
+
+// packs the n bytes of cur against the m bytes of prev, writes len + len/8 + 2 bytes at most
+// (len the longer of both)
+u8* rewindPack(u8* out, const u8* cur, i64 n, const u8* prev, i64 m){
+	i64 len = n > m ? n : m;
+	// whole groups on both sides first, that is almost everything
+	i64 both = (n < m ? n : m) & ~(i64)7;
+	i64 i = 0;
+	while(i < both){
+		u64 a, b;
+		memcpy(&a, cur + i, 8);
+		memcpy(&b, prev + i, 8);
+		i += 8;
+		if(a != b){
+			out = rewindPackGroup(out, a ^ b, 8);
+			continue;
+		}
+		int run = 0;
+		while(run < 255 && i < both && !memcmp(cur + i, prev + i, 8)){
+			run++;
+			i += 8;
+		}
+		*out++ = 0;
+		*out++ = (u8)run;
+	}
+	while(i < len){
+		i64 k = len - i < 8 ? len - i : 8;
+		u64 x = rewindLoad(cur, i, k, n) ^ rewindLoad(prev, i, k, m);
+		i += k;
+		if(x){
+			out = rewindPackGroup(out, x, k);
+			continue;
+		}
+		int run = 0;
+		while(run < 255 && i + 8 <= len && rewindLoad(cur, i, 8, n) == rewindLoad(prev, i, 8, m)){
+			run++;
+			i += 8;
+		}
+		*out++ = 0;
+		*out++ = (u8)run;
+	}
+	return out;
+}
+
+// the n bytes of cur from a piece rewindPack packed against the m bytes of prev, or just as
+// well the bytes of prev from the same piece packed against cur
+const u8* rewindUnpack(const u8* in, u8* cur, i64 n, const u8* prev, i64 m){
+	i64 len = n > m ? n : m;
+	i64 i = 0;
+	while(i < len){
+		u8 mask = *in++;
+		if(!mask){
+			i64 end = i + 8 * (1 + (i64)*in++);
+			if(end > len)
+				end = len;
+			i64 to = end < n ? end : n;
+			i64 same = m < to ? m : to;
+			if(same > i)
+				memcpy(cur + i, prev + i, same - i);
+			else
+				same = i;
+			if(to > same)
+				memset(cur + same, 0, to - same);
+			i = end;
+			continue;
+		}
+		if(i + 8 <= n && i + 8 <= m){
+			u64 x = 0, b;
+			for(u32 bits = mask; bits; bits &= bits - 1)
+				x |= (u64)*in++ << (8*__builtin_ctz(bits));
+			memcpy(&b, prev + i, 8);
+			b ^= x;
+			memcpy(cur + i, &b, 8);
+			i += 8;
+			continue;
+		}
+		i64 k = len - i < 8 ? len - i : 8;
+		for(int j = 0; j < k; j++, i++){
+			u8 byte = i < m ? prev[i] : 0;
+			if(mask & (1 << j))
+				byte ^= *in++;
+			if(i < n)
+				cur[i] = byte;
+		}
+	}
+	return in;
+}
+
+// padded bytes of the array whose {count, element size} header ends at data
+i64 rewindArrayBytes(const u8* data){
+	u32 head[2];
+	memcpy(head, data - sizeof(head), sizeof(head));
+	return ((i64)head[0] * head[1] + 7) & ~(i64)7;
+}
+
+// image has to be a capture of w
+void rewindLayout(gameWorld* w, const u8* image){
+	Array<i64> arrays = {};
+	snapshotStream s = {snapshotCount, NULL, 0, sizeof(snapshotHeader), true, &arrays};
+	snapshotFields(&s, w);
+	rewindGaps.clear();
+	i64 end = 0;
+	for(int i = 0; i < arrays.len(); i++){
+		rewindGaps.add(arrays[i] - end);
+		end = arrays[i] + rewindArrayBytes(image + arrays[i]);
+	}
+	rewindGaps.add(s.at - end);
+	arrays.destroy();
+}
+
+// appends cur packed against prev (of prevSize bytes), prev is NULL for a keyframe
+void rewindPackImage(Array<u8>* out, const u8* cur, i64 size, const u8* prev, i64 prevSize){
+	i64 start = out->len();
+	i64 both = size + prevSize;	// no piece packs more than the longer of its two sides
+	out->reserve(start + both + both/8 + 4*rewindGaps.len());
+	u8* at = out->ptr() + start;
+	i64 c = 0, p = 0;
+	for(int i = 0; i < rewindGaps.len(); i++){
+		i64 gap = rewindGaps[i];
+		at = rewindPack(at, cur + c, gap, prev ? prev + p : NULL, prev ? gap : 0);
+		c += gap;
+		p += gap;
+		if(i + 1 == rewindGaps.len())
+			break;
+		i64 cn = rewindArrayBytes(cur + c);
+		i64 pn = prev ? rewindArrayBytes(prev + p) : 0;
+		at = rewindPack(at, cur + c, cn, prev ? prev + p : NULL, pn);
+		c += cn;
+		p += pn;
+	}
+	out->resize(at - out->ptr());
+}
+
+// returns the end of the packed tick. With prev the tick after the packed one, out is the
+// one before it (the array sizes come from the headers out gets on the way).
+const u8* rewindUnpackImage(Array<u8>* out, const u8* in, const u8* prev){
+	i64 c = 0, p = 0;
+	for(int i = 0; i < rewindGaps.len(); i++){
+		i64 gap = rewindGaps[i];
+		out->resize(c + gap);
+		in = rewindUnpack(in, out->ptr() + c, gap, prev ? prev + p : NULL, prev ? gap : 0);
+		c += gap;
+		p += gap;
+		if(i + 1 == rewindGaps.len())
+			break;
+		i64 cn = rewindArrayBytes(out->ptr() + c);
+		i64 pn = prev ? rewindArrayBytes(prev + p) : 0;
+		out->resize(c + cn);
+		in = rewindUnpack(in, out->ptr() + c, cn, prev ? prev + p : NULL, pn);
+		c += cn;
+		p += pn;
+	}
+	return in;
+}
+
+i64 rewindBytes(){
+	i64 bytes = 0;
+	for(int i = 0; i < rewindGroups.len(); i++)
+		bytes += rewindGroups[i].data.len() + rewindGroups[i].ends.len() * sizeof(i64);
+	return bytes;
+}
+
+// oldest and newest tick in the history, first > last when it is empty
+int rewindFirst(){
+	return rewindGroups.len() ? rewindGroups[0].first : rewindNext;
+}
+
+int rewindLast(){
+	return rewindNext - 1;
+}
+
+void rewindDropGroup(int i){
+	rewindSpare.data.destroy();
+	rewindSpare.ends.destroy();
+	rewindSpare = rewindGroups[i];
+	rewindGroups.rem_ordered(i);
+}
+
+void rewindClear(){
+	while(rewindGroups.len())
+		rewindDropGroup(rewindGroups.len() - 1);
+	rewindNext = 0;
+}
+
+// stores w as the next tick, call it after every coreStep
+void rewindRecord(gameWorld* w){
+	PROFILE_FUNCTION();
+	snapshotCapture(w, &rewindImage);
+	if(!rewindGaps.len())
+		rewindLayout(w, rewindImage.ptr());
+
+	rewindGroup* g = rewindGroups.len() ? &rewindGroups[rewindGroups.len() - 1] : NULL;
+	if(!g || g->ends.len() >= rewindKeyInterval){
+		while(rewindGroups.len() > 1 &&
+				(rewindNext - rewindGroups[1].first >= rewindTicks || rewindBytes() > rewindBudget))
+			rewindDropGroup(0);
+		g = rewindGroups.create();
+		*g = rewindSpare;
+		rewindSpare = {};
+		g->first = rewindNext;
+		g->data.clear();
+		g->ends.clear();
+		rewindPackImage(&g->data, rewindImage.ptr(), rewindImage.len(), NULL, 0);
+	}
+	else
+		rewindPackImage(&g->data, rewindImage.ptr(), rewindImage.len(), rewindPrev.ptr(), rewindPrev.len());
+	g->ends.add(g->data.len());
+
+	std::swap(rewindPrev, rewindImage);
+	rewindNext++;
+}
+
+// back to the state right after tick, false when it is not in the history (any more).
+// The ticks after it are dropped, the next rewindRecord continues from there.
+bool rewindSeek(gameWorld* w, int tick){
+	PROFILE_FUNCTION();
+	int gi = rewindGroups.len() - 1;
+	while(gi >= 0 && rewindGroups[gi].first > tick)
+		gi--;
+	if(gi < 0 || tick > rewindLast())
+		return false;
+
+	rewindGroup* g = &rewindGroups[gi];
+	const u8* in = rewindUnpackImage(&rewindImage, g->data.ptr(), NULL);
+	for(int t = g->first; t < tick; t++){
+		in = rewindUnpackImage(&rewindScratch, in, rewindImage.ptr());
+		std::swap(rewindImage, rewindScratch);
+	}
+	if(!snapshotRestore(w, rewindImage.ptr(), rewindImage.len()))
+		return false;
+
+	int keep = tick - g->first + 1;
+	g->ends.resize(keep);
+	g->data.resize(g->ends[keep - 1]);
+	while(rewindGroups.len() > gi + 1)
+		rewindDropGroup(rewindGroups.len() - 1);
+	std::swap(rewindPrev, rewindImage);
+	rewindNext = tick + 1;
+	return true;
+}
+
+// rewindSeek(w, rewindLast() - 1) without unpacking from the keyframe: the last tick's delta
+// applied to its own image gives the tick before. Only the first tick of a group, whose
+// delta is its keyframe, still goes through rewindSeek.
+bool rewindStepBack(gameWorld* w){
+	PROFILE_FUNCTION();
+	rewindGroup* g = rewindGroups.len() ? &rewindGroups[rewindGroups.len() - 1] : NULL;
+	if(!g || g->ends.len() < 2)
+		return rewindSeek(w, rewindLast() - 1);
+
+	i64 k = g->ends.len();
+	rewindUnpackImage(&rewindImage, g->data.ptr() + g->ends[k - 2], rewindPrev.ptr());
+	if(!snapshotRestore(w, rewindImage.ptr(), rewindImage.len()))
+		return false;
+
+	g->ends.resize(k - 1);
+	g->data.resize(g->ends[k - 2]);
+	std::swap(rewindPrev, rewindImage);
+	rewindNext--;
+	return true;
+}
+
+//==========================REWIND END======================//
+#endif
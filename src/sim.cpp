@@ -0,0 +1,416 @@
+#define ATS_HEADLESS
+#define ATS_SOFTWARE_RENDER
+#include "core.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include "ats/stb_image.h"
+
+//==========================SIM=============================//
+//
+// sim [--replay file] [--bot frames] [--record file] [--repeat n] [--load snapshot] [--save snapshot] [--rewind]
+//     [--threads n]
+// sim --batch worlds [--threads n] [--ai] [--replay file] [--bot frames]
+// sim --render WxH [--capture dir] [--golden dir] [--every n] [--mesh] [--fov degrees] [--lod pixels]
+//            [--replay file] [--bot frames]
+//
+// Runs the game without a window as fast as it can: either the frames of a
+// replay recorded with `game --record file`, or a scripted bot. Prints the
+// time per frame and a hash of the final state, two runs of the same input
+// have to print the same hash. --load starts every run from a snapshot
+// instead of a new game, --save writes the final state. --rewind records the
+// rewind history every tick, prints its size and checks that stepping back a
+// tick at a time through the last quarter of it (rewindStepBack), and then
+// seeking to the middle of it (rewindSeek), and playing the rest again from
+// there ends in the same hash both times. New
+// maps are generated on --threads (all cores by default), the hash is the
+// same for any number of them.
+//
+// --batch plays that many independent games at once, spread over --threads
+// (all cores by default). Every game has its own seed and gets the replay's or
+// the bot's input, or with --ai is played by aiInput instead. Prints the frames
+// per second of the whole batch and a hash over all games, which has to be
+// the same for any number of threads.
+//
+// --render draws every frame of the first run with the software renderer,
+// exactly like the game would, on --threads (all cores by default), and prints
+// the render time per frame and a hash of every --every'th frame. --capture writes those frames to
+// dir/frame_00000.png and so on (a video of the replay with --every 1),
+// --golden compares them against the pngs of an earlier --capture and exits
+// with 1 when one of them is missing or a pixel differs. Frames are the same on
+// any cpu for builds without FP contraction (see soft_render.h), sim warns when
+// it was built with it. --mesh, --fov and --lod are the game's (see main.cpp). Built with
+// ATS_RENDER_TRACE (build.sh trace) it also takes --trace file.json and
+// --trace-summary frames, like the game.
+//
+// Built with ATS_PROFILE (build.sh profile) every mode takes --profile
+// file.json and writes the timeline of the run there at the end.
+
+u32 hashBytes(u32 h, const void* data, size_t size){
+	const u8* p = (const u8*)data;
+	for(size_t i = 0; i < size; i++)
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+// fnv-1a over everything a desync would show up in
+u32 simStateHash(gameWorld* w){
+	u32 h = 2166136261u;
+	h = hashBytes(h, &w->SCORE, sizeof(w->SCORE));
+	h = hashBytes(h, &w->counter, sizeof(w->counter));
+	h = hashBytes(h, &w->mapWarp, sizeof(w->mapWarp));
+	h = hashBytes(h, &w->rnd, sizeof(w->rnd));
+	h = hashBytes(h, w->map.tiles.ptr(), w->map.tiles.len() * sizeof(u32));
+	h = hashBytes(h, &w->player->pos, sizeof(w->player->pos));
+	h = hashBytes(h, &w->player->vel, sizeof(w->player->vel));
+	for(int type = 0; type < itemTypes; type++){
+		itemPool* p = &w->itemPools[type];
+		h = hashBytes(h, p->x.ptr(), itemPoolLen(p) * sizeof(float));
+		h = hashBytes(h, p->y.ptr(), itemPoolLen(p) * sizeof(float));
+	}
+	i64 n = w->particles.len();
+	h = hashBytes(h, &n, sizeof(n));
+	return h;
+}
+
+//==========================RENDER==========================//
+
+struct simRender{
+	int width;
+	int height;
+	int every;
+	const char* capture;
+	const char* golden;
+
+	Array<u8> rgb;
+	u32 hash;
+	int frames;		// drawn
+	int checked;	// hashed, written or compared
+	int mismatches;
+	double seconds;
+};
+
+// true when the compiler fuses a*b + c into one rounding (gcc's default with -march=native on a cpu
+// with FMA, build.sh turns it off): the frames and hashes of such a build only match its own kind.
+// (1 + 2^-12)^2 - (1 + 2^-11) is 0 in float, but 2^-24 when the square isn't rounded first.
+bool fpContracted(){
+	volatile float va = 1.0f + 0x1p-12f, vc = -(1.0f + 0x1p-11f);
+	float a = va, c = vc;
+	return a * a + c != 0.0f;
+}
+
+// pixels that differ from the png at path, -1 when it is missing or has another size
+i64 goldenDiff(const Array<u8>* rgb, int width, int height, const char* path){
+	int w, h, channels;
+	u8* pixels = stbi_load(path, &w, &h, &channels, 3);
+	if(!pixels)
+		return -1;
+	i64 diff = -1;
+	if(w == width && h == height){
+		diff = 0;
+		for(i64 i = 0; i < (i64)w * h; i++)
+			diff += memcmp(rgb->ptr() + 3*i, pixels + 3*i, 3) != 0;
+	}
+	stbi_image_free(pixels);
+	return diff;
+}
+
+void simRenderFrame(gameWorld* w, simRender* r, int frame){
+	double start = timer_now();
+	coreRender(w);
+	window_update(Window);
+	r->seconds += timer_now() - start;
+	r->frames++;
+
+	if(frame % r->every)
+		return;
+	soft_frame_rgb(Window, &r->rgb);
+	r->hash = hashBytes(r->hash, r->rgb.ptr(), r->rgb.len());
+	r->checked++;
+
+	char path[512];
+	if(r->capture){
+		snprintf(path, sizeof(path), "%s/frame_%05d.png", r->capture, frame);
+		if(!soft_frame_write_png(Window, path))
+			fprintf(stderr, "could not write %s\n", path);
+	}
+	if(r->golden){
+		snprintf(path, sizeof(path), "%s/frame_%05d.png", r->golden, frame);
+		i64 diff = goldenDiff(&r->rgb, r->width, r->height, path);
+		if(diff){
+			r->mismatches++;
+			if(diff < 0)
+				printf("frame %d: no golden image %s\n", frame, path);
+			else
+				printf("frame %d: %lld pixels differ from %s\n", frame, (long long)diff, path);
+		}
+	}
+}
+
+//==========================RENDER END======================//
+
+//==========================BATCH===========================//
+
+// steers into the open row nearest to the player a few columns ahead, keeps
+// away from the lava on the left and fires at blocks right in front of it
+frameInput aiInput(gameWorld* w, float dt){
+	frameInput in = {};
+	in.dt = dt;
+	gameObject* player = w->player;
+	int px = (int)getXpos(player);
+	int py = (int)getYpos(player);
+
+	int target = py;
+	for(int d = 0; d < ytiles; d++){
+		int up = py + d, down = py - d;
+		bool open = false;
+		for(int side = 0; side < 2 && !open; side++){
+			int y = side ? down : up;
+			if(y < 2 || y > ytiles - 3)
+				continue;
+			open = true;
+			for(int x = px + 1; x <= px + 6; x++)
+				if(tileType(w, x, y) == BLOCK)
+					open = false;
+			if(open)
+				target = y;
+		}
+		if(open)
+			break;
+	}
+	if(target > py) in.held |= inputLeft;
+	if(target < py) in.held |= inputRight;
+	if(px < 30) in.held |= inputUp;
+	if(px > 70) in.held |= inputDown;
+	if(tileType(w, px + 2, py) == BLOCK && w->counter % 8 == 0)
+		in.shots = 1;
+	return in;
+}
+
+struct batchGame{
+	u32 hash;
+	int score;	// best of the game
+};
+
+// one game of the batch from start to end, on whatever worker picks it up
+void playBatchGame(int index, bool ai, batchGame* out){
+	PROFILE_FUNCTION();
+	gameWorld* w = worldCreate();
+	w->streamMap = false;	// the batch already keeps every core busy
+	w->rnd = rnd_stream((u32)index);
+	coreInitState(w);
+	for(int f = 0; f < replayFrames.len(); f++){
+		frameInput in = ai ? aiInput(w, replayFrames[f].dt) : replayFrames[f];
+		coreStep(w, &in);
+	}
+	out->hash = simStateHash(w);
+	out->score = w->BEST_SCORE > w->SCORE ? w->BEST_SCORE : w->SCORE;
+	worldDestroy(w);
+}
+
+void runBatch(int games, int threads, bool ai){
+	Job_Pool pool = {};
+	job_pool_create(&pool, threads > 0 ? threads - 1 : -1);
+	Array<batchGame> results = {};
+	results.resize(games);
+
+	double start = timer_now();
+	job_pool_for(&pool, games, 1, [&](i64 i){ playBatchGame((int)i, ai, &results[i]); });
+	double elapsed = timer_now() - start;
+
+	u32 hash = 2166136261u;
+	i64 total = 0;
+	int best = 0;
+	for(int i = 0; i < games; i++){
+		hash = hashBytes(hash, &results[i].hash, sizeof(u32));
+		total += results[i].score;
+		if(results[i].score > best)
+			best = results[i].score;
+	}
+	double frames = (double)games * replayFrames.len();
+	printf("batch %d games x %lld frames on %d threads  %.3f s  %.0f frames/s  score avg %lld best %d  hash %08x\n",
+			games, (long long)replayFrames.len(), job_pool_threads(&pool), elapsed, frames / elapsed,
+			(long long)(total / games), best, hash);
+	results.destroy();
+	job_pool_destroy(&pool);
+}
+
+//==========================BATCH END=======================//
+
+int main(int argc, char** argv){
+	PROFILE_THREAD_NAME("main");
+	const char* replay = NULL;
+	int botFrames = 0;
+	int repeat = 1;
+	const char* load = NULL;
+	const char* save = NULL;
+	bool rewind = false;
+	int batch = 0;
+	int threads = 0;
+	bool ai = false;
+	simRender render = {};
+	render.every = 1;
+#ifdef ATS_RENDER_TRACE
+	const char* tracePath = NULL;
+	int traceSummary = 0;
+#endif
+
+	for(int i = 1; i < argc; i++){
+		if(!strcmp(argv[i], "--replay") && i + 1 < argc) replay = argv[++i];
+		else if(!strcmp(argv[i], "--bot") && i + 1 < argc) botFrames = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--record") && i + 1 < argc) replayRecordPath = argv[++i];
+		else if(!strcmp(argv[i], "--repeat") && i + 1 < argc) repeat = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--load") && i + 1 < argc) load = argv[++i];
+		else if(!strcmp(argv[i], "--save") && i + 1 < argc) save = argv[++i];
+		else if(!strcmp(argv[i], "--rewind")) rewind = true;
+		else if(!strcmp(argv[i], "--batch") && i + 1 < argc) batch = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--ai")) ai = true;
+		else if(!strcmp(argv[i], "--render") && i + 1 < argc) sscanf(argv[++i], "%dx%d", &render.width, &render.height);
+		else if(!strcmp(argv[i], "--capture") && i + 1 < argc) render.capture = argv[++i];
+		else if(!strcmp(argv[i], "--golden") && i + 1 < argc) render.golden = argv[++i];
+		else if(!strcmp(argv[i], "--every") && i + 1 < argc) render.every = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--mesh")) mapMeshed = true;
+		else if(!strcmp(argv[i], "--fov") && i + 1 < argc) cameraFov = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--lod") && i + 1 < argc) lodPixels = atof(argv[++i]);
+#ifdef ATS_PROFILE
+		else if(!strcmp(argv[i], "--profile") && i + 1 < argc) profilePath = argv[++i];
+#endif
+#ifdef ATS_RENDER_TRACE
+		else if(!strcmp(argv[i], "--trace") && i + 1 < argc) tracePath = argv[++i];
+		else if(!strcmp(argv[i], "--trace-summary") && i + 1 < argc) traceSummary = atoi(argv[++i]);
+#endif
+		else{
+			fprintf(stderr, "usage: %s [--replay file] [--bot frames] [--record file] [--repeat n]"
+					" [--load snapshot] [--save snapshot] [--rewind] [--threads n]\n"
+					"       %s --batch worlds [--threads n] [--ai] [--replay file] [--bot frames]\n"
+					"       %s --render WxH [--capture dir] [--golden dir] [--every n] [--mesh] [--fov degrees] [--lod pixels]\n"
+					"            [--replay file] [--bot frames]\n",
+					argv[0], argv[0], argv[0]);
+			return 2;
+		}
+	}
+
+	if(replay){
+		if(!replayLoad(replay)){
+			fprintf(stderr, "could not read replay %s\n", replay);
+			return 1;
+		}
+	}
+	else
+		replayBot(botFrames > 0 ? botFrames : 60*60);
+
+	quietScores = true;
+	if(batch > 0){
+		runBatch(batch, threads, ai);
+#ifdef ATS_PROFILE
+		if(profilePath && !profile_write(profilePath))
+			fprintf(stderr, "could not write profile %s\n", profilePath);
+#endif
+		return 0;
+	}
+
+	if((render.capture || render.golden) && fpContracted())
+		fprintf(stderr, "warning: built with FP contraction (no -ffp-contract=off), the frames only match those of builds like it\n");
+	if((render.capture || render.golden) && render.width <= 0){
+		render.width = 1280;
+		render.height = 720;
+	}
+	if(render.width > 0 && render.height > 0){
+		if(render.every < 1)
+			render.every = 1;
+		render.hash = 2166136261u;
+		Window = window_create(render.width, render.height, "sim", 0);
+		if(threads > 0){
+			job_pool_destroy(&Window->pool);
+			job_pool_create(&Window->pool, threads - 1);
+		}
+#ifdef ATS_RENDER_TRACE
+		if(!render_trace_open(tracePath, traceSummary)){
+			fprintf(stderr, "could not write %s\n", tracePath);
+			return 1;
+		}
+#endif
+	}
+
+	gameWorld* w = worldCreate();
+	job_pool_create(&mapJobPool, threads > 0 ? threads - 1 : -1);
+	w->mapJobs = &mapJobPool;
+	u32 hash = 0;
+	double best = 0;
+	for(int r = 0; r < repeat; r++){
+		w->rnd = replayRnd;
+		coreInitState(w);
+		rewindClear();
+		if(load && !snapshotLoad(w, load)){
+			fprintf(stderr, "could not load snapshot %s\n", load);
+			return 1;
+		}
+		double start = timer_now();
+		frameInput in;
+		replayCursor = 0;
+		while(replayNext(&in)){
+			coreStep(w, &in);
+			if(rewind)
+				rewindRecord(w);
+			if(Window && r == 0)
+				simRenderFrame(w, &render, replayCursor - 1);
+		}
+		double elapsed = timer_now() - start;
+		if(r == 0 || elapsed < best)
+			best = elapsed;
+		u32 h = simStateHash(w);
+		if(r > 0 && h != hash)
+			fprintf(stderr, "run %d desynced: %08x != %08x\n", r, h, hash);
+		hash = h;
+	}
+
+	i64 frames = replayFrames.len();
+	printf("frames %lld  best %.3f ms  %.1f us/frame  score %d  hash %08x\n",
+			(long long)frames, best*1000.0, frames ? best*1e6/frames : 0.0, w->SCORE, hash);
+	if(Window){
+		printf("render %dx%d on %d threads  %.1f us/frame  %d frames hash %08x\n", render.width, render.height,
+				job_pool_threads(&Window->pool), render.frames ? render.seconds*1e6/render.frames : 0.0, render.checked, render.hash);
+		if(render.golden)
+			printf("golden %s: %d of %d frames differ\n", render.golden, render.mismatches, render.checked);
+	}
+
+	if(rewind && rewindLast() >= rewindFirst()){
+		int ticks = rewindLast() - rewindFirst() + 1;
+		i64 bytes = rewindBytes();
+		printf("rewind %d ticks  %.2f MB  %.0f bytes/tick\n", ticks, bytes / (1024.0*1024.0), (double)bytes / ticks);
+
+		frameInput in;
+		int back = rewindLast() - ticks/4;
+		while(rewindLast() > back)
+			if(!rewindStepBack(w))
+				break;
+		if(rewindLast() != back)
+			printf("step back to tick %d failed\n", back);
+		else{
+			replayCursor = back + 1;
+			while(replayNext(&in))
+				coreStep(w, &in);
+			u32 h = simStateHash(w);
+			printf("step back to tick %d and replay: hash %08x %s\n", back, h, h == hash ? "ok" : "DESYNC");
+		}
+
+		int tick = rewindFirst() + ticks/2;
+		if(!rewindSeek(w, tick))
+			printf("rewind to tick %d failed\n", tick);
+		else{
+			replayCursor = tick + 1;
+			while(replayNext(&in))
+				coreStep(w, &in);
+			u32 h = simStateHash(w);
+			printf("rewind to tick %d and replay: hash %08x %s\n", tick, h, h == hash ? "ok" : "DESYNC");
+		}
+	}
+
+	if(save && !snapshotSave(w, save))
+		fprintf(stderr, "could not write snapshot %s\n", save);
+	worldDestroy(w);
+	coreDestroy();
+	render.rgb.destroy();
+	return render.mismatches ? 1 : 0;
+}
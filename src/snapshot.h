@@ -0,0 +1,395 @@
+#ifndef snapshot_h
+#define snapshot_h
+
+//==========================SNAPSHOT========================//
+
+// A whole gameWorld as one flat image: snapshotHeader, then the fixed
+// size state (scalars, rng, map) at fixed offsets, then every variable length
+// array as {count, element size, elements} padded to 8 bytes. Images are saved
+// and loaded through a file mapping, so a save is one memcpy per field into the
+// mapped file and a load one memcpy back.
+//
+// snapshotFields is the only list of what is in an image, the same function
+// counts, writes, checks and reads it, so capture and restore can't drift apart.
+// Bump snapshotVersion whenever that list or one of the captured structs changes.
+//
+// Not in the image: the renderer, the replay, the map summary, which is rebuilt
+// from the tiles, mapNoise, which only depends on counter, and the map streamer,
+// which continues at the restored column (columns only depend on their number).
+
+#define snapshotMagic	0x50534753	// "SGSP"
+#define snapshotVersion	2
+
+struct snapshotHeader{
+	u32 magic;
+	u32 version;
+	i64 size;	// of the whole image, header included
+};
+
+enum snapshotMode{
+	snapshotCount,	// only measure
+	snapshotWrite,	// state -> image
+	snapshotCheck,	// validate an image without touching the state
+	snapshotRead	// image -> state, only after a snapshotCheck passed
+};
+
+struct snapshotStream{
+	snapshotMode mode;
+	u8* data;
+	i64 size;
+	i64 at;
+	bool ok;
+	Array<i64>* arrays;	// optional, gets the offset of every array's elements (rewind splits images there)
+};
+
+void snapshotBytes(snapshotStream* s, void* p, i64 size){
+	if(size <= 0)
+		return;
+	if(s->mode == snapshotWrite)
+		memcpy(s->data + s->at, p, size);
+	else if(s->mode == snapshotRead)
+		memcpy(p, s->data + s->at, size);
+	else if(s->mode == snapshotCheck && s->at + size > s->size)
+		s->ok = false;
+	s->at += size;
+}
+
+// returns the value as it is in the image (in snapshotCheck the state isn't touched)
+template <typename T>
+T snapshotValue(snapshotStream* s, T* v){
+	static_assert(std::is_trivially_copyable<T>::value, "snapshots are plain memory copies");
+	T value = *v;
+	if(s->mode == snapshotCheck && s->ok && s->at + (i64)sizeof(T) <= s->size)
+		memcpy(&value, s->data + s->at, sizeof(T));
+	snapshotBytes(s, v, sizeof(T));
+	return s->mode == snapshotRead ? *v : value;
+}
+
+// fails an image whose fields are well formed on their own but don't fit together
+void snapshotExpect(snapshotStream* s, bool valid){
+	if(s->mode == snapshotCheck && !valid)
+		s->ok = false;
+}
+
+void snapshotPad(snapshotStream* s){
+	u8 zero[8] = {};
+	snapshotBytes(s, zero, (8 - (s->at & 7)) & 7);
+}
+
+// an array as it is in the image: in snapshotCheck the elements in the image data itself
+// (every array starts 8 aligned), in the other modes the state's
+template <typename T>
+struct snapshotSpan{
+	const T* ptr;
+	i64 len;
+
+	const T& operator[](i64 i) const{ return ptr[i]; }
+};
+
+// returns no elements if the image is broken
+template <typename T>
+snapshotSpan<T> snapshotArray(snapshotStream* s, Array<T>* a){
+	static_assert(std::is_trivially_copyable<T>::value, "snapshots are plain memory copies");
+	u32 head[2] = {(u32)a->len(), (u32)sizeof(T)};
+	if(s->mode == snapshotCheck && s->ok && s->at + (i64)sizeof(head) <= s->size)
+		memcpy(head, s->data + s->at, sizeof(head));
+	snapshotBytes(s, head, sizeof(head));
+	if(head[1] != sizeof(T))
+		s->ok = false;
+	if(!s->ok)
+		return {NULL, 0};
+	if(s->mode == snapshotRead)
+		a->resize(head[0]);
+	if(s->arrays)
+		s->arrays->add(s->at);
+	snapshotSpan<T> span = {s->mode == snapshotCheck ? (const T*)(s->data + s->at) : a->ptr(), head[0]};
+	snapshotBytes(s, a->ptr(), (i64)head[0] * sizeof(T));
+	snapshotPad(s);
+	if(!s->ok)
+		return {NULL, 0};
+	return span;
+}
+
+struct snapshotTableSpan{
+	snapshotSpan<u32> value;
+	snapshotSpan<u16> gen;
+	u32 free;
+	u32 count;
+};
+
+snapshotTableSpan snapshotTable(snapshotStream* s, Handle_Table* t){
+	snapshotTableSpan span;
+	span.value = snapshotArray(s, &t->_value);
+	span.gen = snapshotArray(s, &t->_gen);
+	span.free = snapshotValue(s, &t->_free);
+	span.count = snapshotValue(s, &t->_count);
+	return span;
+}
+
+template <typename T>
+snapshotTableSpan snapshotSlotMap(snapshotStream* s, Slot_Map<T>* m, snapshotSpan<Handle>* ids){
+	snapshotTableSpan table = snapshotTable(s, &m->_table);
+	i64 n = snapshotArray(s, &m->_dense).len;
+	*ids = snapshotArray(s, &m->_ids);
+	snapshotExpect(s, ids->len == n);
+	return table;
+}
+
+//==========================SNAPSHOT CHECK==================//
+
+// Everything of an image that indexes into something else of it. The game trusts these
+// (commits index the pools with the deaths and the handle tables with the ids), so an
+// image is only restored if every one of them points where the game would have put it.
+
+struct snapshotRefs{
+	Handle playerId;
+	snapshotTableSpan objects;
+	snapshotSpan<Handle> objectIds;
+
+	snapshotTableSpan itemHandles;
+	snapshotSpan<Handle> itemIds[itemTypes];
+	snapshotSpan<int> itemDeaths[itemTypes];
+	snapshotSpan<gameItem> itemSpawns;
+	snapshotSpan<Handle> itemSpawnIds;
+
+	snapshotTableSpan particleHandles;
+	snapshotSpan<Handle> particleIds;
+	snapshotSpan<Handle> particleSpawnIds;
+	snapshotSpan<int> particleDeaths;
+};
+
+enum snapshotSlot : u8{
+	snapshotSlotLive,	// not claimed by an id (yet)
+	snapshotSlotFree,
+	snapshotSlotClaimed
+};
+
+Array<u8> snapshotSlots;	// a snapshotSlot for every slot of the table that is checked
+
+// marks the free slots of t, false if the free list leaves the table, runs in a circle
+// or doesn't leave count live slots
+bool snapshotFreeSlots(const snapshotTableSpan* t){
+	if(t->gen.len != t->value.len)
+		return false;
+	snapshotSlots.resize(t->value.len);
+	if(t->value.len)
+		memset(snapshotSlots.ptr(), snapshotSlotLive, t->value.len);
+	i64 free = 0;
+	for(u32 i = t->free; i; i = t->value[i - 1]){
+		if(i > t->value.len || snapshotSlots[i - 1] == snapshotSlotFree)
+			return false;
+		snapshotSlots[i - 1] = snapshotSlotFree;
+		free++;
+	}
+	return t->count == t->value.len - free;
+}
+
+bool snapshotLive(const snapshotTableSpan* t, Handle id){
+	u32 i = handle_index(id);
+	return id != HANDLE_NULL && i < t->value.len && snapshotSlots[i] != snapshotSlotFree && t->gen[i] == handle_gen(id);
+}
+
+// every id has to be a live handle of t that resolves to value(i), and no two ids the same one
+template <typename F>
+bool snapshotClaim(const snapshotTableSpan* t, snapshotSpan<Handle> ids, F value){
+	for(i64 i = 0; i < ids.len; i++){
+		if(!snapshotLive(t, ids[i]))
+			return false;
+		u32 slot = handle_index(ids[i]);
+		if(snapshotSlots[slot] == snapshotSlotClaimed || t->value[slot] != value(i))
+			return false;
+		snapshotSlots[slot] = snapshotSlotClaimed;
+	}
+	return true;
+}
+
+bool snapshotIndices(snapshotSpan<int> indices, i64 len){
+	for(i64 i = 0; i < indices.len; i++)
+		if(indices[i] < 0 || indices[i] >= len)
+			return false;
+	return true;
+}
+
+// the handle tables are checked one after the other, the live handles of each one have to be
+// exactly the ones its ids claim
+bool snapshotRefsValid(const snapshotRefs* r){
+	if(!snapshotFreeSlots(&r->objects) ||
+		!snapshotClaim(&r->objects, r->objectIds, [](i64 i){ return (u32)i; }) ||
+		r->objectIds.len != r->objects.count ||
+		!snapshotLive(&r->objects, r->playerId))
+		return false;
+
+	if(!snapshotFreeSlots(&r->itemHandles))
+		return false;
+	i64 items = r->itemSpawnIds.len;
+	for(int type = 0; type < itemTypes; type++){
+		if(!snapshotClaim(&r->itemHandles, r->itemIds[type], [&](i64 i){ return itemLocation(type, i); }) ||
+			!snapshotIndices(r->itemDeaths[type], r->itemIds[type].len))
+			return false;
+		items += r->itemIds[type].len;
+	}
+	for(i64 i = 0; i < r->itemSpawns.len; i++){
+		// as a number, the image can hold anything in there
+		static_assert(sizeof(enum itemType) == sizeof(u32), "itemType is read as a u32");
+		u32 type;
+		memcpy(&type, &r->itemSpawns[i].type, sizeof(type));
+		if(type >= itemTypes)
+			return false;
+	}
+	if(!snapshotClaim(&r->itemHandles, r->itemSpawnIds, [](i64){ return itemPending; }) ||
+		items != r->itemHandles.count)
+		return false;
+
+	return snapshotFreeSlots(&r->particleHandles) &&
+		snapshotClaim(&r->particleHandles, r->particleIds, [](i64 i){ return (u32)i; }) &&
+		snapshotClaim(&r->particleHandles, r->particleSpawnIds, [](i64){ return particlePending; }) &&
+		r->particleIds.len + r->particleSpawnIds.len == r->particleHandles.count &&
+		snapshotIndices(r->particleDeaths, r->particleIds.len);
+}
+
+void snapshotFields(snapshotStream* s, gameWorld* w){
+	snapshotRefs refs;
+
+	// fixed size
+	snapshotValue(s, &w->counter);
+	snapshotValue(s, &w->score);
+	snapshotValue(s, &w->frameTime);
+	snapshotValue(s, &w->delay);
+	snapshotValue(s, &w->mapWarp);
+	snapshotValue(s, &w->speed);
+	snapshotValue(s, &w->warp);
+	snapshotValue(s, &w->cameraXpos);
+	snapshotValue(s, &w->cameraYpos);
+	snapshotValue(s, &w->lastCamXpos);
+	snapshotValue(s, &w->lastCamYpos);
+	snapshotValue(s, &w->newCamXpos);
+	snapshotValue(s, &w->newCamYpos);
+	snapshotValue(s, &w->camDelay);
+	snapshotValue(s, &w->HIGH_SCORE);
+	snapshotValue(s, &w->BEST_SCORE);
+	snapshotValue(s, &w->LAST_SCORE);
+	snapshotValue(s, &w->SCORE);
+	snapshotValue(s, &w->state);
+	refs.playerId = snapshotValue(s, &w->playerId);
+	snapshotValue(s, &w->itemGravityFlipped);
+	snapshotPad(s);
+	snapshotValue(s, &w->rnd);
+	snapshotValue(s, &w->fxRnd);
+	snapshotPad(s);
+	i32 width = snapshotValue(s, &w->map.width);
+	i32 height = snapshotValue(s, &w->map.height);
+	i64 tiles = snapshotArray(s, &w->map.tiles).len;
+	// mapNoise, the streamer and drawMap all are made for this one size
+	snapshotExpect(s, width == xtiles && height == ytiles && tiles == (i64)xtiles*ytiles);
+
+	// variable size
+	refs.objects = snapshotSlotMap(s, &w->gameObjects, &refs.objectIds);
+
+	for(int type = 0; type < itemTypes; type++){
+		itemPool* p = &w->itemPools[type];
+		// every field of the pool is one array of itemPoolLen elements
+		i64 n = snapshotArray(s, &p->x).len;
+		snapshotExpect(s, snapshotArray(s, &p->y).len == n);
+		snapshotExpect(s, snapshotArray(s, &p->vx).len == n);
+		snapshotExpect(s, snapshotArray(s, &p->vy).len == n);
+		snapshotExpect(s, snapshotArray(s, &p->ax).len == n);
+		snapshotExpect(s, snapshotArray(s, &p->initVel).len == n);
+		snapshotExpect(s, snapshotArray(s, &p->r).len == n);
+		snapshotExpect(s, snapshotArray(s, &p->active).len == n);
+		refs.itemIds[type] = snapshotArray(s, &p->id);
+		snapshotExpect(s, refs.itemIds[type].len == n);
+		refs.itemDeaths[type] = snapshotArray(s, &w->itemDeaths[type]);
+	}
+	refs.itemHandles = snapshotTable(s, &w->itemHandles);
+	refs.itemSpawns = snapshotArray(s, &w->itemSpawns);
+	refs.itemSpawnIds = snapshotArray(s, &w->itemSpawnIds);
+	snapshotExpect(s, refs.itemSpawnIds.len == refs.itemSpawns.len);
+
+	i64 particles = snapshotArray(s, &w->particles).len;
+	refs.particleIds = snapshotArray(s, &w->particleIds);
+	refs.particleHandles = snapshotTable(s, &w->particleHandles);
+	i64 particleSpawns = snapshotArray(s, &w->particleSpawns).len;
+	refs.particleSpawnIds = snapshotArray(s, &w->particleSpawnIds);
+	refs.particleDeaths = snapshotArray(s, &w->particleDeaths);
+	snapshotExpect(s, refs.particleIds.len == particles && refs.particleSpawnIds.len == particleSpawns);
+
+	if(s->mode == snapshotCheck && s->ok)
+		snapshotExpect(s, snapshotRefsValid(&refs));
+}
+
+// bytes an image of the current state takes
+i64 snapshotSize(gameWorld* w){
+	snapshotStream s = {snapshotCount, NULL, 0, sizeof(snapshotHeader), true, NULL};
+	snapshotFields(&s, w);
+	return s.at;
+}
+
+// data has to hold snapshotSize() bytes
+void snapshotWriteTo(gameWorld* w, u8* data, i64 size){
+	snapshotHeader header = {snapshotMagic, snapshotVersion, size};
+	memcpy(data, &header, sizeof(header));
+	snapshotStream s = {snapshotWrite, data, size, sizeof(header), true, NULL};
+	snapshotFields(&s, w);
+}
+
+void snapshotCapture(gameWorld* w, Array<u8>* image){
+	i64 size = snapshotSize(w);
+	image->resize(size);
+	snapshotWriteTo(w, image->ptr(), size);
+}
+
+// false (and the state untouched) if the image is not a valid snapshot of this version.
+// w has to be initialized, coreInitState.
+bool snapshotRestore(gameWorld* w, const u8* data, i64 size){
+	snapshotHeader header;
+	if(size < (i64)sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if(header.magic != snapshotMagic || header.version != snapshotVersion || header.size != size)
+		return false;
+
+	// the stream never writes to data in these modes
+	snapshotStream s = {snapshotCheck, (u8*)data, size, sizeof(header), true, NULL};
+	snapshotFields(&s, w);
+	if(!s.ok || s.at != size)
+		return false;
+
+	int from = w->counter;
+	s = {snapshotRead, (u8*)data, size, sizeof(header), true, NULL};
+	snapshotFields(&s, w);
+	tilemap_rebuild_summary(&w->map);
+	w->itemKeep.clear();
+	w->particleKeep.clear();
+	for(int type = 0; type < itemTypes; type++){
+		itemPool* p = &w->itemPools[type];
+		p->col.resize(itemPoolLen(p));
+	}
+	w->player = getGameObject(w, w->playerId);
+	mapMoveNoise(w, from);
+	mapStreamSeek(w, w->counter + 1);
+	return true;
+}
+
+bool snapshotSave(gameWorld* w, const char* path){
+	PROFILE_FUNCTION();
+	i64 size = snapshotSize(w);
+	File_Map file;
+	if(!file_map_write(&file, path, size))
+		return false;
+	snapshotWriteTo(w, file.data, size);
+	file_unmap(&file);
+	return true;
+}
+
+bool snapshotLoad(gameWorld* w, const char* path){
+	PROFILE_FUNCTION();
+	File_Map file;
+	if(!file_map_read(&file, path))
+		return false;
+	bool ok = snapshotRestore(w, file.data, file.size);
+	file_unmap(&file);
+	return ok;
+}
+
+//==========================SNAPSHOT END====================//
+#endif